@@ -3,15 +3,32 @@
 #include <FL/gl.h>
 #include <math.h>
 #include <iostream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <algorithm>
 
-#include <cvode/cvode.h>
-#include <nvector/nvector_serial.h>
-#include <cvode/cvode_dense.h>
+#include <sundials/sundials_core.h>     // Provides core SUNDIALS types
+#include <cvode/cvode.h>                // CVODE provides linear multistep methods
+#include <nvector/nvector_serial.h>     // access to serial N_Vector
+#include <sunlinsol/sunlinsol_dense.h>  // access to dense SUNLinearSolver
+#include <sunmatrix/sunmatrix_dense.h>  // access to dense SUNMatrix
 
 #include "de.h"
+#include "frame_ring.h"
+#include "replay.h"
+#include "traj.h"
 
 // Warning: Poorly designed C++ code ahead...
 
+// SUNDIALS context
+static SUNContext sunctx = NULL;
+
+// Number of frames the integration may run ahead of the display.
+#define RUN_AHEAD 8
+
+#define FRAME_PERIOD (1.0/60.0)
+
 class Playback : public Fl_Gl_Window {
 
     int frame;
@@ -20,9 +37,21 @@ class Playback : public Fl_Gl_Window {
     N_Vector state;
 
     void *cvode_mem;
-    realtype tau;
-    realtype dtau;
-    realtype tau1;
+    SUNMatrix A;
+    SUNLinearSolver LS;
+    sunrealtype tau;
+    std::atomic<double> dtau;
+    sunrealtype tau1;
+
+    // The integration runs in sim, which publishes the frames in ring;
+    // shown is the state of the frame on the screen.
+    FrameRing *ring;
+    SimThread *sim;
+    std::vector<double> shown;
+
+    // A recorded trajectory played back instead (--replay).
+    traj_map_t *replay_map;
+    Replay *replay;
 
 
     //
@@ -53,8 +82,8 @@ class Playback : public Fl_Gl_Window {
             //glBegin(GL_LINE_STRIP);
             glBegin(GL_POLYGON);
             for (int i = 0; i < 3; i++) {
-                xx = X(state, i % 3)/12.5;
-                yy = Y(state, i % 3)/12.5;
+                xx = shown[2*(i % 3)]/12.5;
+                yy = shown[2*(i % 3) + 1]/12.5;
                 glVertex2f(xx, yy);
             }
             glEnd();
@@ -73,31 +102,108 @@ class Playback : public Fl_Gl_Window {
         ++frame;
     }
 
+    //
+    // Advance the integration by one frame (in the simulation thread).
+    //
+    int step(double *t, double *out)
+    {
+        int flag;
+
+        flag = CVode(cvode_mem, tau + dtau.load(), state, &tau, CV_NORMAL);
+        *t = tau;
+        std::copy(N_VGetArrayPointer(state), N_VGetArrayPointer(state) + 12, out);
+        return flag == CV_SUCCESS ? 0 : flag;
+    }
+
     //
     // Called repeatedly to redraw the window.
     //
     static void Timer_CB(void *userdata)
     {
-        int flag;
         Playback *pb = (Playback*)userdata;
+        const FrameRing::Frame *f;
+        int done = 0;
 
-        if (pb->cvode_mem == NULL) {
-            std::cerr << "pb->cvode_mem is NULL!\n";
+        f = pb->ring->front();
+        if (f != NULL) {
+            std::copy(f->state, f->state + 12, pb->shown.begin());
+            done = f->flag != 0;
+            pb->ring->pop();
+            pb->redraw();
+        }
+        if (!done) {
+            Fl::repeat_timeout(FRAME_PERIOD, Timer_CB, userdata);
         }
-        flag = CVode(pb->cvode_mem, pb->tau + pb->dtau, pb->state,
-                     &(pb->tau), CV_NORMAL);
+    }
+
+    //
+    // Timer_CB for the replay of a trajectory.
+    //
+    static void Replay_CB(void *userdata)
+    {
+        Playback *pb = (Playback*)userdata;
+        const double *f;
 
+        pb->replay->advance(FRAME_PERIOD);
+        f = pb->replay->frame();
+        std::copy(f, f + 12, pb->shown.begin());
         pb->redraw();
-        Fl::repeat_timeout(1.0/60.0, Timer_CB, userdata);
+        Fl::repeat_timeout(FRAME_PERIOD, Replay_CB, userdata);
     }
 
 public:
 
-    // Constructor
-    Playback(int X, int Y, int W, int H, const char*L=0) : Fl_Gl_Window(X,Y,W,H,L)
+    int handle(int e)
+    {
+        if (replay != NULL) {
+            if (e == FL_FOCUS || e == FL_UNFOCUS) {
+                return 1;
+            }
+            if (e == FL_PUSH || e == FL_DRAG) {
+                replay->scrub(std::min(std::max(Fl::event_x(), 0), w())/(double) w());
+                return 1;
+            }
+            if (e == FL_KEYBOARD && replay->key(Fl::event_text()[0])) {
+                return 1;
+            }
+        }
+        return(Fl_Gl_Window::handle(e));
+    }
+
+    // Constructor; with replay_file, the trajectory in that file (e.g.
+    // from demain --out) is played back instead of integrated.
+    Playback(int X, int Y, int W, int H, const char *replay_file=0,
+             const char*L=0) : Fl_Gl_Window(X,Y,W,H,L)
     {
         int flag;
 
+        ring = NULL;
+        sim = NULL;
+        replay_map = NULL;
+        replay = NULL;
+        if (replay_file != NULL) {
+            replay_map = traj_map_open(replay_file);
+            if (replay_map == NULL) {
+                end();
+                return;
+            }
+            if (replay_map->row_size != 13 || replay_map->num_frames == 0) {
+                std::cerr << replay_file << " does not hold frames of 3 points\n";
+                end();
+                return;
+            }
+            replay = new Replay(replay_map, 0.5/FRAME_PERIOD);
+            shown.assign(replay->frame(), replay->frame() + 12);
+            Fl::add_timeout(FRAME_PERIOD, Replay_CB, (void*)this);
+            end();
+            return;
+        }
+
+        if (SUNContext_Create(SUN_COMM_NULL, &sunctx)) {
+            std::cerr << "SUNContext_Create() failed.\n";
+            return;
+        }
+
         frame = 0;
 
         params.k = 1.0;
@@ -105,7 +211,7 @@ public:
         params.b = 0.1;
         params.g = 9.0;
 
-        state = N_VNew_Serial(12);
+        state = N_VNew_Serial(12, sunctx);
         X(state,0) = 8.9;
         Y(state,0)= 9.2;
         X(state,1) = 8.9;
@@ -121,11 +227,11 @@ public:
         V(state,2) = -0.4;
 
 
-        tau = RCONST(0.0);
-        dtau = RCONST(0.5);
-        tau1 = RCONST(2500.0);
+        tau = SUN_RCONST(0.0);
+        dtau = SUN_RCONST(0.5);
+        tau1 = SUN_RCONST(2500.0);
 
-        cvode_mem = CVodeCreate(CV_ADAMS, CV_FUNCTIONAL);
+        cvode_mem = CVodeCreate(CV_ADAMS, sunctx);
         if (cvode_mem == NULL) {
             std::cerr << "darn it\n";
         }
@@ -134,19 +240,49 @@ public:
         flag = CVodeSStolerances(cvode_mem, 1e-10, 1e-12);
         flag = CVodeSetUserData(cvode_mem, &params);
         flag = CVodeSetMaxNumSteps(cvode_mem, 100000);
-        flag = CVDense(cvode_mem, 12);
+        A = SUNDenseMatrix(12, 12, sunctx);
+        LS = SUNLinSol_Dense(state, A, sunctx);
+        flag = CVodeSetLinearSolver(cvode_mem, LS, A);
         flag = CVodeSetStopTime(cvode_mem, tau1);
 
-        Fl::add_timeout(1.0/60.0, Timer_CB, (void*)this);
+        shown.assign(N_VGetArrayPointer(state), N_VGetArrayPointer(state) + 12);
+        ring = new FrameRing(RUN_AHEAD, 12);
+        sim = new SimThread(*ring, [this](double *t, double *out) {
+            return step(t, out);
+        });
+        sim->start();
+
+        Fl::add_timeout(FRAME_PERIOD, Timer_CB, (void*)this);
         end();
     }
+
+    ~Playback()
+    {
+        delete sim;
+        delete ring;
+        delete replay;
+        traj_map_close(replay_map);
+    }
 };
 
 
-int main()
+int main(int argc, char *argv[])
 {
+    const char *replay_file = NULL;
+
+    // --replay file.npy plays back a trajectory of the 3 point system
+    // (e.g. written by demain --out) instead of integrating; see replay.h
+    // for the keys, and drag the mouse across the window to scrub.
+    if (argc == 3 && std::string(argv[1]) == "--replay") {
+        replay_file = argv[2];
+    }
+    else if (argc != 1) {
+        std::cerr << "usage: " << argv[0] << " [--replay file.npy]\n";
+        return 1;
+    }
+
     Fl_Window win(750, 750);
-    Playback playback(10, 10, win.w()-20, win.h()-20);
+    Playback playback(10, 10, win.w()-20, win.h()-20, replay_file);
     win.resizable(&playback);
     win.show();
     return(Fl::run());
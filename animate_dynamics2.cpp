@@ -3,19 +3,35 @@
 #include <FL/gl.h>
 
 #include <math.h>
+#include <stdlib.h>
 #include <iostream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
 
 #include <sundials/sundials_core.h>     // Provides core SUNDIALS types
 #include <cvode/cvode.h>                // CVODE provides linear multistep methods
 #include <nvector/nvector_serial.h>     // access to serial N_Vector
-#include <sunlinsol/sunlinsol_dense.h>  // access to dense SUNLinearSolver
-#include <sunmatrix/sunmatrix_dense.h>  // access to dense SUNmatrix
 
 //#include <cvode/cvode.h>
 //#include <nvector/nvector_serial.h>
 //#include <cvode/cvode_dense.h>
 
+#include "contact.h"
 #include "de.h"
+#include "de_parallel.h"
+#include "force_law.h"
+#include "frame_ring.h"
+#include "lattice.h"
+#include "renderer.h"
+#include "reorder.h"
+#include "replay.h"
+#include "stats.h"
+#include "solver.h"
+#include "symplectic.h"
+#include "traj.h"
 
 
 // SUNDIALS context
@@ -26,22 +42,6 @@ static SUNContext sunctx = NULL;
 #define ORIGIN         0
 #define CENTER_OF_MASS 1
 
-int connections[2*12] = {
-    0, 1,
-    0, 2,
-    0, 3,
-    0, 4,
-    0, 5,
-    0, 6,
-    1, 2,
-    2, 3,
-    3, 4,
-    4, 5,
-    5, 6,
-    6, 1
-};
-
-
 
 class Playback : public Fl_Gl_Window {
 
@@ -53,13 +53,49 @@ class Playback : public Fl_Gl_Window {
     xparams_t params;
     N_Vector state;
 
+    solver_t *solver;
     void *cvode_mem;
     sunrealtype tau;
-    sunrealtype dtau;
+    std::atomic<double> dtau;
     sunrealtype tau1;
+    // Interpolate the frames from the integrator's own steps
+    // (solver_dense()).
+    int dense;
+    // With --symplectic, the fixed step integrator that replaces CVODE
+    // (solver is then NULL).
+    symplectic_t *sym;
 
     int crashed;
 
+    // The integration runs in sim, which publishes the frames in ring;
+    // shown is the state of the frame on the screen.
+    FrameRing *ring;
+    SimThread *sim;
+    std::vector<double> shown;
+
+    // With --replay, the frames come from the mapped trajectory file
+    // instead of the integration.  With --record, the frames of the
+    // integration are written to a trajectory file.
+    traj_map_t *replay_map;
+    Replay *replay;
+    traj_t *record;
+
+    // With --reorder, the points are renumbered (reorder.h) before the
+    // integration; the frames are recorded, and the points reported, by
+    // their numbers in the lattice.
+    reorder_t *reorder;
+    std::vector<double> record_buf;
+
+    // Draws the springs and points if the GL context supports it;
+    // otherwise (or with --immediate) draw() uses immediate mode.
+    SpringRenderer *renderer;
+    int immediate;
+
+    // Solver statistics of the last step (when enabled with --stats),
+    // written by the simulation thread.
+    std::mutex stats_mutex;
+    stats_record_t frame_stats;
+
     //
     // Draw the system.
     //
@@ -69,6 +105,21 @@ class Playback : public Fl_Gl_Window {
         double xx, yy;
         int idx;
 
+        if (!context_valid()) {
+            // A new context; the old one took the renderer's buffers along.
+            delete renderer;
+            renderer = NULL;
+            if (!immediate) {
+                renderer = new SpringRenderer();
+                if (!renderer->init(params.num_points, params.connections,
+                                    params.num_connections)) {
+                    std::cerr << "Drawing in immediate mode.\n";
+                    delete renderer;
+                    renderer = NULL;
+                    immediate = 1;
+                }
+            }
+        }
         if (!valid()) {
             valid(1);
             glLoadIdentity();
@@ -80,58 +131,63 @@ class Playback : public Fl_Gl_Window {
         oy = 0.0;
         if (center == CENTER_OF_MASS) {
             for (idx = 0; idx < params.num_points; ++idx) {
-                ox += NV_Ith_S(state, 2*idx);
-                oy += NV_Ith_S(state, 2*idx + 1);
+                ox += shown[2*idx];
+                oy += shown[2*idx + 1];
             }
             ox /= params.num_points;
             oy /= params.num_points;
         }
         glPushMatrix();
-            // Draw the connections. Color-code based on whether the spring is
-            // stretched or compressed (relative to the natural length params.L).
-            for (idx = 0; idx < params.num_connections; ++idx) {
-                int i, j;
-                double red, blue;
-                double line_base_color = 0.6;
-                i = params.connections[2*idx];
-                j = params.connections[2*idx+1];
-
-                double x1 = NV_Ith_S(state, 2*i);
-                double y1 = NV_Ith_S(state, 2*i+1);
-                double x2 = NV_Ith_S(state, 2*j);
-                double y2 = NV_Ith_S(state, 2*j+1);
-                double dist = hypot(x2 - x1, y2 - y1);
-                if (dist <= params.L) {
-                    red = line_base_color + (1 - line_base_color)*tanh(25*(params.L - dist)/params.L);
-                    blue = line_base_color;
-                }
-                else if (dist > params.L) {
-                    blue = line_base_color + (1 - line_base_color)*tanh(25*(dist - params.L)/params.L);
-                    red = line_base_color;
+            if (renderer != NULL) {
+                renderer->draw(&shown[0], params.L, ox, oy, 1.0/SCALE);
+            }
+            else {
+                // Draw the connections. Color-code based on whether the spring is
+                // stretched or compressed (relative to the natural length params.L).
+                for (idx = 0; idx < params.num_connections; ++idx) {
+                    int i, j;
+                    double red, blue;
+                    double line_base_color = 0.6;
+                    i = params.connections[2*idx];
+                    j = params.connections[2*idx+1];
+
+                    double x1 = shown[2*i];
+                    double y1 = shown[2*i+1];
+                    double x2 = shown[2*j];
+                    double y2 = shown[2*j+1];
+                    double dist = hypot(x2 - x1, y2 - y1);
+                    if (dist <= params.L) {
+                        red = line_base_color + (1 - line_base_color)*tanh(25*(params.L - dist)/params.L);
+                        blue = line_base_color;
+                    }
+                    else if (dist > params.L) {
+                        blue = line_base_color + (1 - line_base_color)*tanh(25*(dist - params.L)/params.L);
+                        red = line_base_color;
+                    }
+                    glColor3f(red, line_base_color, blue);
+
+                    glBegin(GL_LINES);
+                    xx = (x1 - ox)/SCALE;
+                    yy = (y1 - oy)/SCALE;
+                    glVertex2f(xx, yy);
+                    xx = (x2 - ox)/SCALE;
+                    yy = (y2 - oy)/SCALE;
+                    glVertex2f(xx, yy);
+                    glEnd();
                 }
-                glColor3f(red, line_base_color, blue);
 
-                glBegin(GL_LINES);
-                xx = (x1 - ox)/SCALE;
-                yy = (y1 - oy)/SCALE;
-                glVertex2f(xx, yy);
-                xx = (x2 - ox)/SCALE;
-                yy = (y2 - oy)/SCALE;
-                glVertex2f(xx, yy);
+                // Draw the point masses as white dots.
+                glColor3f(1.0, 1.0, 1.0);
+                glPointSize(3.0);
+                glBegin(GL_POINTS);
+                for (int i = 0; i < params.num_points; ++i) {
+                    double x = (shown[2*i] - ox)/SCALE;
+                    double y = (shown[2*i+1] - oy)/SCALE;
+                    glVertex2f(x, y);
+                }
                 glEnd();
             }
 
-            // Draw the point masses as white dots.
-            glColor3f(1.0, 1.0, 1.0);
-            glPointSize(3.0);
-            glBegin(GL_POINTS);
-            for (int i = 0; i < params.num_points; ++i) {
-                double x = (NV_Ith_S(state, 2*i) - ox)/SCALE;
-                double y = (NV_Ith_S(state, 2*i+1) - oy)/SCALE;
-                glVertex2f(x, y);
-            }
-            glEnd();
-
             // Draw the disk in the center.
             glColor3f(0.75, 0.75, 0.0);
             glBegin(GL_POLYGON);
@@ -149,27 +205,142 @@ class Playback : public Fl_Gl_Window {
     }
 
     //
-    // Called repeatedly to redraw the window.
+    // The number of point k in the lattice.
     //
-    static void Timer_CB(void *userdata)
+    int lattice_point(int k)
+    {
+        return reorder != NULL ? reorder->perm[k] : k;
+    }
+
+    //
+    // Tell which roots of contact_roots() ended the integration, as the
+    // solver found them (decreasing through zero: a point reaching the
+    // central mass, or two points coming into contact).
+    //
+    void report_collision()
+    {
+        const double *y = N_VGetArrayPointer(state);
+        std::vector<int> rootsfound(contact_num_roots(&params), 0);
+        int central = contact_root_index(&params, ROOT_CENTRAL);
+        int contact = contact_root_index(&params, ROOT_CONTACT);
+        int i, j;
+
+        if (solver_get_root_info(solver, &rootsfound[0]) != CV_SUCCESS) {
+            return;
+        }
+        if (rootsfound[central] < 0) {
+            std::cerr << "t=" << tau << ": point "
+                      << lattice_point(collision_point(&params, y))
+                      << " hit the central mass\n";
+        }
+        if (contact >= 0 && rootsfound[contact] < 0) {
+            contact_closest(params.contact, y, &i, &j);
+        }
+        else {
+            i = -1;
+        }
+        if (i >= 0) {
+            std::cerr << "t=" << tau << ": points " << lattice_point(i) << " and "
+                      << lattice_point(j) << " collided\n";
+        }
+    }
+
+    //
+    // Write the current state to the trajectory file, in the order of the
+    // lattice.
+    //
+    int record_frame()
+    {
+        const double *y = N_VGetArrayPointer(state);
+
+        if (reorder != NULL) {
+            reorder_state(reorder, y, &record_buf[0]);
+            y = &record_buf[0];
+        }
+        return traj_write(record, tau, y);
+    }
+
+    //
+    // Advance the integration by one frame.  This runs in the simulation
+    // thread; it returns 0, or the CVode() flag that ends the integration.
+    //
+    int step(double *t, double *out)
     {
         int flag;
-        Playback *pb = (Playback*)userdata;
 
-        if (pb->cvode_mem == NULL) {
-            std::cerr << "pb->cvode_mem is NULL!\n";
+        if (sym != NULL) {
+            flag = symplectic_evolve(sym, std::min(tau + dtau.load(), (double)tau1),
+                                     state, &tau);
+            if (flag == SYMPLECTIC_SUCCESS && tau >= tau1) {
+                flag = CV_TSTOP_RETURN;
+            }
         }
-        flag = CVode(pb->cvode_mem, pb->tau + pb->dtau, pb->state,
-                     &(pb->tau), CV_NORMAL);
-        if (flag == CV_ROOT_RETURN) {
-            pb->crashed = 1;
+        else if (dense) {
+            flag = solver_dense(solver, tau + dtau.load(), state, &tau);
         }
-        pb->redraw();
-        if (!pb->crashed) {
+        else {
+            flag = solver_evolve(solver, tau + dtau.load(), state, &tau);
+        }
+        if (params.stats != NULL) {
+            std::lock_guard<std::mutex> lock(stats_mutex);
+            if (stats_sample(params.stats, cvode_mem, tau, &frame_stats) == 0) {
+                stats_write(params.stats, &frame_stats);
+            }
+        }
+        if (flag == CV_ROOT_RETURN && sym == NULL) {
+            report_collision();
+        }
+        *t = tau;
+        std::copy(N_VGetArrayPointer(state),
+                  N_VGetArrayPointer(state) + 4*params.num_points, out);
+        if (record != NULL && record_frame() != 0) {
+            std::cerr << "Recording failed.\n";
+            traj_close(record);
+            record = NULL;
+        }
+        return flag == CV_SUCCESS ? 0 : flag;
+    }
+
+    //
+    // Called repeatedly to redraw the window.  Shows the next frame from
+    // the simulation thread, if it is ready.
+    //
+    static void Timer_CB(void *userdata)
+    {
+        Playback *pb = (Playback*)userdata;
+        const FrameRing::Frame *f;
+        int done = 0;
+
+        f = pb->ring->front();
+        if (f != NULL) {
+            std::copy(f->state, f->state + pb->shown.size(), pb->shown.begin());
+            if (f->flag == CV_ROOT_RETURN) {
+                pb->crashed = 1;
+            }
+            done = f->flag != 0;
+            pb->ring->pop();
+            pb->redraw();
+        }
+        if (!done) {
             Fl::repeat_timeout(pb->frame_period, Timer_CB, userdata);
         }
     }
 
+    //
+    // Timer_CB for the replay of a trajectory.
+    //
+    static void Replay_CB(void *userdata)
+    {
+        Playback *pb = (Playback*)userdata;
+        const double *f;
+
+        pb->replay->advance(pb->frame_period);
+        f = pb->replay->frame();
+        std::copy(f, f + pb->shown.size(), pb->shown.begin());
+        pb->redraw();
+        Fl::repeat_timeout(pb->frame_period, Replay_CB, userdata);
+    }
+
 public:
 
     int handle(int e)
@@ -179,14 +350,25 @@ public:
         if (e == FL_FOCUS || e == FL_UNFOCUS) {
             return 1;
         }
+        if (replay != NULL && (e == FL_PUSH || e == FL_DRAG)) {
+            // Scrub: the horizontal position of the mouse is the time.
+            replay->scrub(std::min(std::max(Fl::event_x(), 0), w())/(double) w());
+            return 1;
+        }
         if (e == FL_KEYBOARD) {
             c = Fl::event_text()[0];
             std::cerr << Fl::event_key() << " '" << c << "'\n";
+            if (replay != NULL && replay->key(c)) {
+                std::cerr << "t=" << replay->time() << "\n";
+                return 1;
+            }
+            // (A new dtau applies to the frames that the simulation
+            // thread has not computed yet.)
             if (c == '+') {
-                dtau *= 2.0;
+                dtau.store(2.0*dtau.load());
             }
             else if (c == '-') {
-                dtau *= 0.5;
+                dtau.store(0.5*dtau.load());
             }
             else if (c == 'o') {
                 center = ORIGIN;
@@ -194,19 +376,52 @@ public:
             else if (c == 'c') {
                 center = CENTER_OF_MASS;
             }
+            else if (c == 's' && params.stats != NULL) {
+                std::lock_guard<std::mutex> lock(stats_mutex);
+                std::cerr << "t=" << frame_stats.t
+                          << " steps=" << frame_stats.nsteps
+                          << " rhs evals=" << frame_stats.nfevals
+                          << " lin. setups=" << frame_stats.nlinsetups
+                          << " err. test fails=" << frame_stats.netfails
+                          << " root evals=" << frame_stats.ngevals
+                          << " h=" << frame_stats.hcur
+                          << " rhs time=" << frame_stats.rhs_time
+                          << " root time=" << frame_stats.root_time << "\n";
+            }
         }
         return(Fl_Gl_Window::handle(e));
     }
 
     // Constructor
-    Playback(int X, int Y, int W, int H, const char*L=0) : Fl_Gl_Window(X,Y,W,H,L)
+    Playback(int X, int Y, int W, int H, int method=SOLVER_ADAMS,
+             int linsol=LINSOL_DENSE, int threaded=0, int rings=1,
+             int ahead=8, const char *stats_file=0, int immediate=0,
+             const char *replay_file=0, const char *record_file=0,
+             int dense=0, int symplectic=-1, double h=0.01,
+             int force_law=FORCE_CUBIC, double contact=0.0,
+             int order=REORDER_NONE, const char*L=0)
+        : Fl_Gl_Window(X,Y,W,H,L)
     {
         int retval;
         int flag;
-        double *p;
+        lattice_spec_t spec;
 
         std::cerr << "Playback() start\n";
 
+        xparams_init(&params);
+        ring = NULL;
+        sim = NULL;
+        renderer = NULL;
+        this->immediate = immediate;
+        replay_map = NULL;
+        replay = NULL;
+        record = NULL;
+        reorder = NULL;
+        this->dense = dense;
+        solver = NULL;
+        cvode_mem = NULL;
+        sym = NULL;
+
         /* Create the SUNDIALS context */
         retval = SUNContext_Create(SUN_COMM_NULL, &sunctx);
         if (retval) {
@@ -224,79 +439,282 @@ public:
         params.b = 0.5;
         params.g = 8.0;
         params.r0 = 0.25;
-        params.num_points = 7;
-        params.num_connections = 12;
-        params.connections = connections;
-
-        state = N_VNew_Serial(4*params.num_points, sunctx);
-        p = N_VGetArrayPointer(state);
-        hex_ics(9.0, 9.0, params.L, p);
+        params.force_law = force_law;
 
+        // A hexagon with the given number of rings around the center
+        // point (one ring is the 7 point system), all points moving with
+        // velocity (v0, -v0) except point 6, the last corner of the first
+        // ring, which moves at 0.1*(v0, -v0), as in the original 7 point
+        // system.
         double v0 = 0.45;
-        NV_Ith_S(state, 14) =  v0;
-        NV_Ith_S(state, 15) = -v0;
-        NV_Ith_S(state, 16) =  v0;
-        NV_Ith_S(state, 17) = -v0;
-        NV_Ith_S(state, 18) =  v0;
-        NV_Ith_S(state, 19) = -v0;
-        NV_Ith_S(state, 20) =  v0;
-        NV_Ith_S(state, 21) = -v0;
-        NV_Ith_S(state, 22) =  v0;
-        NV_Ith_S(state, 23) = -v0;
-        NV_Ith_S(state, 24) =  v0;
-        NV_Ith_S(state, 25) = -v0;
-        NV_Ith_S(state, 26) = 0.1*v0;
-        NV_Ith_S(state, 27) = -0.1*v0;
+        lattice_spec_init(&spec);
+        spec.type = LATTICE_HEX;
+        spec.rings = rings;
+        spec.L = params.L;
+        spec.cx = 9.0;
+        spec.cy = 9.0;
+        spec.u = v0;
+        spec.v = -v0;
+        if (lattice_size(&spec, &params.num_points, &params.num_connections) != 0) {
+            end();
+            return;
+        }
+        params.connections = new int[2*params.num_connections];
+        state = N_VNew_Serial(4*params.num_points, sunctx);
+        lattice_build(&spec, N_VGetArrayPointer(state), params.connections);
+        if (params.num_points > 6) {
+            NV_Ith_S(state, 2*params.num_points + 2*6) = 0.1*v0;
+            NV_Ith_S(state, 2*params.num_points + 2*6 + 1) = -0.1*v0;
+        }
+        // (A replay is of the lattice's own numbering.)
+        if (order != REORDER_NONE && replay_file == NULL) {
+            reorder = reorder_create(order, &params, N_VGetArrayPointer(state));
+            if (reorder == NULL ||
+                    reorder_apply(reorder, &params, N_VGetArrayPointer(state)) != 0) {
+                end();
+                return;
+            }
+            std::cerr << "Bandwidth of the connections: "
+                      << reorder_bandwidth(&params) << "\n";
+            record_buf.resize(4*params.num_points);
+        }
 
         tau = SUN_RCONST(0.0);
         dtau = SUN_RCONST(0.125);
         tau1 = SUN_RCONST(2500.0);
+        crashed = 0;
+        frame_stats = stats_record_t();
+        shown.assign(N_VGetArrayPointer(state),
+                     N_VGetArrayPointer(state) + 4*params.num_points);
+
+        if (replay_file != NULL) {
+            // The topology is that of the lattice given by --rings;
+            // the states come from the file.
+            replay_map = traj_map_open(replay_file);
+            if (replay_map == NULL) {
+                end();
+                return;
+            }
+            if (replay_map->row_size != 1 + 4*params.num_points ||
+                    replay_map->num_frames == 0) {
+                std::cerr << replay_file << " does not hold frames of "
+                          << params.num_points << " points\n";
+                end();
+                return;
+            }
+            // The same speed as the live integration.
+            replay = new Replay(replay_map, dtau.load()/frame_period);
+            const double *f = replay->frame();
+            std::copy(f, f + shown.size(), shown.begin());
+            Fl::add_timeout(frame_period, Replay_CB, (void*)this);
+            end();
+            return;
+        }
 
-        cvode_mem = CVodeCreate(CV_ADAMS, sunctx);
-        if (cvode_mem == NULL) {
-            std::cerr << "darn it\n";
+        if (threaded) {
+            params.schedule = de_schedule_create(&params);
         }
+        if (contact > 0) {
+            params.contact = contact_create(params.num_points, contact);
+        }
+        if (symplectic >= 0) {
+            // The solver statistics are those of CVODE.
+            if (stats_file != NULL) {
+                std::cerr << "--stats does not apply to --symplectic\n";
+            }
+            sym = symplectic_create(symplectic, h, &params, solver_rhs(&params),
+                                    tau, state);
+            if (sym == NULL) {
+                end();
+                return;
+            }
+        }
+        else {
+            // The solver statistics are those of CVODE.
+            if (stats_file != NULL && method == SOLVER_IMEX) {
+                std::cerr << "--stats does not apply to --imex\n";
+            }
+            else if (stats_file != NULL) {
+                params.stats = stats_create(stats_file);
+            }
 
-        flag = CVodeInit(cvode_mem, de, tau, state);
-        flag = CVodeSStolerances(cvode_mem, 1e-10, 1e-12);
-        flag = CVodeSetUserData(cvode_mem, &params);
-        flag = CVodeSetMaxNumSteps(cvode_mem, 500000);
+            // Create the integrator, with the selected linear solver attached.
+            solver = solver_create(method, linsol, &params, tau, state, sunctx);
+            if (solver == NULL) {
+                std::cerr << "darn it\n";
+                end();
+                return;
+            }
+            cvode_mem = solver->cvode_mem;
 
-        // Create dense SUNMatrix for use in linear solves
-        SUNMatrix A = SUNDenseMatrix(4*params.num_points, 4*params.num_points, sunctx);
-        if (!A) {
-            std::cerr << "SUNDenseMatrix() failed.\n";
-        }
+            flag = solver_tolerances(solver, 1e-10, 1e-12);
+            flag = solver_set_max_num_steps(solver, 500000);
 
-        // Create dense SUNLinearSolver object
-        SUNLinearSolver LS = SUNLinSol_Dense(state, A, sunctx);
-        if (!LS) {
-            std::cerr << "SUNLinSol_Dense() failed.\n";
+            flag = solver_set_stop_time(solver, tau1);
+            flag = solver_root_init(solver, contact_num_roots(&params),
+                                    params.stats != NULL ? stats_contact_roots : contact_roots);
         }
 
-        // Attach the matrix and linear solver to CVODE
-        retval = CVodeSetLinearSolver(cvode_mem, LS, A);
-        if (retval) {
-            std::cerr << "CVodeSetLinearSolver() failed.\n";
+        if (record_file != NULL) {
+            record = traj_open(record_file, 4*params.num_points, TRAJ_FLOAT64);
+            if (record != NULL) {
+                record_frame();
+            }
         }
 
-        flag = CVodeSetStopTime(cvode_mem, tau1);
-        flag = CVodeRootInit(cvode_mem, params.num_points, collision);
-
-        crashed = 0;
+        // Start the integration; it runs up to ahead frames ahead of
+        // the display.
+        ring = new FrameRing(ahead, 4*params.num_points);
+        sim = new SimThread(*ring, [this](double *t, double *out) {
+            return step(t, out);
+        });
+        sim->start();
 
         Fl::add_timeout(frame_period, Timer_CB, (void*)this);
         end();
 
         std::cerr << "Playback() returning\n";
     }
+
+    ~Playback()
+    {
+        // The simulation thread must finish before its data goes away.
+        delete sim;
+        delete ring;
+        // (Its GL objects go away with the context.)
+        delete renderer;
+        delete replay;
+        traj_map_close(replay_map);
+        // Writes the frames still buffered.
+        traj_close(record);
+        // Completes and closes the statistics file.
+        stats_free(params.stats);
+        solver_free(&solver);
+        symplectic_free(&sym);
+        contact_free(params.contact);
+        reorder_free(reorder);
+        delete[] params.connections;
+    }
 };
 
 
-int main()
+int main(int argc, char *argv[])
 {
+    int method = SOLVER_ADAMS;
+    int linsol = LINSOL_DENSE;
+    int threaded = 0;
+    int rings = 1;
+    int ahead = 8;
+    const char *stats_file = NULL;
+    int immediate = 0;
+    const char *replay_file = NULL;
+    const char *record_file = NULL;
+    int dense = 0;
+    int symplectic = -1;
+    double h = 0.01;
+    int force_law = FORCE_CUBIC;
+    double contact = 0.0;
+    int reorder = REORDER_NONE;
+
+    // --bdf selects the BDF method, and --imex ARKODE's IMEX method with
+    // implicit springs and explicit gravity; --klu, --spgmr and --spfgmr select
+    // the sparse direct or the matrix-free linear solvers; --threads
+    // selects the OpenMP right-hand side; --rings R makes the hexagon
+    // R rings wide; --ahead N lets the integration run up to N frames
+    // ahead of the display; --stats file writes the solver statistics of each
+    // frame to file (JSON if the name ends with .json, otherwise CSV),
+    // and the 's' key prints them; --immediate draws in OpenGL immediate
+    // mode instead of with the shaders of renderer.cpp; --record file.npy
+    // writes the frames to a trajectory file, and --replay file.npy plays
+    // such a file back instead of integrating (give the same --rings; see
+    // replay.h for the keys, and drag the mouse across the window to
+    // scrub); --dense interpolates the frames from the integrator's own
+    // steps instead of asking CVode() for each; --symplectic verlet,
+    // yoshida4 or yoshida6 integrates with a fixed step symplectic method
+    // (symplectic.h) of step size h (--step h, default 0.01) instead of
+    // CVODE; --force-law cubic, hooke, lj or bilinear selects the force
+    // law of the springs (force_law.h); --contact d also stops the
+    // integration when two points come within d of each other (contact.h;
+    // not with --symplectic); --reorder rcm, morton or hilbert renumbers
+    // the points (reorder.h) so that connected points are near each other
+    // in the state vector, and --reorder random scatters them, the worst
+    // case, for comparison.
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--bdf") {
+            method = SOLVER_BDF;
+        }
+        else if (arg == "--imex") {
+            method = SOLVER_IMEX;
+        }
+        else if (arg == "--klu") {
+            linsol = LINSOL_KLU;
+        }
+        else if (arg == "--spgmr") {
+            linsol = LINSOL_SPGMR;
+        }
+        else if (arg == "--spfgmr") {
+            linsol = LINSOL_SPFGMR;
+        }
+        else if (arg == "--threads") {
+            threaded = 1;
+        }
+        else if (arg == "--rings" && i + 1 < argc) {
+            rings = atoi(argv[++i]);
+        }
+        else if (arg == "--ahead" && i + 1 < argc) {
+            ahead = std::max(1, atoi(argv[++i]));
+        }
+        else if (arg == "--stats" && i + 1 < argc) {
+            stats_file = argv[++i];
+        }
+        else if (arg == "--immediate") {
+            immediate = 1;
+        }
+        else if (arg == "--replay" && i + 1 < argc) {
+            replay_file = argv[++i];
+        }
+        else if (arg == "--record" && i + 1 < argc) {
+            record_file = argv[++i];
+        }
+        else if (arg == "--dense") {
+            dense = 1;
+        }
+        else if (arg == "--symplectic" && i + 1 < argc &&
+                 symplectic_method(argv[i + 1]) >= 0) {
+            symplectic = symplectic_method(argv[++i]);
+        }
+        else if (arg == "--step" && i + 1 < argc) {
+            h = atof(argv[++i]);
+        }
+        else if (arg == "--contact" && i + 1 < argc) {
+            contact = atof(argv[++i]);
+        }
+        else if (arg == "--force-law" && i + 1 < argc &&
+                 force_law_lookup(argv[i + 1]) >= 0) {
+            force_law = force_law_lookup(argv[++i]);
+        }
+        else if (arg == "--reorder" && i + 1 < argc &&
+                 reorder_method(argv[i + 1]) >= 0) {
+            reorder = reorder_method(argv[++i]);
+        }
+        else {
+            std::cerr << "usage: " << argv[0]
+                      << " [--bdf | --imex] [--klu | --spgmr | --spfgmr] [--threads]"
+                      << " [--rings R] [--ahead N] [--stats file] [--immediate]"
+                      << " [--record file.npy | --replay file.npy] [--dense]"
+                      << " [--symplectic verlet|yoshida4|yoshida6 [--step h]]"
+                      << " [--force-law cubic|hooke|lj|bilinear] [--contact d]"
+                      << " [--reorder rcm|morton|hilbert|random]\n";
+            return 1;
+        }
+    }
+
     Fl_Window win(720, 720);
-    Playback playback(10, 10, win.w()-20, win.h()-20);
+    Playback playback(10, 10, win.w()-20, win.h()-20, method, linsol,
+                      threaded, rings, ahead, stats_file, immediate,
+                      replay_file, record_file, dense, symplectic, h,
+                      force_law, contact, reorder);
     win.resizable(&playback);
     win.show();
     return(Fl::run());
@@ -3,15 +3,30 @@
 #include <FL/gl.h>
 #include <math.h>
 #include <iostream>
-
-#include <cvode/cvode.h>
-#include <nvector/nvector_serial.h>
-#include <cvode/cvode_dense.h>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <string>
+#include <stdlib.h>
+
+#include <sundials/sundials_core.h>     // Provides core SUNDIALS types
+#include <cvode/cvode.h>                // CVODE provides linear multistep methods
+#include <nvector/nvector_serial.h>     // access to serial N_Vector
+#include <sunlinsol/sunlinsol_dense.h>  // access to dense SUNLinearSolver
+#include <sunmatrix/sunmatrix_dense.h>  // access to dense SUNMatrix
 
 #include "de.h"
+#include "frame_ring.h"
+#include "symplectic.h"
 
 // Warning: Poorly designed C++ code ahead...
 
+// SUNDIALS context
+static SUNContext sunctx = NULL;
+
+// Number of frames the integration may run ahead of the display.
+#define RUN_AHEAD 8
+
 #define ORIGIN         0
 #define CENTER_OF_MASS 1
 
@@ -27,9 +42,19 @@ class Playback : public Fl_Gl_Window {
     N_Vector state;
 
     void *cvode_mem;
-    realtype tau;
-    realtype dtau;
-    realtype tau1;
+    SUNMatrix A;
+    SUNLinearSolver LS;
+    sunrealtype tau;
+    std::atomic<double> dtau;
+    sunrealtype tau1;
+    // With --symplectic, the fixed step integrator that replaces CVODE.
+    symplectic_t *sym;
+
+    // The integration runs in sim, which publishes the frames in ring;
+    // shown is the state of the frame on the screen.
+    FrameRing *ring;
+    SimThread *sim;
+    std::vector<double> shown;
 
     int crashed;
     double scale;
@@ -51,9 +76,9 @@ class Playback : public Fl_Gl_Window {
         }
         glClear(GL_COLOR_BUFFER_BIT);
 
-        xc = NV_Ith_S(state, 0);
-        yc = NV_Ith_S(state, 1);
-        theta = NV_Ith_S(state, 2);
+        xc = shown[0];
+        yc = shown[1];
+        theta = shown[2];
 
         ox = 0.0;
         oy = 0.0;
@@ -92,24 +117,47 @@ class Playback : public Fl_Gl_Window {
     }
 
     //
-    // Called repeatedly to redraw the window.
+    // Advance the integration by one frame (in the simulation thread).
     //
-    static void Timer_CB(void *userdata)
+    int step(double *t, double *out)
     {
         int flag;
-        Playback *pb = (Playback*)userdata;
 
-        if (pb->cvode_mem == NULL) {
-            std::cerr << "pb->cvode_mem is NULL!\n";
+        if (sym != NULL) {
+            flag = symplectic_evolve(sym, std::min(tau + dtau.load(), (double)tau1),
+                                     state, &tau);
+            if (flag == SYMPLECTIC_SUCCESS && tau >= tau1) {
+                flag = CV_TSTOP_RETURN;
+            }
+        }
+        else {
+            flag = CVode(cvode_mem, tau + dtau.load(), state, &tau, CV_NORMAL);
         }
-        flag = CVode(pb->cvode_mem, pb->tau + pb->dtau, pb->state,
-                     &(pb->tau), CV_NORMAL);
-        if (flag == CV_ROOT_RETURN) {
-            pb->crashed = 1;
+        *t = tau;
+        std::copy(N_VGetArrayPointer(state), N_VGetArrayPointer(state) + 6, out);
+        return flag == CV_SUCCESS ? 0 : flag;
+    }
 
+    //
+    // Called repeatedly to redraw the window.
+    //
+    static void Timer_CB(void *userdata)
+    {
+        Playback *pb = (Playback*)userdata;
+        const FrameRing::Frame *f;
+        int done = 0;
+
+        f = pb->ring->front();
+        if (f != NULL) {
+            std::copy(f->state, f->state + 6, pb->shown.begin());
+            if (f->flag == CV_ROOT_RETURN) {
+                pb->crashed = 1;
+            }
+            done = f->flag != 0;
+            pb->ring->pop();
+            pb->redraw();
         }
-        pb->redraw();
-        if (!pb->crashed) {
+        if (!done) {
             Fl::repeat_timeout(pb->frame_period, Timer_CB, userdata);
         }
     }
@@ -128,10 +176,10 @@ public:
             c = Fl::event_text()[0];
             std::cerr << Fl::event_key() << " '" << c << "'\n";
             if (c == '+') {
-                dtau *= 2.0;
+                dtau.store(2.0*dtau.load());
             }
             else if (c == '-') {
-                dtau *= 0.5;
+                dtau.store(0.5*dtau.load());
             }
             else if (c == 'o') {
                 center = ORIGIN;
@@ -150,10 +198,21 @@ public:
     }
 
     // Constructor
-    Playback(int X, int Y, int W, int H, const char*L=0) : Fl_Gl_Window(X,Y,W,H,L)
+    Playback(int X, int Y, int W, int H, int symplectic=-1, double h=0.01,
+             const char*L=0) : Fl_Gl_Window(X,Y,W,H,L)
     {
         int flag;
-        double *p;
+
+        ring = NULL;
+        sim = NULL;
+        cvode_mem = NULL;
+        A = NULL;
+        LS = NULL;
+        sym = NULL;
+        if (SUNContext_Create(SUN_COMM_NULL, &sunctx)) {
+            std::cerr << "SUNContext_Create() failed.\n";
+            return;
+        }
 
         frame = 0;
         frame_period = 1.0/24.0;
@@ -164,7 +223,7 @@ public:
         params.g = 8.0;
         params.r0 = 0.5;
 
-        state = N_VNew_Serial(6);
+        state = N_VNew_Serial(6, sunctx);
         NV_Ith_S(state, 0) = 9.0;
         NV_Ith_S(state, 1) = 9.0;
         NV_Ith_S(state, 2) = 0.0;
@@ -174,36 +233,84 @@ public:
         NV_Ith_S(state, 5) =  0.0;
 
 
-        tau = RCONST(0.0);
-        dtau = RCONST(0.125);
-        tau1 = RCONST(2500.0);
+        tau = SUN_RCONST(0.0);
+        dtau = SUN_RCONST(0.125);
+        tau1 = SUN_RCONST(2500.0);
 
-        cvode_mem = CVodeCreate(CV_ADAMS, CV_FUNCTIONAL);
-        if (cvode_mem == NULL) {
-            std::cerr << "darn it\n";
+        if (symplectic >= 0) {
+            // (This one stops at a collision with the central disk.)
+            sym = symplectic_create_rigid_hex(symplectic, h, &params, tau, state);
+            if (sym == NULL) {
+                end();
+                return;
+            }
         }
+        else {
+            cvode_mem = CVodeCreate(CV_ADAMS, sunctx);
+            if (cvode_mem == NULL) {
+                std::cerr << "darn it\n";
+            }
 
-        flag = CVodeInit(cvode_mem, de_rigid_hex, tau, state);
-        flag = CVodeSStolerances(cvode_mem, 1e-10, 1e-12);
-        flag = CVodeSetUserData(cvode_mem, &params);
-        flag = CVodeSetMaxNumSteps(cvode_mem, 100000);
-        flag = CVDense(cvode_mem, 6);
-        flag = CVodeSetStopTime(cvode_mem, tau1);
-        // flag = CVodeRootInit(cvode_mem, params.num_points, collision);
+            flag = CVodeInit(cvode_mem, de_rigid_hex, tau, state);
+            flag = CVodeSStolerances(cvode_mem, 1e-10, 1e-12);
+            flag = CVodeSetUserData(cvode_mem, &params);
+            flag = CVodeSetMaxNumSteps(cvode_mem, 100000);
+            A = SUNDenseMatrix(6, 6, sunctx);
+            LS = SUNLinSol_Dense(state, A, sunctx);
+            flag = CVodeSetLinearSolver(cvode_mem, LS, A);
+            flag = CVodeSetStopTime(cvode_mem, tau1);
+            // flag = CVodeRootInit(cvode_mem, params.num_points, collision);
+        }
 
         crashed = 0;
         scale = 12.5;
 
+        shown.assign(N_VGetArrayPointer(state), N_VGetArrayPointer(state) + 6);
+        ring = new FrameRing(RUN_AHEAD, 6);
+        sim = new SimThread(*ring, [this](double *t, double *out) {
+            return step(t, out);
+        });
+        sim->start();
+
         Fl::add_timeout(frame_period, Timer_CB, (void*)this);
         end();
     }
+
+    ~Playback()
+    {
+        delete sim;
+        delete ring;
+        symplectic_free(&sym);
+    }
 };
 
 
-int main()
+int main(int argc, char *argv[])
 {
+    int symplectic = -1;
+    double h = 0.01;
+
+    // --symplectic verlet, yoshida4 or yoshida6 integrates with a fixed
+    // step symplectic method (symplectic.h) of step size h (--step h,
+    // default 0.01) instead of CVODE.
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--symplectic" && i + 1 < argc &&
+                symplectic_method(argv[i + 1]) >= 0) {
+            symplectic = symplectic_method(argv[++i]);
+        }
+        else if (arg == "--step" && i + 1 < argc) {
+            h = atof(argv[++i]);
+        }
+        else {
+            std::cerr << "usage: " << argv[0]
+                      << " [--symplectic verlet|yoshida4|yoshida6 [--step h]]\n";
+            return 1;
+        }
+    }
+
     Fl_Window win(720, 720);
-    Playback playback(10, 10, win.w()-20, win.h()-20);
+    Playback playback(10, 10, win.w()-20, win.h()-20, symplectic, h);
     win.resizable(&playback);
     win.show();
     return(Fl::run());
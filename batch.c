@@ -0,0 +1,425 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "batch.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+batch_t *batch_create(int num_members, int num_points,
+                      int num_connections, const int *connections)
+{
+    batch_t *batch;
+    size_t n = (size_t) 4 * num_points * num_members;
+    int m;
+
+    batch = calloc(1, sizeof(batch_t));
+    if (batch == NULL) {
+        goto fail;
+    }
+    batch->num_members = num_members;
+    batch->num_points = num_points;
+    batch->num_connections = num_connections;
+    batch->connections = malloc(2*num_connections * sizeof(int));
+    batch->k = calloc(num_members, sizeof(double));
+    batch->L = calloc(num_members, sizeof(double));
+    batch->b = calloc(num_members, sizeof(double));
+    batch->g = calloc(num_members, sizeof(double));
+    batch->r0 = calloc(num_members, sizeof(double));
+    batch->w = calloc(n, sizeof(double));
+    batch->t = calloc(num_members, sizeof(double));
+    batch->steps = calloc(num_members, sizeof(long));
+    batch->status = calloc(num_members, sizeof(int));
+    batch->work = malloc(6 * n * sizeof(double));
+    batch->h = calloc(num_members, sizeof(double));
+    if (batch->connections == NULL || batch->k == NULL || batch->L == NULL ||
+            batch->b == NULL || batch->g == NULL || batch->r0 == NULL ||
+            batch->w == NULL || batch->t == NULL || batch->steps == NULL ||
+            batch->status == NULL || batch->work == NULL || batch->h == NULL) {
+        goto fail;
+    }
+    memcpy(batch->connections, connections, 2*num_connections * sizeof(int));
+    for (m = 0; m < num_members; ++m) {
+        batch->status[m] = BATCH_RUNNING;
+    }
+    return batch;
+
+fail:
+    fprintf(stderr, "batch_create: out of memory\n");
+    batch_free(batch);
+    return NULL;
+}
+
+void batch_free(batch_t *batch)
+{
+    if (batch == NULL) {
+        return;
+    }
+    free(batch->connections);
+    free(batch->k);
+    free(batch->L);
+    free(batch->b);
+    free(batch->g);
+    free(batch->r0);
+    free(batch->w);
+    free(batch->t);
+    free(batch->steps);
+    free(batch->status);
+    free(batch->work);
+    free(batch->h);
+    free(batch);
+}
+
+//
+// Copy the state y of one member (in the layout used by de()) into the
+// batch, and back.
+//
+void batch_set_state(batch_t *batch, int m, const double *y)
+{
+    int M = batch->num_members;
+    int c;
+
+    for (c = 0; c < 4*batch->num_points; ++c) {
+        batch->w[(size_t) c*M + m] = y[c];
+    }
+}
+
+void batch_get_state(const batch_t *batch, int m, double *y)
+{
+    int M = batch->num_members;
+    int c;
+
+    for (c = 0; c < 4*batch->num_points; ++c) {
+        y[c] = batch->w[(size_t) c*M + m];
+    }
+}
+
+//
+// The vector field of de() for members m0, ..., m1-1.  w and f are
+// interleaved like batch->w.  The spring force is written as
+// k*L**3/r**2 - k*r, the same cubic law as spring_force() in de.c;
+// the two must be kept in sync.
+//
+void batch_de(const batch_t *batch, int m0, int m1, const double *w, double *f)
+{
+    size_t M = batch->num_members;
+    int N = batch->num_points;
+    const double *vel = w + 2*N*M;
+    double *acc = f + 2*N*M;
+    const double *k = batch->k;
+    const double *L = batch->L;
+    const double *b = batch->b;
+    const double *g = batch->g;
+    int c, idx, m;
+
+    for (c = 0; c < 2*N; ++c) {
+        memcpy(f + c*M + m0, vel + c*M + m0, (m1 - m0) * sizeof(double));
+        memset(acc + c*M + m0, 0, (m1 - m0) * sizeof(double));
+    }
+
+    for (idx = 0; idx < batch->num_connections; ++idx) {
+        int i = batch->connections[2*idx];
+        int j = batch->connections[2*idx + 1];
+        const double *xi = w + 2*i*M, *yi = xi + M;
+        const double *xj = w + 2*j*M, *yj = xj + M;
+        const double *ui = vel + 2*i*M, *vi = ui + M;
+        const double *uj = vel + 2*j*M, *vj = uj + M;
+        double *axi = acc + 2*i*M, *ayi = axi + M;
+        double *axj = acc + 2*j*M, *ayj = axj + M;
+
+        #pragma omp simd
+        for (m = m0; m < m1; ++m) {
+            double dx, dy, d2, rinv, r, s, force, cc;
+
+            dx = xj[m] - xi[m];
+            dy = yj[m] - yi[m];
+            d2 = dx*dx + dy*dy;
+            rinv = 1.0/sqrt(d2);
+            r = d2*rinv;
+            // s is the rate of change of the distance between i and j.
+            s = ((uj[m] - ui[m])*dx + (vj[m] - vi[m])*dy)*rinv;
+            // Spring force minus friction force, acting on j.
+            force = k[m]*L[m]*L[m]*L[m]*rinv*rinv - k[m]*r - b[m]*s;
+            cc = force*rinv;
+            axi[m] -= cc*dx;
+            ayi[m] -= cc*dy;
+            axj[m] += cc*dx;
+            ayj[m] += cc*dy;
+        }
+    }
+
+    for (idx = 0; idx < N; ++idx) {
+        const double *x = w + 2*idx*M, *y = x + M;
+        double *ax = acc + 2*idx*M, *ay = ax + M;
+
+        #pragma omp simd
+        for (m = m0; m < m1; ++m) {
+            // (For the members with g = 0, 1 is added to keep rinv finite
+            // at the origin.)
+            double d2 = x[m]*x[m] + y[m]*y[m] + (g[m] > 0 ? 0.0 : 1.0);
+            double rinv = 1.0/sqrt(d2);
+            double gr3 = g[m]*rinv*rinv*rinv;
+            ax[m] -= gr3*x[m];
+            ay[m] -= gr3*y[m];
+        }
+    }
+}
+
+//
+// y = w + a*h*k for members m0, ..., m1-1, where h[m - m0] is the step
+// of member m (0 for the members that are not running).
+//
+static void stage(const batch_t *batch, int m0, int m1, const double *h,
+                  const double *w, double a, const double *k, double *y)
+{
+    size_t M = batch->num_members;
+    int nm = m1 - m0;
+    size_t c;
+    int q;
+
+    for (c = 0; c < 4*(size_t) batch->num_points; ++c) {
+        const double *wc = w + c*M + m0, *kc = k + c*M + m0;
+        double *yc = y + c*M + m0;
+        #pragma omp simd
+        for (q = 0; q < nm; ++q) {
+            yc[q] = wc[q] + a*h[q]*kc[q];
+        }
+    }
+}
+
+//
+// Mark as collided the members m0, ..., m1-1 with moved[m] != 0 that
+// have a point within r0 of the origin (only when g > 0, as in
+// collision()).  A collision is detected at the end of a step; it is
+// not located within the step as CVODE's root finding does.
+//
+static void check_collision(batch_t *batch, int m0, int m1, const int *moved)
+{
+    size_t M = batch->num_members;
+    int nm = m1 - m0;
+    double d2min[BATCH_CHUNK];
+    int idx, m, q;
+
+    for (q = 0; q < nm; ++q) {
+        d2min[q] = INFINITY;
+    }
+    for (idx = 0; idx < batch->num_points; ++idx) {
+        const double *x = batch->w + 2*idx*M + m0, *y = x + M;
+        #pragma omp simd
+        for (q = 0; q < nm; ++q) {
+            double d2 = x[q]*x[q] + y[q]*y[q];
+            d2min[q] = d2 < d2min[q] ? d2 : d2min[q];
+        }
+    }
+    for (m = m0; m < m1; ++m) {
+        if (moved[m - m0] && batch->g[m] > 0 &&
+                d2min[m - m0] < batch->r0[m]*batch->r0[m]) {
+            batch->status[m] = BATCH_COLLISION;
+        }
+    }
+}
+
+static void rk4_chunk(batch_t *batch, int m0, int m1,
+                      double t0, double t1, int nsteps)
+{
+    size_t M = batch->num_members;
+    size_t n = 4*(size_t) batch->num_points*M;
+    double *w = batch->w;
+    double *k1 = batch->work, *k2 = k1 + n, *k3 = k2 + n, *k4 = k3 + n;
+    double *y = k4 + n;
+    double dt = (t1 - t0)/nsteps;
+    int nm = m1 - m0;
+    double h[BATCH_CHUNK];
+    int moved[BATCH_CHUNK];
+    size_t c;
+    int step, m, q;
+
+    for (m = m0; m < m1; ++m) {
+        batch->t[m] = t0;
+        batch->steps[m] = 0;
+    }
+
+    for (step = 0; step < nsteps; ++step) {
+        for (m = m0; m < m1; ++m) {
+            moved[m - m0] = batch->status[m] == BATCH_RUNNING;
+            h[m - m0] = moved[m - m0] ? dt : 0.0;
+        }
+        batch_de(batch, m0, m1, w, k1);
+        stage(batch, m0, m1, h, w, 0.5, k1, y);
+        batch_de(batch, m0, m1, y, k2);
+        stage(batch, m0, m1, h, w, 0.5, k2, y);
+        batch_de(batch, m0, m1, y, k3);
+        stage(batch, m0, m1, h, w, 1.0, k3, y);
+        batch_de(batch, m0, m1, y, k4);
+        for (c = m0; c < n; c += M) {
+            #pragma omp simd
+            for (q = 0; q < nm; ++q) {
+                w[c + q] += h[q]/6*(k1[c + q] + 2*(k2[c + q] + k3[c + q]) + k4[c + q]);
+            }
+        }
+        for (m = m0; m < m1; ++m) {
+            if (moved[m - m0]) {
+                batch->t[m] = t0 + (step + 1)*dt;
+                ++batch->steps[m];
+            }
+        }
+        check_collision(batch, m0, m1, moved);
+    }
+
+    for (m = m0; m < m1; ++m) {
+        if (batch->status[m] == BATCH_RUNNING) {
+            batch->status[m] = BATCH_DONE;
+        }
+    }
+}
+
+//
+// Integrate all the running members from t0 to t1 with nsteps steps of
+// the classical fourth order Runge-Kutta method.
+//
+void batch_rk4(batch_t *batch, double t0, double t1, int nsteps)
+{
+    int m0;
+
+    #pragma omp parallel for schedule(dynamic)
+    for (m0 = 0; m0 < batch->num_members; m0 += BATCH_CHUNK) {
+        int m1 = m0 + BATCH_CHUNK;
+        if (m1 > batch->num_members) {
+            m1 = batch->num_members;
+        }
+        rk4_chunk(batch, m0, m1, t0, t1, nsteps);
+    }
+}
+
+static void bs23_chunk(batch_t *batch, int m0, int m1, double t0, double t1,
+                       double rtol, double atol, long max_steps)
+{
+    size_t M = batch->num_members;
+    size_t n = 4*(size_t) batch->num_points*M;
+    double *w = batch->w;
+    double *k1 = batch->work, *k2 = k1 + n, *k3 = k2 + n, *k4 = k3 + n;
+    double *y = k4 + n, *ynew = y + n;
+    double *h = batch->h;
+    int nm = m1 - m0;
+    double hs[BATCH_CHUNK], err2[BATCH_CHUNK];
+    int accepted[BATCH_CHUNK];
+    int running;
+    size_t c;
+    int m, q;
+
+    running = 0;
+    for (m = m0; m < m1; ++m) {
+        batch->t[m] = t0;
+        batch->steps[m] = 0;
+        h[m] = 1e-3*(t1 - t0);
+        running += batch->status[m] == BATCH_RUNNING;
+    }
+    batch_de(batch, m0, m1, w, k1);
+
+    while (running > 0) {
+        for (m = m0; m < m1; ++m) {
+            double hm = fmin(h[m], t1 - batch->t[m]);
+            hs[m - m0] = batch->status[m] == BATCH_RUNNING ? hm : 0.0;
+            err2[m - m0] = 0.0;
+        }
+        // Stages of the Bogacki-Shampine 3(2) pair (k4 is the first stage
+        // of the next step).
+        stage(batch, m0, m1, hs, w, 0.5, k1, y);
+        batch_de(batch, m0, m1, y, k2);
+        stage(batch, m0, m1, hs, w, 0.75, k2, y);
+        batch_de(batch, m0, m1, y, k3);
+        for (c = m0; c < n; c += M) {
+            #pragma omp simd
+            for (q = 0; q < nm; ++q) {
+                ynew[c + q] = w[c + q] + hs[q]*(2.0/9*k1[c + q] + 1.0/3*k2[c + q]
+                                                + 4.0/9*k3[c + q]);
+            }
+        }
+        batch_de(batch, m0, m1, ynew, k4);
+        for (c = m0; c < n; c += M) {
+            #pragma omp simd
+            for (q = 0; q < nm; ++q) {
+                double est = hs[q]*(-5.0/72*k1[c + q] + 1.0/12*k2[c + q]
+                                    + 1.0/9*k3[c + q] - 1.0/8*k4[c + q]);
+                double a0 = fabs(w[c + q]), a1 = fabs(ynew[c + q]);
+                double sc = atol + rtol*(a0 > a1 ? a0 : a1);
+                err2[q] += (est/sc)*(est/sc);
+            }
+        }
+
+        for (m = m0; m < m1; ++m) {
+            double errn, factor;
+
+            accepted[m - m0] = 0;
+            if (batch->status[m] != BATCH_RUNNING) {
+                continue;
+            }
+            errn = sqrt(err2[m - m0]/(4*batch->num_points));
+            if (errn <= 1.0) {
+                accepted[m - m0] = 1;
+                batch->t[m] += hs[m - m0];
+                ++batch->steps[m];
+                factor = errn > 0 ? 0.9*pow(errn, -1.0/3) : 5.0;
+                factor = fmin(factor, 5.0);
+            }
+            else if (errn > 1.0) {
+                factor = fmax(0.9*pow(errn, -1.0/3), 0.2);
+            }
+            else {
+                // errn is nan.
+                factor = 0.2;
+            }
+            h[m] = hs[m - m0]*factor;
+            if (accepted[m - m0] && batch->t[m] >= t1 - 1e-12*fabs(t1)) {
+                batch->status[m] = BATCH_DONE;
+            }
+            else if (batch->steps[m] >= max_steps) {
+                batch->status[m] = BATCH_MAXSTEPS;
+            }
+            else if (h[m] <= 1e-14*fabs(batch->t[m])) {
+                batch->status[m] = BATCH_FAILED;
+            }
+        }
+
+        for (c = m0; c < n; c += M) {
+            #pragma omp simd
+            for (q = 0; q < nm; ++q) {
+                w[c + q] = accepted[q] ? ynew[c + q] : w[c + q];
+                k1[c + q] = accepted[q] ? k4[c + q] : k1[c + q];
+            }
+        }
+        check_collision(batch, m0, m1, accepted);
+
+        running = 0;
+        for (m = m0; m < m1; ++m) {
+            running += batch->status[m] == BATCH_RUNNING;
+        }
+    }
+}
+
+//
+// Integrate all the running members from t0 to t1 with the Bogacki-Shampine
+// 3(2) method (the method of MATLAB's ode23), each member with its own
+// adaptive step.  In a chunk, the members that have finished stay in the
+// vector loops with a step of zero until the whole chunk has finished.
+//
+void batch_bs23(batch_t *batch, double t0, double t1,
+                double rtol, double atol, long max_steps)
+{
+    int m0;
+
+    #pragma omp parallel for schedule(dynamic)
+    for (m0 = 0; m0 < batch->num_members; m0 += BATCH_CHUNK) {
+        int m1 = m0 + BATCH_CHUNK;
+        if (m1 > batch->num_members) {
+            m1 = batch->num_members;
+        }
+        bs23_chunk(batch, m0, m1, t0, t1, rtol, atol, max_steps);
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,64 @@
+#ifndef _BATCH_H_
+#define _BATCH_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// Many independent copies ("members") of a small system of point masses,
+// all with the same connections but each with its own parameters, are
+// integrated together.  The state is interleaved with the member index
+// fastest: component c (in the layout used by de(), i.e. the positions of
+// all the points followed by their velocities) of member m is
+// w[c*num_members + m].  Every loop over the members is then a unit
+// stride loop that the compiler vectorizes, so one SIMD lane evaluates
+// the vector field of one member.
+//
+// The members are integrated in chunks of BATCH_CHUNK members, and the
+// chunks are distributed over the OpenMP threads.
+//
+
+#define BATCH_CHUNK 256
+
+// Values of status[m].
+#define BATCH_RUNNING   0
+#define BATCH_DONE      1
+#define BATCH_COLLISION 2
+#define BATCH_MAXSTEPS  3
+#define BATCH_FAILED    4
+
+typedef struct _batch {
+    int num_members;
+    int num_points;
+    int num_connections;
+    /* connections is an array of length 2*num_connections (a copy). */
+    int *connections;
+    /* Parameters of each member; arrays of length num_members. */
+    double *k, *L, *b, *g, *r0;
+    /* State of all the members, length 4*num_points*num_members. */
+    double *w;
+    /* Current time, number of steps, and status of each member. */
+    double *t;
+    long *steps;
+    int *status;
+    /* Work space for the integrators: 6 arrays the size of w, and h. */
+    double *work;
+    double *h;
+} batch_t;
+
+batch_t *batch_create(int num_members, int num_points,
+                      int num_connections, const int *connections);
+void batch_free(batch_t *batch);
+void batch_set_state(batch_t *batch, int m, const double *y);
+void batch_get_state(const batch_t *batch, int m, double *y);
+void batch_de(const batch_t *batch, int m0, int m1, const double *w, double *f);
+void batch_rk4(batch_t *batch, double t0, double t1, int nsteps);
+void batch_bs23(batch_t *batch, double t0, double t1,
+                double rtol, double atol, long max_steps);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
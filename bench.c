@@ -0,0 +1,193 @@
+//
+// Benchmark suite.  The sections (bench.h) time:
+//
+//   - the right-hand sides de(), de3() and de_rigid_hex(), and the
+//     specializations of de_fixed.h against de();
+//   - de() and those specializations with each force law (force_law.h);
+//   - de_rigid() (rigid.h) for swarms of rigid hexagons, against
+//     de_rigid_hex();
+//   - the root functions collision() and contact_roots() (contact.h);
+//   - complete integrations with each method and linear solver, over a
+//     range of hexagonal lattices, and with each of the root functions;
+//   - springs broken and formed one at a time (bonds.h), against
+//     rebuilding the edge coloring, the structure of arrays and the
+//     Jacobian pattern;
+//   - the orders of the points of reorder.h: the bandwidth, the time of
+//     de() and the fill-in of KLU;
+//   - output at increasing frame rates, with CVode() called for every
+//     frame and with solver_dense();
+//   - multirate integration (multirate.h) against CVODE, with and without
+//     the mutual gravity;
+//   - the methods, including IMEX, on increasingly stiff springs.
+//
+// usage: bench [-r max_rings] [-t t_end] [-o result.json]
+//
+// The results are written as JSON (to stdout by default), so the results
+// of two builds can be compared; progress goes to stderr.  Timings of a
+// single function call are repeated until at least MIN_TIME seconds have
+// passed.  peak_rss_kb is the peak resident set size of the process so
+// far (getrusage()), so it only grows from one entry to the next.
+//
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include <sundials/sundials_core.h>
+#include <nvector/nvector_serial.h>
+
+#include "de.h"
+#include "bench.h"
+#include "lattice.h"
+#include "timer.h"
+
+long peak_rss_kb(void)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+//
+// Seconds per call of the right-hand side f.
+//
+double time_rhs(CVRhsFn f, N_Vector w, N_Vector fw, void *params)
+{
+    long n, count = 0;
+    double t0 = timer_now(), t;
+
+    for (n = 1; ; n *= 2) {
+        long i;
+        for (i = 0; i < n; ++i) {
+            f(0.0, w, fw, params);
+        }
+        count += n;
+        t = timer_now() - t0;
+        if (t >= MIN_TIME) {
+            return t/count;
+        }
+    }
+}
+
+double time_root(CVRootFn g, N_Vector w, sunrealtype *gout, void *params)
+{
+    long n, count = 0;
+    double t0 = timer_now(), t;
+
+    for (n = 1; ; n *= 2) {
+        long i;
+        for (i = 0; i < n; ++i) {
+            g(0.0, w, gout, params);
+        }
+        count += n;
+        t = timer_now() - t0;
+        if (t >= MIN_TIME) {
+            return t/count;
+        }
+    }
+}
+
+//
+// A hexagon of the given rings in a circular orbit at a distance of
+// 9 + 2*rings*L from the center, spinning so that the springs are
+// stretched and oscillate.  Exits if the lattice cannot be built, so the
+// callers need not check.
+//
+N_Vector orbiting_hexagon(int rings, xparams_t *params, SUNContext sunctx)
+{
+    lattice_spec_t spec;
+    N_Vector w;
+    double d;
+
+    xparams_init(params);
+    params->k = 2.5;
+    params->L = 1.5;
+    params->b = 0.5;
+    params->g = 8.0;
+    params->r0 = 0.25;
+
+    d = 9.0 + 2*rings*params->L;
+    lattice_spec_init(&spec);
+    spec.rings = rings;
+    spec.L = params->L;
+    spec.cx = d;
+    spec.v = sqrt(params->g/d);
+    spec.omega = 0.1;
+    if (lattice_size(&spec, &params->num_points, &params->num_connections) != 0) {
+        fprintf(stderr, "orbiting_hexagon: no lattice of %d rings\n", rings);
+        exit(-1);
+    }
+    params->connections = malloc(2*params->num_connections * sizeof(int));
+    w = N_VNew_Serial(4*params->num_points, sunctx);
+    if (params->connections == NULL || w == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(-1);
+    }
+    lattice_build(&spec, N_VGetArrayPointer(w), params->connections);
+    return w;
+}
+
+int main(int argc, char *argv[])
+{
+    int max_rings = 16;
+    double t_end = 5.0;
+    const char *filename = NULL;
+    FILE *out = stdout;
+    SUNContext sunctx;
+    int i;
+
+    for (i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            max_rings = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            t_end = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            filename = argv[++i];
+        }
+        else {
+            fprintf(stderr, "usage: %s [-r max_rings] [-t t_end] [-o result.json]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+    if (filename != NULL) {
+        out = fopen(filename, "w");
+        if (out == NULL) {
+            fprintf(stderr, "%s: cannot open %s\n", argv[0], filename);
+            return -1;
+        }
+    }
+
+    if (SUNContext_Create(SUN_COMM_NULL, &sunctx)) {
+        fprintf(stderr, "SUNContext_Create() failed.\n");
+        return -1;
+    }
+
+    fprintf(out, "{\n");
+#ifdef __VERSION__
+    fprintf(out, "  \"compiler\": \"%s\",\n", __VERSION__);
+#endif
+    fprintf(out, "  \"date\": %ld,\n", (long) time(NULL));
+    bench_rhs(out, max_rings, sunctx);
+    bench_force_laws(out, max_rings, sunctx);
+    bench_rigid(out, sunctx);
+    bench_integrations(out, max_rings, t_end, sunctx);
+    bench_roots(out, max_rings, t_end, sunctx);
+    bench_bonds(out, max_rings, sunctx);
+    bench_reorder(out, max_rings, sunctx);
+    bench_frames(out, t_end, sunctx);
+    bench_multirate(out, max_rings, t_end, sunctx);
+    bench_stiffness(out, t_end, sunctx);
+    fprintf(out, "  \"peak_rss_kb\": %ld\n}\n", peak_rss_kb());
+
+    if (out != stdout) {
+        fclose(out);
+    }
+    SUNContext_Free(&sunctx);
+    return 0;
+}
@@ -0,0 +1,58 @@
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+
+#include <sundials/sundials_core.h>
+#include <cvode/cvode.h>
+#include <nvector/nvector_serial.h>
+
+#include "de.h"
+
+//
+// The benchmark suite bench (bench.c), in sections, each of which writes
+// one array of the JSON results:
+//
+//   bench_rhs.c:          rhs, force_laws, rigid
+//   bench_solver.c:       integrations, roots, frames, multirate,
+//                         stiffness
+//   bench_connections.c:  bonds, reorder
+//
+// and the helpers they share, in bench.c.
+//
+
+// Timings of a single call are repeated for at least this many seconds.
+#define MIN_TIME 0.2
+
+// Contact distance of contact_roots() with contacts.
+#define CONTACT_DISTANCE 0.1
+
+long peak_rss_kb(void);
+double time_rhs(CVRhsFn f, N_Vector w, N_Vector fw, void *params);
+double time_root(CVRootFn g, N_Vector w, sunrealtype *gout, void *params);
+N_Vector orbiting_hexagon(int rings, xparams_t *params, SUNContext sunctx);
+
+void bench_rhs(FILE *out, int max_rings, SUNContext sunctx);
+void bench_force_laws(FILE *out, int max_rings, SUNContext sunctx);
+void bench_rigid(FILE *out, SUNContext sunctx);
+
+void bench_integrations(FILE *out, int max_rings, double t_end,
+                        SUNContext sunctx);
+void bench_roots(FILE *out, int max_rings, double t_end, SUNContext sunctx);
+void bench_frames(FILE *out, double t_end, SUNContext sunctx);
+void bench_stiffness(FILE *out, double t_end, SUNContext sunctx);
+void bench_multirate(FILE *out, int max_rings, double t_end,
+                     SUNContext sunctx);
+
+void bench_bonds(FILE *out, int max_rings, SUNContext sunctx);
+void bench_reorder(FILE *out, int max_rings, SUNContext sunctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
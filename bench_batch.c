@@ -0,0 +1,123 @@
+//
+// Throughput of the batched integrators in batch.c for an ensemble of
+// hexagons (the system of animate_dynamics2), each member with its own
+// spring constant and initial velocity.
+//
+// usage: bench_batch [members [t1]]
+//
+// The ensemble is integrated from 0 to t1 with batch_rk4() (step 0.01)
+// and with batch_bs23() (rtol 1e-6, atol 1e-9).  Reports members per
+// second, member steps per second, the number of members in each final
+// state, and the largest difference between the final states of the two
+// integrations.
+//
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "de.h"
+#include "batch.h"
+#include "timer.h"
+
+#define RK4_DT 0.01
+
+static void initial_state(batch_t *batch, double *w0)
+{
+    double y[4*HEX_NUM_POINTS];
+    int m, i;
+
+    for (m = 0; m < batch->num_members; ++m) {
+        double v0 = 0.45*(0.9 + 0.2*rand()/(double) RAND_MAX);
+
+        batch->k[m] = 2.5*(0.9 + 0.2*rand()/(double) RAND_MAX);
+        batch->L[m] = 1.5;
+        batch->b[m] = 0.5;
+        batch->g[m] = 8.0;
+        batch->r0[m] = 0.25;
+        hex_ics(9.0, 9.0, batch->L[m], y);
+        for (i = 0; i < HEX_NUM_POINTS - 1; ++i) {
+            y[2*HEX_NUM_POINTS + 2*i] = v0;
+            y[2*HEX_NUM_POINTS + 2*i + 1] = -v0;
+        }
+        y[4*HEX_NUM_POINTS - 2] = 0.1*v0;
+        y[4*HEX_NUM_POINTS - 1] = -0.1*v0;
+        batch_set_state(batch, m, y);
+    }
+    memcpy(w0, batch->w, 4*HEX_NUM_POINTS*batch->num_members * sizeof(double));
+}
+
+static void report(const char *name, const batch_t *batch, double elapsed)
+{
+    int counts[5] = {0, 0, 0, 0, 0};
+    long steps = 0;
+    int m;
+
+    for (m = 0; m < batch->num_members; ++m) {
+        ++counts[batch->status[m]];
+        steps += batch->steps[m];
+    }
+    printf("%-6s %8.3f s %11.3e members/s %11.3e steps/s   "
+           "done %d, collision %d, maxsteps %d, failed %d\n",
+           name, elapsed, batch->num_members/elapsed, steps/elapsed,
+           counts[BATCH_DONE], counts[BATCH_COLLISION],
+           counts[BATCH_MAXSTEPS], counts[BATCH_FAILED]);
+}
+
+int main(int argc, char *argv[])
+{
+    int num_members = 10000;
+    double t1 = 20.0;
+    batch_t *batch;
+    double *w0, *wrk4;
+    size_t n, c;
+    double t, maxdiff;
+    int m;
+
+    if (argc > 1) {
+        num_members = atoi(argv[1]);
+    }
+    if (argc > 2) {
+        t1 = atof(argv[2]);
+    }
+
+    batch = batch_create(num_members, HEX_NUM_POINTS,
+                         HEX_NUM_CONNECTIONS, hex_connections);
+    n = 4*HEX_NUM_POINTS*(size_t) num_members;
+    w0 = malloc(n * sizeof(double));
+    wrk4 = malloc(n * sizeof(double));
+    if (batch == NULL || w0 == NULL || wrk4 == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return -1;
+    }
+    printf("%d members, t1 = %g\n", num_members, t1);
+
+    initial_state(batch, w0);
+    t = timer_now();
+    batch_rk4(batch, 0.0, t1, (int) ceil(t1/RK4_DT));
+    report("rk4", batch, timer_now() - t);
+    memcpy(wrk4, batch->w, n * sizeof(double));
+
+    memcpy(batch->w, w0, n * sizeof(double));
+    for (m = 0; m < num_members; ++m) {
+        batch->status[m] = BATCH_RUNNING;
+    }
+    t = timer_now();
+    batch_bs23(batch, 0.0, t1, 1e-6, 1e-9, 1000000);
+    report("bs23", batch, timer_now() - t);
+
+    maxdiff = 0.0;
+    for (c = 0; c < n; ++c) {
+        m = c % num_members;
+        if (batch->status[m] == BATCH_DONE) {
+            maxdiff = fmax(maxdiff, fabs(batch->w[c] - wrk4[c]));
+        }
+    }
+    printf("max |bs23 - rk4| over the members that finished: %.2e\n", maxdiff);
+
+    free(w0);
+    free(wrk4);
+    batch_free(batch);
+    return 0;
+}
@@ -0,0 +1,128 @@
+//
+// Accuracy and speed of the Barnes-Hut mutual gravity (bh_gravity())
+// against direct summation (direct_gravity()), for a uniform disk of
+// point masses and a range of opening angles.
+//
+// usage: bench_bh [n ...]
+//
+// For each n, the error is sqrt(sum |a_bh - a_direct|**2 / sum |a_direct|**2)
+// over (at most) 1000 sample points.  Direct summation of all n points is
+// only timed for n <= 20000.
+//
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bh.h"
+#include "timer.h"
+
+#define MAX_SAMPLES 1000
+#define MAX_DIRECT  20000
+
+static void run(int n)
+{
+    double thetas[] = {0.2, 0.4, 0.6, 0.8, 1.0};
+    double G = 1e-3, eps = 1e-3;
+    double *pos, *acc, *ref;
+    int nsamples = n < MAX_SAMPLES ? n : MAX_SAMPLES;
+    int stride = n / nsamples;
+    double t0, t1, tdirect = -1.0;
+    int i, k, s;
+
+    pos = malloc(2*n * sizeof(double));
+    acc = malloc(2*n * sizeof(double));
+    ref = calloc(2*nsamples, sizeof(double));
+
+    // Uniform in the unit disk.
+    for (i = 0; i < n; ++i) {
+        double r = sqrt(rand()/(double) RAND_MAX);
+        double phi = 2*M_PI*rand()/(double) RAND_MAX;
+        pos[2*i] = r*cos(phi);
+        pos[2*i+1] = r*sin(phi);
+    }
+
+    // Reference accelerations of the sample points.
+    for (s = 0; s < nsamples; ++s) {
+        i = s*stride;
+        for (k = 0; k < n; ++k) {
+            double dx, dy, d2;
+            if (k == i) {
+                continue;
+            }
+            dx = pos[2*k] - pos[2*i];
+            dy = pos[2*k+1] - pos[2*i+1];
+            d2 = dx*dx + dy*dy + eps*eps;
+            ref[2*s] += G*dx/(d2*sqrt(d2));
+            ref[2*s+1] += G*dy/(d2*sqrt(d2));
+        }
+    }
+
+    if (n <= MAX_DIRECT) {
+        memset(acc, 0, 2*n * sizeof(double));
+        t0 = timer_now();
+        direct_gravity(n, pos, G, eps, acc);
+        tdirect = timer_now() - t0;
+    }
+
+    for (k = 0; k < (int) (sizeof(thetas)/sizeof(thetas[0])); ++k) {
+        bh_tree_t *tree = bh_create(G, thetas[k], eps);
+        double err = 0.0, norm = 0.0;
+        int reps = 0;
+
+        // The first call sizes the arena.
+        memset(acc, 0, 2*n * sizeof(double));
+        bh_gravity(tree, n, pos, acc);
+        t0 = timer_now();
+        do {
+            memset(acc, 0, 2*n * sizeof(double));
+            bh_gravity(tree, n, pos, acc);
+            ++reps;
+            t1 = timer_now();
+        } while (t1 - t0 < 0.5);
+
+        for (s = 0; s < nsamples; ++s) {
+            double ex, ey;
+            i = s*stride;
+            ex = acc[2*i] - ref[2*s];
+            ey = acc[2*i+1] - ref[2*s+1];
+            err += ex*ex + ey*ey;
+            norm += ref[2*s]*ref[2*s] + ref[2*s+1]*ref[2*s+1];
+        }
+        err = sqrt(err/norm);
+
+        printf("%8d  %5.2f  %10.3e  %10.3e  %8d", n, thetas[k], err,
+               (t1 - t0)/reps, tree->num_nodes);
+        if (tdirect >= 0) {
+            printf("  %10.3e  %7.1f\n", tdirect, tdirect/((t1 - t0)/reps));
+        }
+        else {
+            printf("  %10s  %7s\n", "-", "-");
+        }
+        bh_free(tree);
+    }
+
+    free(pos);
+    free(acc);
+    free(ref);
+}
+
+int main(int argc, char *argv[])
+{
+    int i;
+
+    printf("%8s  %5s  %10s  %10s  %8s  %10s  %7s\n",
+           "n", "theta", "rel. error", "bh time", "nodes", "direct", "speedup");
+    if (argc > 1) {
+        for (i = 1; i < argc; ++i) {
+            run(atoi(argv[i]));
+        }
+    }
+    else {
+        run(1000);
+        run(10000);
+        run(100000);
+    }
+    return 0;
+}
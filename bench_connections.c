@@ -0,0 +1,235 @@
+//
+// Sections of bench (see bench.h) for changes of the connections: springs
+// broken and formed one at a time (bonds.h) against rebuilding what
+// depends on them; and the orders of the points of reorder.h.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <sundials/sundials_core.h>
+#include <nvector/nvector_serial.h>
+#include <sunlinsol/sunlinsol_klu.h>
+
+#include "de.h"
+#include "bench.h"
+#include "bonds.h"
+#include "de_jac.h"
+#include "de_parallel.h"
+#include "de_simd.h"
+#include "reorder.h"
+#include "timer.h"
+
+//
+// For each lattice: the time to break a spring and form it again with
+// bonds_break() and bonds_form(), which update the edge coloring, the
+// structure of arrays and the Jacobian pattern in place, against the time
+// to create all three from the connections.
+//
+void bench_bonds(FILE *out, int max_rings, SUNContext sunctx)
+{
+    const char *sep = "";
+    int rings;
+
+    fprintf(out, "  \"bonds\": [\n");
+    for (rings = 1; rings <= max_rings; rings *= 2) {
+        xparams_t params;
+        bonds_t *bonds;
+        N_Vector w;
+        int *connections;
+        double start, t_change, t_rebuild;
+        long n, count;
+
+        w = orbiting_hexagon(rings, &params, sunctx);
+        connections = params.connections;
+        params.schedule = de_schedule_create(&params);
+        params.edges = edge_soa_create(&params);
+        bonds = bonds_create(&params, 0.0, 0);
+        params.jac_pattern = de_jac_pattern_create(&params);
+        if (params.schedule == NULL || params.edges == NULL || bonds == NULL ||
+                params.jac_pattern == NULL) {
+            exit(-1);
+        }
+
+        count = 0;
+        start = timer_now();
+        for (n = 1; ; n *= 2) {
+            long k;
+
+            for (k = 0; k < n; ++k, ++count) {
+                int idx = (int) (count*7919 % params.num_connections);
+                int i = params.connections[2*idx];
+                int j = params.connections[2*idx + 1];
+
+                bonds_break(bonds, idx);
+                if (bonds_form(bonds, i, j) < 0) {
+                    exit(-1);
+                }
+            }
+            if (timer_now() - start >= MIN_TIME) {
+                break;
+            }
+        }
+        t_change = (timer_now() - start)/count;
+        if (params.jac_pattern->stale) {
+            fprintf(stderr, "bench_bonds: the Jacobian pattern went stale\n");
+        }
+
+        count = 0;
+        start = timer_now();
+        for (n = 1; ; n *= 2) {
+            long k;
+
+            for (k = 0; k < n; ++k, ++count) {
+                de_schedule_free(params.schedule);
+                edge_soa_free(params.edges);
+                de_jac_pattern_free(params.jac_pattern);
+                params.schedule = de_schedule_create(&params);
+                params.edges = edge_soa_create(&params);
+                params.jac_pattern = de_jac_pattern_create(&params);
+                if (params.schedule == NULL || params.edges == NULL ||
+                        params.jac_pattern == NULL) {
+                    exit(-1);
+                }
+            }
+            if (timer_now() - start >= MIN_TIME) {
+                break;
+            }
+        }
+        t_rebuild = (timer_now() - start)/count;
+
+        fprintf(stderr, "bonds         %7d points  %9.1f ns/change  %11.1f ns/rebuild\n",
+                params.num_points, 1e9*t_change, 1e9*t_rebuild);
+        fprintf(out, "%s    {\"rings\": %d, \"points\": %d, \"connections\": %d, "
+                "\"ns_per_change\": %.4f, \"ns_per_rebuild\": %.4f, "
+                "\"peak_rss_kb\": %ld}",
+                sep, rings, params.num_points, params.num_connections,
+                1e9*t_change, 1e9*t_rebuild, peak_rss_kb());
+        sep = ",\n";
+
+        de_schedule_free(params.schedule);
+        edge_soa_free(params.edges);
+        de_jac_pattern_free(params.jac_pattern);
+        bonds_free(bonds);
+        free(connections);
+        N_VDestroy(w);
+    }
+    fprintf(out, "\n  ],\n");
+}
+
+//
+// Renumber the points of params and w in the order of the given method.
+//
+static void renumber(int method, xparams_t *params, N_Vector w)
+{
+    reorder_t *reorder = reorder_create(method, params, N_VGetArrayPointer(w));
+
+    if (reorder == NULL || reorder_apply(reorder, params, N_VGetArrayPointer(w)) != 0) {
+        exit(-1);
+    }
+    reorder_free(reorder);
+}
+
+//
+// For each lattice, numbered as lattice_build() does, at random, and in
+// each order of reorder.h from the random numbering: the bandwidth of the
+// connections, the time of de(), and the fill-in of KLU, the number of
+// nonzeros of the factors L and U of I - gamma*J, with its own fill
+// reducing ordering (AMD) and with the natural ordering, which keeps the
+// numbering of the points, and the time to refactor with AMD.
+//
+void bench_reorder(FILE *out, int max_rings, SUNContext sunctx)
+{
+    static const char *names[] = {"lattice", "random", "rcm", "morton", "hilbert"};
+    static const int methods[] = {REORDER_NONE, REORDER_RANDOM, REORDER_RCM,
+                                  REORDER_MORTON, REORDER_HILBERT};
+    static const int orderings[] = {0, 2};  // AMD, natural
+    const char *sep = "";
+    int rings, m;
+
+    fprintf(out, "  \"reorder\": [\n");
+    for (rings = 1; rings <= max_rings; rings *= 2) {
+        for (m = 0; m < 5; ++m) {
+            xparams_t params;
+            de_jac_pattern_t *pattern;
+            N_Vector w, fw;
+            SUNMatrix J;
+            long fill[2];
+            double t_rhs, t_refactor = 0.0;
+            int o;
+
+            w = orbiting_hexagon(rings, &params, sunctx);
+            fw = N_VClone(w);
+            if (fw == NULL) {
+                exit(-1);
+            }
+            // (The orders are found from the random numbering, so that
+            // nothing is left of the numbering of lattice_build().)
+            if (methods[m] != REORDER_NONE) {
+                renumber(REORDER_RANDOM, &params, w);
+            }
+            if (methods[m] != REORDER_NONE && methods[m] != REORDER_RANDOM) {
+                renumber(methods[m], &params, w);
+            }
+            t_rhs = time_rhs(de, w, fw, &params);
+
+            pattern = de_jac_pattern_create(&params);
+            if (pattern == NULL || (J = de_jac_matrix(pattern, sunctx)) == NULL) {
+                exit(-1);
+            }
+            params.jac_pattern = pattern;
+            de_jac(0.0, w, fw, J, &params, NULL, NULL, NULL);
+            // The Newton matrix of a step of size 0.05.
+            SUNMatScaleAddI(-0.05, J);
+            for (o = 0; o < 2; ++o) {
+                SUNLinearSolver LS = SUNLinSol_KLU(w, J, sunctx);
+
+                if (LS == NULL || SUNLinSol_KLUSetOrdering(LS, orderings[o]) != 0 ||
+                        SUNLinSolInitialize(LS) != 0 || SUNLinSolSetup(LS, J) != 0) {
+                    fprintf(stderr, "bench_reorder: KLU failed\n");
+                    exit(-1);
+                }
+                fill[o] = (long) SUNLinSol_KLUGetNumeric(LS)->lnz +
+                          (long) SUNLinSol_KLUGetNumeric(LS)->unz;
+                if (orderings[o] == 0) {
+                    long n, count = 0;
+                    double start = timer_now();
+
+                    // Setups after the first refactor with the same pattern.
+                    for (n = 1; ; n *= 2) {
+                        long k;
+
+                        for (k = 0; k < n; ++k, ++count) {
+                            SUNLinSolSetup(LS, J);
+                        }
+                        if (timer_now() - start >= MIN_TIME) {
+                            break;
+                        }
+                    }
+                    t_refactor = (timer_now() - start)/count;
+                }
+                SUNLinSolFree(LS);
+            }
+
+            fprintf(stderr, "reorder %-7s %7d points  bandwidth %6d  %9.3f us/de  "
+                    "fill %8ld AMD %8ld natural  %9.3f us/refactor\n",
+                    names[m], params.num_points, reorder_bandwidth(&params),
+                    1e6*t_rhs, fill[0], fill[1], 1e6*t_refactor);
+            fprintf(out, "%s    {\"rings\": %d, \"points\": %d, \"order\": \"%s\", "
+                    "\"bandwidth\": %d, \"us_per_rhs\": %.4f, "
+                    "\"fill_amd\": %ld, \"fill_natural\": %ld, "
+                    "\"us_per_refactor\": %.4f, \"peak_rss_kb\": %ld}",
+                    sep, rings, params.num_points, names[m],
+                    reorder_bandwidth(&params), 1e6*t_rhs, fill[0], fill[1],
+                    1e6*t_refactor, peak_rss_kb());
+            sep = ",\n";
+
+            SUNMatDestroy(J);
+            de_jac_pattern_free(pattern);
+            free(params.connections);
+            N_VDestroy(fw);
+            N_VDestroy(w);
+        }
+    }
+    fprintf(out, "\n  ],\n");
+}
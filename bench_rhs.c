@@ -0,0 +1,309 @@
+//
+// Sections of bench (see bench.h) for the right-hand sides: de(), de3(),
+// de_rigid_hex() and the specializations of de_fixed.h against de(); de()
+// with each force law; de_rigid() for swarms of rigid hexagons; and the
+// root functions collision() and contact_roots().
+//
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <sundials/sundials_core.h>
+#include <nvector/nvector_serial.h>
+
+#include "de.h"
+#include "bench.h"
+#include "contact.h"
+#include "de_fixed.h"
+#include "force_law.h"
+#include "rigid.h"
+
+//
+// The right-hand sides of de.h and their root functions, for each lattice
+// and for the fixed size systems.
+//
+void bench_rhs(FILE *out, int max_rings, SUNContext sunctx)
+{
+    const char *sep = "";
+    N_Vector w, fw;
+    CVRhsFn fixed;
+    double t, t_de;
+    int rings;
+
+    fprintf(out, "  \"rhs\": [\n");
+    for (rings = 1; rings <= max_rings; rings *= 2) {
+        xparams_t params;
+        sunrealtype *gout;
+
+        w = orbiting_hexagon(rings, &params, sunctx);
+        fw = N_VClone(w);
+        gout = malloc(params.num_points * sizeof(sunrealtype));
+
+        t = time_rhs(de, w, fw, &params);
+        fprintf(stderr, "de            %7d points  %10.3e evals/s\n",
+                params.num_points, 1/t);
+        fprintf(out, "%s    {\"function\": \"de\", \"rings\": %d, \"points\": %d, "
+                "\"connections\": %d, \"evals_per_s\": %.6e, \"ns_per_edge\": %.4f, "
+                "\"peak_rss_kb\": %ld}",
+                sep, rings, params.num_points, params.num_connections,
+                1/t, 1e9*t/params.num_connections, peak_rss_kb());
+        sep = ",\n";
+
+        // The 7 point lattice (rings = 1) has a specialized de().
+        fixed = de_fixed_rhs(&params);
+        if (fixed != NULL) {
+            t_de = t;
+            t = time_rhs(fixed, w, fw, &params);
+            fprintf(stderr, "de_fixed      %7d points  %10.3e evals/s  %.2fx de\n",
+                    params.num_points, 1/t, t_de/t);
+            fprintf(out, "%s    {\"function\": \"de_fixed\", \"rings\": %d, \"points\": %d, "
+                    "\"connections\": %d, \"evals_per_s\": %.6e, \"ns_per_edge\": %.4f, "
+                    "\"speedup\": %.4f, \"peak_rss_kb\": %ld}",
+                    sep, rings, params.num_points, params.num_connections,
+                    1/t, 1e9*t/params.num_connections, t_de/t, peak_rss_kb());
+        }
+
+        t = time_root(collision, w, gout, &params);
+        fprintf(stderr, "collision     %7d points  %10.3e evals/s\n",
+                params.num_points, 1/t);
+        fprintf(out, "%s    {\"function\": \"collision\", \"rings\": %d, \"points\": %d, "
+                "\"evals_per_s\": %.6e, \"ns_per_point\": %.4f, \"peak_rss_kb\": %ld}",
+                sep, rings, params.num_points, 1/t, 1e9*t/params.num_points,
+                peak_rss_kb());
+
+        t = time_root(contact_roots, w, gout, &params);
+        fprintf(stderr, "contact_roots %7d points  %10.3e evals/s\n",
+                params.num_points, 1/t);
+        fprintf(out, "%s    {\"function\": \"contact_roots\", \"rings\": %d, \"points\": %d, "
+                "\"contacts\": 0, \"evals_per_s\": %.6e, \"ns_per_point\": %.4f, "
+                "\"peak_rss_kb\": %ld}",
+                sep, rings, params.num_points, 1/t, 1e9*t/params.num_points,
+                peak_rss_kb());
+
+        params.contact = contact_create(params.num_points, CONTACT_DISTANCE);
+        if (params.contact == NULL) {
+            exit(-1);
+        }
+        t = time_root(contact_roots, w, gout, &params);
+        fprintf(stderr, "contact_roots %7d points  %10.3e evals/s  (with contacts)\n",
+                params.num_points, 1/t);
+        fprintf(out, "%s    {\"function\": \"contact_roots\", \"rings\": %d, \"points\": %d, "
+                "\"contacts\": 1, \"evals_per_s\": %.6e, \"ns_per_point\": %.4f, "
+                "\"peak_rss_kb\": %ld}",
+                sep, rings, params.num_points, 1/t, 1e9*t/params.num_points,
+                peak_rss_kb());
+        contact_free(params.contact);
+
+        free(gout);
+        free(params.connections);
+        N_VDestroy(fw);
+        N_VDestroy(w);
+    }
+
+    // The fixed size systems.
+    {
+        params_t p3 = {2.5, 1.5, 0.5, 8.0};
+        rigid_hex_params_t phex = {1.5, 8.0, 0.25};
+        int tri_connections[6] = {0, 1, 0, 2, 1, 2};
+        xparams_t x3;
+        double *y;
+        int i;
+
+        w = N_VNew_Serial(12, sunctx);
+        fw = N_VClone(w);
+        y = N_VGetArrayPointer(w);
+        for (i = 0; i < 12; ++i) {
+            y[i] = 0.0;
+        }
+        y[0] = 9.0;
+        y[2] = 10.5;
+        y[4] = 9.75;
+        y[5] = 1.3;
+        t = time_rhs(de3, w, fw, &p3);
+        fprintf(stderr, "de3           %7d points  %10.3e evals/s\n", 3, 1/t);
+        fprintf(out, "%s    {\"function\": \"de3\", \"points\": 3, \"connections\": 3, "
+                "\"evals_per_s\": %.6e, \"ns_per_edge\": %.4f, \"peak_rss_kb\": %ld}",
+                sep, 1/t, 1e9*t/3, peak_rss_kb());
+
+        // The same three points with de() and its specialization de_tri().
+        xparams_init(&x3);
+        x3.k = p3.k;
+        x3.L = p3.L;
+        x3.b = p3.b;
+        x3.g = p3.g;
+        x3.num_points = 3;
+        x3.num_connections = 3;
+        x3.connections = tri_connections;
+        t_de = time_rhs(de, w, fw, &x3);
+        t = time_rhs(de_tri, w, fw, &x3);
+        fprintf(stderr, "de_tri        %7d points  %10.3e evals/s  %.2fx de\n",
+                3, 1/t, t_de/t);
+        fprintf(out, "%s    {\"function\": \"de_tri\", \"points\": 3, \"connections\": 3, "
+                "\"evals_per_s\": %.6e, \"ns_per_edge\": %.4f, \"speedup\": %.4f, "
+                "\"peak_rss_kb\": %ld}",
+                sep, 1/t, 1e9*t/3, t_de/t, peak_rss_kb());
+        N_VDestroy(fw);
+        N_VDestroy(w);
+
+        w = N_VNew_Serial(6, sunctx);
+        fw = N_VClone(w);
+        y = N_VGetArrayPointer(w);
+        y[0] = 9.0;
+        y[1] = 0.0;
+        y[2] = 0.1;
+        y[3] = 0.0;
+        y[4] = 0.9;
+        y[5] = 0.05;
+        t = time_rhs(de_rigid_hex, w, fw, &phex);
+        fprintf(stderr, "de_rigid_hex  %7d points  %10.3e evals/s\n", 7, 1/t);
+        fprintf(out, "%s    {\"function\": \"de_rigid_hex\", \"points\": 7, "
+                "\"evals_per_s\": %.6e, \"peak_rss_kb\": %ld}",
+                sep, 1/t, peak_rss_kb());
+        N_VDestroy(fw);
+        N_VDestroy(w);
+    }
+    fprintf(out, "\n  ],\n");
+}
+
+//
+// de() with each force law, and for the 7 point lattice the
+// specialization of de_fixed.h for the law.
+//
+void bench_force_laws(FILE *out, int max_rings, SUNContext sunctx)
+{
+    const char *sep = "";
+    int rings, law;
+
+    fprintf(out, "  \"force_laws\": [\n");
+    for (rings = 1; rings <= max_rings; rings *= 2) {
+        xparams_t params;
+        N_Vector w, fw;
+
+        w = orbiting_hexagon(rings, &params, sunctx);
+        fw = N_VClone(w);
+        for (law = 0; law < NUM_FORCE_LAWS; ++law) {
+            CVRhsFn fixed;
+            double t;
+
+            params.force_law = law;
+            t = time_rhs(de, w, fw, &params);
+            fprintf(stderr, "de %-9s  %7d points  %10.3e evals/s\n",
+                    force_laws[law].name, params.num_points, 1/t);
+            fprintf(out, "%s    {\"function\": \"de\", \"force_law\": \"%s\", "
+                    "\"rings\": %d, \"points\": %d, \"evals_per_s\": %.6e, "
+                    "\"ns_per_edge\": %.4f}",
+                    sep, force_laws[law].name, rings, params.num_points, 1/t,
+                    1e9*t/params.num_connections);
+            sep = ",\n";
+
+            fixed = de_fixed_rhs(&params);
+            if (fixed != NULL) {
+                t = time_rhs(fixed, w, fw, &params);
+                fprintf(stderr, "de_fixed %-9s  %7d points  %10.3e evals/s\n",
+                        force_laws[law].name, params.num_points, 1/t);
+                fprintf(out, "%s    {\"function\": \"de_fixed\", \"force_law\": \"%s\", "
+                        "\"rings\": %d, \"points\": %d, \"evals_per_s\": %.6e, "
+                        "\"ns_per_edge\": %.4f}",
+                        sep, force_laws[law].name, rings, params.num_points, 1/t,
+                        1e9*t/params.num_connections);
+            }
+        }
+        free(params.connections);
+        N_VDestroy(fw);
+        N_VDestroy(w);
+    }
+    fprintf(out, "\n  ],\n");
+}
+
+//
+// de_rigid() for swarms of 1, 16, 256 and 4096 rigid hexagons (7 points
+// each) spread along a circular orbit; de_rigid_hex() is the single
+// hexagon.  max_diff is the largest difference of its right-hand side
+// from that of de_rigid() for one body, which should be rounding.
+//
+void bench_rigid(FILE *out, SUNContext sunctx)
+{
+    const double L = 1.5, g = 8.0, r0 = 0.25;
+    rigid_hex_params_t phex = {L, g, r0};
+    const char *sep = "";
+    N_Vector w, fw;
+    double t;
+    int K;
+
+    fprintf(out, "  \"rigid\": [\n");
+    for (K = 1; K <= 4096; K *= 16) {
+        rigid_bodies_t *rb;
+        int *num_points;
+        double *points, *y;
+        int b;
+
+        num_points = malloc(K * sizeof(int));
+        points = malloc(2*HEX_NUM_POINTS*K * sizeof(double));
+        if (num_points == NULL || points == NULL) {
+            fprintf(stderr, "out of memory\n");
+            exit(-1);
+        }
+        for (b = 0; b < K; ++b) {
+            num_points[b] = HEX_NUM_POINTS;
+            hex_ics(0.0, 0.0, L, points + 2*HEX_NUM_POINTS*b);
+        }
+        rb = rigid_bodies_create(K, num_points, points, NULL, g, r0);
+        if (rb == NULL) {
+            exit(-1);
+        }
+        w = N_VNew_Serial(6*K, sunctx);
+        fw = N_VClone(w);
+        y = N_VGetArrayPointer(w);
+        for (b = 0; b < K; ++b) {
+            double phi = 2*M_PI*b/K, d = 9.0 + 0.01*b;
+            y[3*b] = d*cos(phi);
+            y[3*b+1] = d*sin(phi);
+            y[3*b+2] = 0.1*b;
+            y[3*K + 3*b] = -sqrt(g/d)*sin(phi);
+            y[3*K + 3*b + 1] = sqrt(g/d)*cos(phi);
+            y[3*K + 3*b + 2] = 0.05;
+        }
+        t = time_rhs(de_rigid, w, fw, rb);
+        fprintf(stderr, "de_rigid      %7d bodies  %10.3e evals/s  %.2f ns/point\n",
+                K, 1/t, 1e9*t/rb->num_points);
+        fprintf(out, "%s    {\"function\": \"de_rigid\", \"bodies\": %d, \"points\": %d, "
+                "\"evals_per_s\": %.6e, \"ns_per_body\": %.4f, \"ns_per_point\": %.4f, "
+                "\"peak_rss_kb\": %ld}",
+                sep, K, rb->num_points, 1/t, 1e9*t/K, 1e9*t/rb->num_points,
+                peak_rss_kb());
+        sep = ",\n";
+
+        if (K == 1) {
+            N_Vector w1 = N_VNew_Serial(6, sunctx);
+            N_Vector f1 = N_VClone(w1);
+            double max_diff = 0.0;
+            int i;
+
+            for (i = 0; i < 6; ++i) {
+                NV_Ith_S(w1, i) = y[i];
+            }
+            t = time_rhs(de_rigid_hex, w1, f1, &phex);
+            de_rigid(0.0, w, fw, rb);
+            for (i = 0; i < 6; ++i) {
+                max_diff = fmax(max_diff, fabs(NV_Ith_S(f1, i) - NV_Ith_S(fw, i)));
+            }
+            fprintf(stderr, "de_rigid_hex  %7d bodies  %10.3e evals/s  %.2f ns/point  diff %.2e\n",
+                    1, 1/t, 1e9*t/HEX_NUM_POINTS, max_diff);
+            fprintf(out, "%s    {\"function\": \"de_rigid_hex\", \"bodies\": 1, \"points\": %d, "
+                    "\"evals_per_s\": %.6e, \"ns_per_body\": %.4f, \"ns_per_point\": %.4f, "
+                    "\"max_diff\": %.3e, \"peak_rss_kb\": %ld}",
+                    sep, HEX_NUM_POINTS, 1/t, 1e9*t, 1e9*t/HEX_NUM_POINTS,
+                    max_diff, peak_rss_kb());
+            N_VDestroy(f1);
+            N_VDestroy(w1);
+        }
+
+        rigid_bodies_free(rb);
+        free(points);
+        free(num_points);
+        N_VDestroy(fw);
+        N_VDestroy(w);
+    }
+    fprintf(out, "\n  ],\n");
+}
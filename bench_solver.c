@@ -0,0 +1,402 @@
+//
+// Sections of bench (see bench.h) for complete integrations: each method
+// and linear solver over a range of lattices; the root functions; output
+// at increasing frame rates; increasingly stiff springs; and multirate
+// integration (multirate.h) against CVODE.
+//
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <sundials/sundials_core.h>
+#include <nvector/nvector_serial.h>
+#include <cvode/cvode.h>
+#include <arkode/arkode.h>
+
+#include "de.h"
+#include "bench.h"
+#include "bh.h"
+#include "contact.h"
+#include "multirate.h"
+#include "solver.h"
+#include "timer.h"
+
+// The dense linear solver is skipped above this many points.
+#define MAX_DENSE_POINTS 250
+
+// Slow step size of the multirate integrations.
+#define SLOW_STEP 0.1
+
+//
+// Integrate each lattice to t_end with each method and linear solver,
+// with the root function collision().
+//
+void bench_integrations(FILE *out, int max_rings, double t_end,
+                        SUNContext sunctx)
+{
+    const char *methods[] = {"adams", "bdf", "imex"};
+    const char *linsols[] = {"dense", "klu", "spgmr", "spfgmr"};
+    const char *sep = "";
+    int rings, method, linsol;
+
+    fprintf(out, "  \"integrations\": [\n");
+    for (rings = 1; rings <= max_rings; rings *= 2) {
+        for (method = SOLVER_ADAMS; method <= SOLVER_IMEX; ++method) {
+            for (linsol = LINSOL_DENSE; linsol <= LINSOL_SPFGMR; ++linsol) {
+                xparams_t params;
+                solver_t *solver;
+                N_Vector w;
+                sunrealtype t = 0.0;
+                long nsteps = 0, nfevals = 0;
+                double start, elapsed;
+                int flag;
+
+                w = orbiting_hexagon(rings, &params, sunctx);
+                if (linsol == LINSOL_DENSE && params.num_points > MAX_DENSE_POINTS) {
+                    free(params.connections);
+                    N_VDestroy(w);
+                    continue;
+                }
+
+                start = timer_now();
+                solver = solver_create(method, linsol, &params, 0.0, w, sunctx);
+                if (solver == NULL) {
+                    fprintf(stderr, "solver_create failed\n");
+                    exit(-1);
+                }
+                solver_tolerances(solver, 1e-6, 1e-8);
+                solver_set_max_num_steps(solver, 100000);
+                solver_set_stop_time(solver, t_end);
+                solver_root_init(solver, params.num_points, collision);
+                flag = solver_evolve(solver, t_end, w, &t);
+                elapsed = timer_now() - start;
+                solver_get_num_steps(solver, &nsteps);
+                solver_get_num_rhs_evals(solver, &nfevals);
+
+                fprintf(stderr, "%-5s %-6s %7d points  flag %3d  t %8.3f  %7ld steps  %8.3f s\n",
+                        methods[method], linsols[linsol], params.num_points,
+                        flag, t, nsteps, elapsed);
+                fprintf(out, "%s    {\"method\": \"%s\", \"linsol\": \"%s\", \"rings\": %d, "
+                        "\"points\": %d, \"t_end\": %g, \"t\": %.6g, \"flag\": %d, "
+                        "\"steps\": %ld, \"rhs_evals\": %ld, \"wall_s\": %.6f, "
+                        "\"steps_per_s\": %.6e, \"rhs_evals_per_s\": %.6e, "
+                        "\"peak_rss_kb\": %ld}",
+                        sep, methods[method], linsols[linsol], rings,
+                        params.num_points, t_end, t, flag, nsteps, nfevals,
+                        elapsed, nsteps/elapsed, nfevals/elapsed, peak_rss_kb());
+                sep = ",\n";
+
+                solver_free(&solver);
+                free(params.connections);
+                N_VDestroy(w);
+            }
+        }
+    }
+    fprintf(out, "\n  ],\n");
+}
+
+//
+// Integrate each lattice to t_end with Adams and KLU, with the root
+// functions of collision() (one per point) and of contact_roots()
+// without and with contacts (one and two), and compare the cost.
+//
+void bench_roots(FILE *out, int max_rings, double t_end,
+                 SUNContext sunctx)
+{
+    const char *roots[] = {"collision", "contact_roots", "contact_roots+contacts"};
+    const char *sep = "";
+    int rings, r;
+
+    fprintf(out, "  \"roots\": [\n");
+    for (rings = 1; rings <= max_rings; rings *= 2) {
+        for (r = 0; r < 3; ++r) {
+            xparams_t params;
+            solver_t *solver;
+            N_Vector w;
+            sunrealtype t = 0.0;
+            long nsteps = 0, ngevals = 0;
+            double start, elapsed;
+            int flag;
+
+            w = orbiting_hexagon(rings, &params, sunctx);
+            start = timer_now();
+            if (r == 2) {
+                params.contact = contact_create(params.num_points, CONTACT_DISTANCE);
+                if (params.contact == NULL) {
+                    exit(-1);
+                }
+            }
+            solver = solver_create(SOLVER_ADAMS, LINSOL_KLU, &params, 0.0, w, sunctx);
+            if (solver == NULL) {
+                fprintf(stderr, "solver_create failed\n");
+                exit(-1);
+            }
+            solver_tolerances(solver, 1e-6, 1e-8);
+            solver_set_max_num_steps(solver, 100000);
+            solver_set_stop_time(solver, t_end);
+            if (r == 0) {
+                solver_root_init(solver, params.num_points, collision);
+            }
+            else {
+                solver_root_init(solver, contact_num_roots(&params), contact_roots);
+            }
+            flag = solver_evolve(solver, t_end, w, &t);
+            elapsed = timer_now() - start;
+            solver_get_num_steps(solver, &nsteps);
+            solver_get_num_g_evals(solver, &ngevals);
+
+            fprintf(stderr, "%-22s %7d points  flag %3d  t %8.3f  %7ld steps  "
+                    "%8ld root evals  %8.3f s\n",
+                    roots[r], params.num_points, flag, t, nsteps, ngevals, elapsed);
+            fprintf(out, "%s    {\"roots\": \"%s\", \"rings\": %d, \"points\": %d, "
+                    "\"t_end\": %g, \"t\": %.6g, \"flag\": %d, \"steps\": %ld, "
+                    "\"root_evals\": %ld, \"wall_s\": %.6f, \"peak_rss_kb\": %ld}",
+                    sep, roots[r], rings, params.num_points, t_end, t, flag,
+                    nsteps, ngevals, elapsed, peak_rss_kb());
+            sep = ",\n";
+
+            solver_free(&solver);
+            contact_free(params.contact);
+            free(params.connections);
+            N_VDestroy(w);
+        }
+    }
+    fprintf(out, "\n  ],\n");
+}
+
+//
+// Integrate the one ring hexagon to t_end with output at frames_per_unit
+// frames per unit of time, with solver_evolve() for every frame and with
+// solver_dense(), and compare the steps and evaluations.
+//
+void bench_frames(FILE *out, double t_end, SUNContext sunctx)
+{
+    const double rates[] = {1, 10, 100, 1000};
+    const char *sep = "";
+    int r, dense;
+
+    fprintf(out, "  \"frames\": [\n");
+    for (r = 0; r < (int) (sizeof(rates)/sizeof(rates[0])); ++r) {
+        for (dense = 0; dense <= 1; ++dense) {
+            xparams_t params;
+            solver_t *solver;
+            N_Vector w;
+            sunrealtype t = 0.0;
+            double dt = 1.0/rates[r];
+            long frames = 0, nsteps = 0, nfevals = 0, ngevals = 0;
+            double start, elapsed;
+            int flag = CV_SUCCESS;
+
+            w = orbiting_hexagon(1, &params, sunctx);
+            start = timer_now();
+            solver = solver_create(SOLVER_ADAMS, LINSOL_DENSE, &params, 0.0, w, sunctx);
+            if (solver == NULL) {
+                fprintf(stderr, "solver_create failed\n");
+                exit(-1);
+            }
+            solver_tolerances(solver, 1e-10, 1e-12);
+            solver_set_max_num_steps(solver, 500000);
+            solver_set_stop_time(solver, t_end);
+            solver_root_init(solver, params.num_points, collision);
+            while (t < t_end && (flag == CV_SUCCESS || flag == CV_TSTOP_RETURN)) {
+                if (dense) {
+                    flag = solver_dense(solver, (frames + 1)*dt, w, &t);
+                }
+                else {
+                    flag = solver_evolve(solver, (frames + 1)*dt, w, &t);
+                }
+                ++frames;
+            }
+            elapsed = timer_now() - start;
+            solver_get_num_steps(solver, &nsteps);
+            solver_get_num_rhs_evals(solver, &nfevals);
+            solver_get_num_g_evals(solver, &ngevals);
+
+            fprintf(stderr, "%-6s %6g frames/unit  flag %3d  t %8.3f  %7ld steps  "
+                    "%8ld rhs evals  %8ld root evals  %8.3f s\n",
+                    dense ? "dense" : "normal", rates[r], flag, t, nsteps,
+                    nfevals, ngevals, elapsed);
+            fprintf(out, "%s    {\"output\": \"%s\", \"frames_per_unit\": %g, "
+                    "\"t_end\": %g, \"t\": %.6g, \"flag\": %d, \"frames\": %ld, "
+                    "\"steps\": %ld, \"rhs_evals\": %ld, \"root_evals\": %ld, "
+                    "\"wall_s\": %.6f}",
+                    sep, dense ? "dense" : "normal", rates[r], t_end, t, flag,
+                    frames, nsteps, nfevals, ngevals, elapsed);
+            sep = ",\n";
+
+            solver_free(&solver);
+            free(params.connections);
+            N_VDestroy(w);
+        }
+    }
+    fprintf(out, "\n  ],\n");
+}
+
+//
+// Integrate the four ring lattice to t_end with stiffer and more damped
+// springs (k and b multiplied by the factors below), with each method
+// and KLU.  For SOLVER_IMEX, rhs_evals counts the implicit part only.
+//
+void bench_stiffness(FILE *out, double t_end, SUNContext sunctx)
+{
+    const char *methods[] = {"adams", "bdf", "imex"};
+    const double factors[] = {1, 10, 100};
+    const char *sep = "";
+    int kf, bf, method;
+
+    fprintf(out, "  \"stiffness\": [\n");
+    for (kf = 0; kf < 3; ++kf) {
+        for (bf = 0; bf < 2; ++bf) {
+            for (method = SOLVER_ADAMS; method <= SOLVER_IMEX; ++method) {
+                xparams_t params;
+                solver_t *solver;
+                N_Vector w;
+                sunrealtype t = 0.0;
+                long nsteps = 0, nfevals = 0;
+                double start, elapsed;
+                int flag;
+
+                w = orbiting_hexagon(4, &params, sunctx);
+                params.k *= factors[kf];
+                params.b *= factors[bf];
+
+                start = timer_now();
+                solver = solver_create(method, LINSOL_KLU, &params, 0.0, w, sunctx);
+                if (solver == NULL) {
+                    fprintf(stderr, "solver_create failed\n");
+                    exit(-1);
+                }
+                solver_tolerances(solver, 1e-6, 1e-8);
+                solver_set_max_num_steps(solver, 1000000);
+                solver_set_stop_time(solver, t_end);
+                solver_root_init(solver, params.num_points, collision);
+                flag = solver_evolve(solver, t_end, w, &t);
+                elapsed = timer_now() - start;
+                solver_get_num_steps(solver, &nsteps);
+                solver_get_num_rhs_evals(solver, &nfevals);
+
+                fprintf(stderr, "%-5s k %6g b %6g  flag %3d  t %8.3f  %8ld steps  "
+                        "%9ld rhs evals  %8.3f s\n",
+                        methods[method], params.k, params.b, flag, t, nsteps,
+                        nfevals, elapsed);
+                fprintf(out, "%s    {\"method\": \"%s\", \"k\": %g, \"b\": %g, "
+                        "\"points\": %d, \"t_end\": %g, \"t\": %.6g, \"flag\": %d, "
+                        "\"steps\": %ld, \"rhs_evals\": %ld, \"wall_s\": %.6f}",
+                        sep, methods[method], params.k, params.b,
+                        params.num_points, t_end, t, flag, nsteps, nfevals,
+                        elapsed);
+                sep = ",\n";
+
+                solver_free(&solver);
+                free(params.connections);
+                N_VDestroy(w);
+            }
+        }
+    }
+    fprintf(out, "\n  ],\n");
+}
+
+//
+// Integrate the lattices to t_end with CVODE (Adams, KLU) and with the
+// multirate integrator, without and with the mutual gravity (Barnes-Hut),
+// and compare the evaluations of the slow (gravity) and fast (springs)
+// parts of de().  A call of de() evaluates both.  max_diff is the largest
+// difference of the final positions from those of CVODE.
+//
+void bench_multirate(FILE *out, int max_rings, double t_end,
+                     SUNContext sunctx)
+{
+    const char *sep = "";
+    int rings, mutual, multirate;
+
+    fprintf(out, "  \"multirate\": [\n");
+    for (rings = 1; rings <= max_rings; rings *= 2) {
+        for (mutual = 0; mutual <= 1; ++mutual) {
+            N_Vector ref = NULL;
+
+            for (multirate = 0; multirate <= 1; ++multirate) {
+                xparams_t params;
+                solver_t *solver = NULL;
+                multirate_t *mr = NULL;
+                N_Vector w;
+                sunrealtype t = 0.0;
+                long nsteps = 0, nslow = 0, nfast = 0, nunused = 0;
+                double start, elapsed, max_diff = 0.0;
+                int flag, i;
+
+                w = orbiting_hexagon(rings, &params, sunctx);
+                if (mutual) {
+                    params.bh = bh_create(1e-3, 0.5, 1e-3);
+                    if (params.bh == NULL) {
+                        exit(-1);
+                    }
+                }
+
+                start = timer_now();
+                if (multirate) {
+                    mr = multirate_create(&params, SLOW_STEP, 0.0, w, sunctx);
+                    if (mr == NULL) {
+                        fprintf(stderr, "multirate_create failed\n");
+                        exit(-1);
+                    }
+                    multirate_tolerances(mr, 1e-6, 1e-8);
+                    ARKodeSetStopTime(mr->arkode_mem, t_end);
+                    ARKodeRootInit(mr->arkode_mem, params.num_points, collision);
+                    flag = ARKodeEvolve(mr->arkode_mem, t_end, w, &t, ARK_NORMAL);
+                    elapsed = timer_now() - start;
+                    ARKodeGetNumSteps(mr->arkode_mem, &nsteps);
+                    MRIStepGetNumRhsEvals(mr->arkode_mem, &nslow, &nunused);
+                    ARKStepGetNumRhsEvals(mr->inner_mem, &nfast, &nunused);
+                }
+                else {
+                    solver = solver_create(SOLVER_ADAMS, LINSOL_KLU, &params, 0.0, w, sunctx);
+                    if (solver == NULL) {
+                        fprintf(stderr, "solver_create failed\n");
+                        exit(-1);
+                    }
+                    solver_tolerances(solver, 1e-6, 1e-8);
+                    solver_set_max_num_steps(solver, 100000);
+                    solver_set_stop_time(solver, t_end);
+                    solver_root_init(solver, params.num_points, collision);
+                    flag = solver_evolve(solver, t_end, w, &t);
+                    elapsed = timer_now() - start;
+                    solver_get_num_steps(solver, &nsteps);
+                    solver_get_num_rhs_evals(solver, &nslow);
+                    nfast = nslow;
+                }
+
+                if (ref == NULL) {
+                    ref = N_VClone(w);
+                    N_VScale(1.0, w, ref);
+                }
+                for (i = 0; i < 2*params.num_points; ++i) {
+                    max_diff = fmax(max_diff, fabs(NV_Ith_S(w, i) - NV_Ith_S(ref, i)));
+                }
+
+                fprintf(stderr, "%-9s %-6s %7d points  flag %3d  t %8.3f  %7ld steps  "
+                        "%8ld slow  %8ld fast evals  %8.3f s  diff %.2e\n",
+                        multirate ? "multirate" : "cvode", mutual ? "mutual" : "",
+                        params.num_points, flag, t, nsteps, nslow, nfast, elapsed,
+                        max_diff);
+                fprintf(out, "%s    {\"integrator\": \"%s\", \"mutual_gravity\": %d, "
+                        "\"rings\": %d, \"points\": %d, \"t_end\": %g, \"t\": %.6g, "
+                        "\"flag\": %d, \"steps\": %ld, \"slow_evals\": %ld, "
+                        "\"fast_evals\": %ld, \"wall_s\": %.6f, \"max_diff\": %.3e, "
+                        "\"peak_rss_kb\": %ld}",
+                        sep, multirate ? "multirate" : "cvode", mutual, rings,
+                        params.num_points, t_end, t, flag, nsteps, nslow, nfast,
+                        elapsed, max_diff, peak_rss_kb());
+                sep = ",\n";
+
+                solver_free(&solver);
+                multirate_free(&mr);
+                bh_free(params.bh);
+                free(params.connections);
+                N_VDestroy(w);
+            }
+            N_VDestroy(ref);
+        }
+    }
+    fprintf(out, "\n  ],\n");
+}
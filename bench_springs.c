@@ -0,0 +1,141 @@
+//
+// Microbenchmark of the spring/friction kernels: the connection loop of
+// de() against de_springs() with each kernel variant the CPU supports.
+// Reports throughput in springs per second and the largest relative
+// difference of the accelerations from those computed by de().
+//
+// usage: bench_springs [width [height [repetitions]]]
+//
+// The springs form a width x height triangular lattice.  Gravity is
+// turned off, so the timings of de() are dominated by the connections.
+//
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sundials/sundials_core.h>
+#include <nvector/nvector_serial.h>
+
+#include "de.h"
+#include "de_simd.h"
+#include "timer.h"
+
+//
+// Triangular lattice with spacing L, slightly perturbed, with random
+// velocities.  Returns the number of connections.
+//
+static int triangular_lattice(int width, int height, double L, double *w,
+                              int *connections)
+{
+    int num_points = width*height;
+    int m = 0;
+    int x, y;
+
+    for (y = 0; y < height; ++y) {
+        for (x = 0; x < width; ++x) {
+            int i = y*width + x;
+            w[2*i] = L*(x + 0.5*(y % 2)) + 0.05*L*(rand()/(double) RAND_MAX - 0.5);
+            w[2*i+1] = L*0.8660254037844386*y + 0.05*L*(rand()/(double) RAND_MAX - 0.5);
+            w[2*num_points + 2*i] = rand()/(double) RAND_MAX - 0.5;
+            w[2*num_points + 2*i + 1] = rand()/(double) RAND_MAX - 0.5;
+            if (x + 1 < width) {
+                connections[m++] = i;
+                connections[m++] = i + 1;
+            }
+            if (y + 1 < height) {
+                connections[m++] = i;
+                connections[m++] = i + width;
+                if (y % 2 == 0 && x > 0) {
+                    connections[m++] = i;
+                    connections[m++] = i + width - 1;
+                }
+                else if (y % 2 == 1 && x + 1 < width) {
+                    connections[m++] = i;
+                    connections[m++] = i + width + 1;
+                }
+            }
+        }
+    }
+    return m/2;
+}
+
+int main(int argc, char *argv[])
+{
+    int width = argc > 1 ? atoi(argv[1]) : 200;
+    int height = argc > 2 ? atoi(argv[2]) : width;
+    int reps = argc > 3 ? atoi(argv[3]) : 50;
+    int num_points = width*height;
+    int best, variant, rep, idx;
+    SUNContext sunctx;
+    N_Vector w, f, fref;
+    xparams_t params;
+    double t0, t1;
+
+    if (SUNContext_Create(SUN_COMM_NULL, &sunctx)) {
+        fprintf(stderr, "SUNContext_Create() failed.\n");
+        return 1;
+    }
+    w = N_VNew_Serial(4*num_points, sunctx);
+    f = N_VNew_Serial(4*num_points, sunctx);
+    fref = N_VNew_Serial(4*num_points, sunctx);
+
+    xparams_init(&params);
+    params.k = 2.5;
+    params.L = 1.5;
+    params.b = 0.5;
+    params.g = 0.0;
+    params.num_points = num_points;
+    params.connections = malloc(2*3*num_points * sizeof(int));
+    params.num_connections = triangular_lattice(width, height, params.L,
+                                                N_VGetArrayPointer(w),
+                                                params.connections);
+    params.edges = edge_soa_create(&params);
+
+    printf("%d points, %d springs, %d repetitions\n",
+           num_points, params.num_connections, reps);
+
+    de(0.0, w, fref, &params);
+    t0 = timer_now();
+    for (rep = 0; rep < reps; ++rep) {
+        de(0.0, w, fref, &params);
+    }
+    t1 = timer_now();
+    printf("%-8s %10.3e springs/s\n", "de()",
+           (double) reps*params.num_connections/(t1 - t0));
+
+    best = simd_best_variant();
+    for (variant = SIMD_SCALAR; variant <= best; ++variant) {
+        double *fd = N_VGetArrayPointer(f);
+        double maxrel = 0.0;
+
+        t0 = timer_now();
+        for (rep = 0; rep < reps; ++rep) {
+            memset(fd + 2*num_points, 0, 2*num_points * sizeof(double));
+            de_springs(variant, params.edges, num_points,
+                       N_VGetArrayPointer(w), fd);
+        }
+        t1 = timer_now();
+
+        for (idx = 2*num_points; idx < 4*num_points; idx += 2) {
+            double ex = NV_Ith_S(fref, idx) - fd[idx];
+            double ey = NV_Ith_S(fref, idx+1) - fd[idx+1];
+            double a = hypot(NV_Ith_S(fref, idx), NV_Ith_S(fref, idx+1));
+            if (a > 0 && hypot(ex, ey)/a > maxrel) {
+                maxrel = hypot(ex, ey)/a;
+            }
+        }
+        printf("%-8s %10.3e springs/s   max rel. diff. %.2e\n",
+               simd_variant_name(variant),
+               (double) reps*params.num_connections/(t1 - t0), maxrel);
+    }
+
+    edge_soa_free(params.edges);
+    free(params.connections);
+    N_VDestroy(w);
+    N_VDestroy(f);
+    N_VDestroy(fref);
+    SUNContext_Free(&sunctx);
+    return 0;
+}
@@ -0,0 +1,303 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "bh.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// Points closer together than about 2**-BH_MAX_DEPTH times the size of
+// the root cell share a leaf.
+//
+#define BH_MAX_DEPTH 48
+
+bh_tree_t *bh_create(double G, double theta, double eps)
+{
+    bh_tree_t *tree;
+
+    tree = calloc(1, sizeof(bh_tree_t));
+    if (tree == NULL) {
+        fprintf(stderr, "bh_create: out of memory\n");
+        return NULL;
+    }
+    tree->G = G;
+    tree->theta = theta;
+    tree->eps = eps;
+    return tree;
+}
+
+void bh_free(bh_tree_t *tree)
+{
+    if (tree == NULL) {
+        return;
+    }
+    free(tree->nodes);
+    free(tree->next);
+    free(tree);
+}
+
+//
+// Take four consecutive nodes from the arena for the children of node
+// parent.  Returns the index of the first, or -1 if out of memory.
+//
+static int new_children(bh_tree_t *tree, int parent)
+{
+    bh_node_t *p;
+    int first, q;
+
+    if (tree->num_nodes + 4 > tree->node_capacity) {
+        int capacity = 2*tree->node_capacity + 4;
+        bh_node_t *nodes = realloc(tree->nodes, capacity * sizeof(bh_node_t));
+        if (nodes == NULL) {
+            return -1;
+        }
+        tree->nodes = nodes;
+        tree->node_capacity = capacity;
+    }
+    first = tree->num_nodes;
+    tree->num_nodes += 4;
+
+    p = &tree->nodes[parent];
+    for (q = 0; q < 4; ++q) {
+        bh_node_t *c = &tree->nodes[first + q];
+        c->half = 0.5*p->half;
+        c->cx = p->cx + ((q & 1) ? c->half : -c->half);
+        c->cy = p->cy + ((q & 2) ? c->half : -c->half);
+        c->child = -1;
+        c->body = -1;
+    }
+    p->child = first;
+    return first;
+}
+
+static int quadrant(const bh_node_t *node, double x, double y)
+{
+    return (x >= node->cx) + 2*(y >= node->cy);
+}
+
+//
+// Build the tree for the n points with coordinates pos[2*i], pos[2*i+1].
+// Returns 0, or -1 if out of memory.
+//
+int bh_build(bh_tree_t *tree, int n, const double *pos)
+{
+    double xmin, xmax, ymin, ymax;
+    bh_node_t *root;
+    int i, k;
+
+    if (n > tree->body_capacity) {
+        int *next = realloc(tree->next, n * sizeof(int));
+        if (next == NULL) {
+            goto fail;
+        }
+        tree->next = next;
+        tree->body_capacity = n;
+    }
+    if (tree->node_capacity == 0) {
+        tree->nodes = malloc(4*n * sizeof(bh_node_t));
+        if (tree->nodes == NULL) {
+            goto fail;
+        }
+        tree->node_capacity = 4*n;
+    }
+
+    xmin = xmax = pos[0];
+    ymin = ymax = pos[1];
+    for (i = 1; i < n; ++i) {
+        xmin = fmin(xmin, pos[2*i]);
+        xmax = fmax(xmax, pos[2*i]);
+        ymin = fmin(ymin, pos[2*i+1]);
+        ymax = fmax(ymax, pos[2*i+1]);
+    }
+
+    tree->num_nodes = 1;
+    root = &tree->nodes[0];
+    root->cx = 0.5*(xmin + xmax);
+    root->cy = 0.5*(ymin + ymax);
+    // Slightly larger than needed, so every point is strictly inside.
+    root->half = 0.5*fmax(xmax - xmin, ymax - ymin)*(1 + 1e-12) + 1e-300;
+    root->child = -1;
+    root->body = -1;
+
+    for (i = 0; i < n; ++i) {
+        double x = pos[2*i], y = pos[2*i+1];
+        int node = 0, depth = 0;
+
+        // Descend to a leaf.
+        while (tree->nodes[node].child >= 0) {
+            node = tree->nodes[node].child + quadrant(&tree->nodes[node], x, y);
+            ++depth;
+        }
+        // Split occupied leaves until point i is alone, or the maximum
+        // depth is reached.
+        while (tree->nodes[node].body >= 0 && depth < BH_MAX_DEPTH) {
+            int other = tree->nodes[node].body;
+            int first = new_children(tree, node);
+            if (first < 0) {
+                goto fail;
+            }
+            tree->nodes[node].body = -1;
+            k = first + quadrant(&tree->nodes[node], pos[2*other], pos[2*other+1]);
+            tree->nodes[k].body = other;
+            node = first + quadrant(&tree->nodes[node], x, y);
+            ++depth;
+        }
+        tree->next[i] = tree->nodes[node].body;
+        tree->nodes[node].body = i;
+    }
+
+    // Masses and centers of mass.  Children always come after their
+    // parent in the arena, so a reverse sweep visits children first.
+    for (k = tree->num_nodes - 1; k >= 0; --k) {
+        bh_node_t *node = &tree->nodes[k];
+        double mass = 0.0, mx = 0.0, my = 0.0;
+
+        if (node->child >= 0) {
+            int q;
+            for (q = 0; q < 4; ++q) {
+                const bh_node_t *c = &tree->nodes[node->child + q];
+                mass += c->mass;
+                mx += c->mass*c->mx;
+                my += c->mass*c->my;
+            }
+        }
+        else {
+            for (i = node->body; i >= 0; i = tree->next[i]) {
+                mass += 1.0;
+                mx += pos[2*i];
+                my += pos[2*i+1];
+            }
+        }
+        node->mass = mass;
+        if (mass > 0) {
+            node->mx = mx/mass;
+            node->my = my/mass;
+        }
+        else {
+            node->mx = node->cx;
+            node->my = node->cy;
+        }
+        // Barnes' "bmax" criterion: open the cell unless the distance to
+        // its center of mass exceeds s/theta + delta, where s is the width
+        // of the cell and delta is the distance from its center to its
+        // center of mass.  (This is safe when the mass is concentrated at
+        // a corner of the cell.)
+        node->open2 = 2*node->half/tree->theta +
+                      hypot(node->mx - node->cx, node->my - node->cy);
+        node->open2 *= node->open2;
+    }
+    return 0;
+
+fail:
+    fprintf(stderr, "bh_build: out of memory\n");
+    return -1;
+}
+
+//
+// Add the accelerations due to the mutual gravity of the points, from a
+// tree built by bh_build() for the same points, to acc[2*i], acc[2*i+1].
+//
+void bh_accel(const bh_tree_t *tree, int n, const double *pos, double *acc)
+{
+    double G = tree->G;
+    double eps2 = tree->eps*tree->eps;
+    int i;
+
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (i = 0; i < n; ++i) {
+        int stack[3*BH_MAX_DEPTH + 4];
+        int top = 0;
+        double x = pos[2*i], y = pos[2*i+1];
+        double ax = 0.0, ay = 0.0;
+
+        stack[top++] = 0;
+        while (top > 0) {
+            const bh_node_t *node = &tree->nodes[stack[--top]];
+            double dx, dy, d2, s;
+
+            if (node->mass == 0) {
+                continue;
+            }
+            if (node->child < 0) {
+                int b;
+                for (b = node->body; b >= 0; b = tree->next[b]) {
+                    if (b != i) {
+                        dx = pos[2*b] - x;
+                        dy = pos[2*b+1] - y;
+                        d2 = dx*dx + dy*dy + eps2;
+                        s = G/(d2*sqrt(d2));
+                        ax += s*dx;
+                        ay += s*dy;
+                    }
+                }
+                continue;
+            }
+            dx = node->mx - x;
+            dy = node->my - y;
+            d2 = dx*dx + dy*dy;
+            if (d2 > node->open2) {
+                // Far enough away: the whole cell acts as one mass.
+                d2 += eps2;
+                s = G*node->mass/(d2*sqrt(d2));
+                ax += s*dx;
+                ay += s*dy;
+            }
+            else {
+                int q;
+                for (q = 0; q < 4; ++q) {
+                    stack[top++] = node->child + q;
+                }
+            }
+        }
+        acc[2*i] += ax;
+        acc[2*i+1] += ay;
+    }
+}
+
+//
+// bh_build() followed by bh_accel().  Returns 0, or -1 if out of memory.
+//
+int bh_gravity(bh_tree_t *tree, int n, const double *pos, double *acc)
+{
+    if (n < 2) {
+        return 0;
+    }
+    if (bh_build(tree, n, pos) != 0) {
+        return -1;
+    }
+    bh_accel(tree, n, pos, acc);
+    return 0;
+}
+
+//
+// Reference O(n**2) summation of the same accelerations, added to acc.
+//
+void direct_gravity(int n, const double *pos, double G, double eps, double *acc)
+{
+    double eps2 = eps*eps;
+    int i, j;
+
+    for (i = 0; i < n; ++i) {
+        double ax = 0.0, ay = 0.0;
+        for (j = 0; j < n; ++j) {
+            double dx, dy, d2, s;
+            if (j == i) {
+                continue;
+            }
+            dx = pos[2*j] - pos[2*i];
+            dy = pos[2*j+1] - pos[2*i+1];
+            d2 = dx*dx + dy*dy + eps2;
+            s = G/(d2*sqrt(d2));
+            ax += s*dx;
+            ay += s*dy;
+        }
+        acc[2*i] += ax;
+        acc[2*i+1] += ay;
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,52 @@
+#ifndef _BH_H_
+#define _BH_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// Barnes-Hut quadtree for the mutual gravity of the point masses (all
+// with mass 1).  The tree is rebuilt on every call of bh_gravity(); the
+// nodes are taken from an arena that is kept between calls and only
+// grows, so after the first few calls no memory is allocated.
+//
+typedef struct _bh_node {
+    /* Center and half width of the square cell. */
+    double cx, cy, half;
+    /* Total mass and center of mass of the points in the cell. */
+    double mass, mx, my;
+    /* The cell is used as a single mass at squared distances beyond open2. */
+    double open2;
+    /* Index of the first child (the four children are consecutive), or -1 for a leaf. */
+    int child;
+    /* For a leaf: the first point in the cell (-1 if empty); the rest follow via next[]. */
+    int body;
+} bh_node_t;
+
+typedef struct _bh_tree {
+    /* Gravitational constant for the mutual attraction. */
+    double G;
+    /* Opening angle: a cell of width s at distance d is used as a single mass if s < theta*d. */
+    double theta;
+    /* Softening length; the force uses d**2 + eps**2 in place of d**2. */
+    double eps;
+    int num_nodes;
+    int node_capacity;
+    bh_node_t *nodes;
+    int body_capacity;
+    int *next;
+} bh_tree_t;
+
+bh_tree_t *bh_create(double G, double theta, double eps);
+void bh_free(bh_tree_t *tree);
+int bh_build(bh_tree_t *tree, int n, const double *pos);
+void bh_accel(const bh_tree_t *tree, int n, const double *pos, double *acc);
+int bh_gravity(bh_tree_t *tree, int n, const double *pos, double *acc);
+void direct_gravity(int n, const double *pos, double G, double eps, double *acc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,372 @@
+#include <sundials/sundials_core.h> // Provides core SUNDIALS types
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bonds.h"
+#include "contact.h"
+#include "de.h"
+#include "de_jac.h"
+#include "de_parallel.h"
+#include "de_simd.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// Add the end e of a connection to the list of its point.
+//
+static void link_end(bonds_t *bonds, int e)
+{
+    int point = bonds->connections[e];
+
+    bonds->prev[e] = -1;
+    bonds->next[e] = bonds->head[point];
+    if (bonds->head[point] >= 0) {
+        bonds->prev[bonds->head[point]] = e;
+    }
+    bonds->head[point] = e;
+}
+
+static void unlink_end(bonds_t *bonds, int e)
+{
+    if (bonds->prev[e] >= 0) {
+        bonds->next[bonds->prev[e]] = bonds->next[e];
+    }
+    else {
+        bonds->head[bonds->connections[e]] = bonds->next[e];
+    }
+    if (bonds->next[e] >= 0) {
+        bonds->prev[bonds->next[e]] = bonds->prev[e];
+    }
+}
+
+//
+// Grow the connections and the lists to at least capacity connections.
+//
+static int bonds_reserve(bonds_t *bonds, int capacity)
+{
+    int *a;
+
+    if (capacity <= bonds->capacity) {
+        return 0;
+    }
+    if (capacity < 2*bonds->capacity) {
+        capacity = 2*bonds->capacity;
+    }
+    // (Each array that has grown is kept, so a failure loses nothing.)
+    if ((a = realloc(bonds->connections, 2*capacity * sizeof(int))) == NULL) {
+        return -1;
+    }
+    bonds->connections = a;
+    bonds->params->connections = a;
+    if ((a = realloc(bonds->next, 2*capacity * sizeof(int))) == NULL) {
+        return -1;
+    }
+    bonds->next = a;
+    if ((a = realloc(bonds->prev, 2*capacity * sizeof(int))) == NULL) {
+        return -1;
+    }
+    bonds->prev = a;
+    bonds->capacity = capacity;
+    return 0;
+}
+
+//
+// Take over the connections of params, for springs that break at the
+// given strain (none if 0) and, if form is set, form at the contacts of
+// params->contact.  Returns NULL on failure.
+//
+bonds_t *bonds_create(xparams_t *params, double break_strain, int form)
+{
+    bonds_t *bonds;
+    int n = params->num_connections;
+    int idx;
+
+    if (form && params->contact == NULL) {
+        fprintf(stderr, "bonds_create: springs form at the contacts, which need params->contact\n");
+        return NULL;
+    }
+    if (form && break_strain > 0 &&
+            fabs(params->contact->d - params->L) >= break_strain*params->L) {
+        fprintf(stderr, "bonds_create: springs formed at the contact distance %g "
+                "would break at once\n", params->contact->d);
+        return NULL;
+    }
+    bonds = calloc(1, sizeof(bonds_t));
+    if (bonds == NULL) {
+        goto fail;
+    }
+    bonds->params = params;
+    bonds->break_strain = break_strain;
+    bonds->form = form;
+    bonds->orig_connections = params->connections;
+    bonds->orig_num_connections = n;
+    bonds->head = malloc(params->num_points * sizeof(int));
+    if (bonds->head == NULL || bonds_reserve(bonds, n < 8 ? 16 : n) != 0) {
+        goto fail;
+    }
+    memcpy(bonds->connections, bonds->orig_connections, 2*n * sizeof(int));
+    for (idx = 0; idx < params->num_points; ++idx) {
+        bonds->head[idx] = -1;
+    }
+    for (idx = 0; idx < 2*n; ++idx) {
+        link_end(bonds, idx);
+    }
+    params->bonds = bonds;
+    if (params->contact != NULL) {
+        params->contact->bonds = bonds;
+    }
+    return bonds;
+
+fail:
+    fprintf(stderr, "bonds_create: out of memory\n");
+    if (bonds != NULL) {
+        params->connections = bonds->orig_connections;
+        free(bonds->connections);
+        free(bonds->head);
+        free(bonds->next);
+        free(bonds->prev);
+        free(bonds);
+    }
+    return NULL;
+}
+
+//
+// Give params back the connections it had before bonds_create(), which
+// do not match params->schedule etc. any more if anything has changed.
+//
+void bonds_free(bonds_t *bonds)
+{
+    xparams_t *params;
+
+    if (bonds == NULL) {
+        return;
+    }
+    params = bonds->params;
+    params->connections = bonds->orig_connections;
+    params->num_connections = bonds->orig_num_connections;
+    params->bonds = NULL;
+    if (params->contact != NULL) {
+        params->contact->bonds = NULL;
+    }
+    free(bonds->connections);
+    free(bonds->head);
+    free(bonds->next);
+    free(bonds->prev);
+    free(bonds);
+}
+
+//
+// Whether a spring connects points i and j.
+//
+int bonds_connected(const bonds_t *bonds, int i, int j)
+{
+    int e;
+
+    for (e = bonds->head[i]; e >= 0; e = bonds->next[e]) {
+        // (The other end of a connection is e ^ 1.)
+        if (bonds->connections[e ^ 1] == j) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+//
+// The largest strain |r - L|/L of the springs at the positions y.
+//
+double bonds_max_strain(const xparams_t *params, const double *y)
+{
+    double max = 0.0;
+    int idx;
+
+    for (idx = 0; idx < params->num_connections; ++idx) {
+        int i = params->connections[2*idx];
+        int j = params->connections[2*idx + 1];
+        double strain = fabs(hypot(y[2*j] - y[2*i], y[2*j+1] - y[2*i+1]) - params->L);
+
+        if (strain > max) {
+            max = strain;
+        }
+    }
+    return max/params->L;
+}
+
+//
+// Break the spring idx; the last one takes its place.
+//
+void bonds_break(bonds_t *bonds, int idx)
+{
+    xparams_t *p = bonds->params;
+    int last = p->num_connections - 1;
+
+    unlink_end(bonds, 2*idx);
+    unlink_end(bonds, 2*idx + 1);
+    if (last != idx) {
+        unlink_end(bonds, 2*last);
+        unlink_end(bonds, 2*last + 1);
+        bonds->connections[2*idx] = bonds->connections[2*last];
+        bonds->connections[2*idx + 1] = bonds->connections[2*last + 1];
+        link_end(bonds, 2*idx);
+        link_end(bonds, 2*idx + 1);
+    }
+    if (p->schedule != NULL) {
+        de_schedule_remove(p->schedule, idx);
+    }
+    if (p->edges != NULL) {
+        edge_soa_remove(p->edges, idx);
+    }
+    if (p->jac_pattern != NULL) {
+        de_jac_pattern_disconnect(p->jac_pattern, idx);
+    }
+    p->num_connections = last;
+    ++bonds->num_broken;
+}
+
+//
+// Whether a connection of color c is at point i.
+//
+static int color_at(const bonds_t *bonds, const int *color, int i, int c)
+{
+    int e;
+
+    for (e = bonds->head[i]; e >= 0; e = bonds->next[e]) {
+        if (color[e/2] == c) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+//
+// Connect points i and j with a spring, as the last connection.  Returns
+// 1, or 0 if they are already connected (or the same point), or -1 if out
+// of memory.
+//
+int bonds_form(bonds_t *bonds, int i, int j)
+{
+    xparams_t *p = bonds->params;
+    int idx = p->num_connections;
+
+    if (i == j || bonds_connected(bonds, i, j)) {
+        return 0;
+    }
+    if (bonds_reserve(bonds, idx + 1) != 0) {
+        fprintf(stderr, "bonds_form: out of memory\n");
+        return -1;
+    }
+    if (p->schedule != NULL) {
+        // The smallest color free at both points, as de_schedule_create().
+        int c;
+
+        for (c = 0; color_at(bonds, p->schedule->color, i, c) ||
+                    color_at(bonds, p->schedule->color, j, c); ++c) {
+        }
+        if (de_schedule_add(p->schedule, idx, c) != 0) {
+            return -1;
+        }
+    }
+    if (p->edges != NULL && edge_soa_append(p->edges, p, i, j) != 0) {
+        return -1;
+    }
+    if (p->jac_pattern != NULL && de_jac_pattern_connect(p->jac_pattern, idx, i, j) != 0) {
+        return -1;
+    }
+    bonds->connections[2*idx] = i;
+    bonds->connections[2*idx + 1] = j;
+    link_end(bonds, 2*idx);
+    link_end(bonds, 2*idx + 1);
+    p->num_connections = idx + 1;
+    ++bonds->num_formed;
+    return 1;
+}
+
+//
+// Break the springs strained to break_strain.  Returns the number broken.
+//
+static int break_strained(bonds_t *bonds, const double *y)
+{
+    xparams_t *p = bonds->params;
+    double limit = (1 - BONDS_ROOT_TOL)*bonds->break_strain*p->L;
+    int count = 0;
+    int idx = 0;
+
+    while (idx < p->num_connections) {
+        int i = p->connections[2*idx];
+        int j = p->connections[2*idx + 1];
+        double r = hypot(y[2*j] - y[2*i], y[2*j+1] - y[2*i+1]);
+
+        if (fabs(r - p->L) >= limit) {
+            // (The last spring moves to idx, so idx is looked at again.)
+            bonds_break(bonds, idx);
+            ++count;
+        }
+        else {
+            ++idx;
+        }
+    }
+    return count;
+}
+
+//
+// Connect the closest points not connected, if they are within the
+// contact distance, and the spring would not be strained to
+// break_strain at once.  Returns 1 if a spring has formed, 0 if not, or
+// -1 if out of memory.
+//
+static int form_closest(bonds_t *bonds, const double *y)
+{
+    xparams_t *p = bonds->params;
+    int i, j;
+    double d = contact_closest(p->contact, y, &i, &j);
+
+    if (i < 0 || d > (1 + BONDS_ROOT_TOL)*p->contact->d) {
+        return 0;
+    }
+    if (bonds->break_strain > 0 &&
+            fabs(d - p->L) >= (1 - BONDS_ROOT_TOL)*bonds->break_strain*p->L) {
+        return 0;
+    }
+    return bonds_form(bonds, i, j);
+}
+
+//
+// At a root of contact_roots(): break the springs strained to
+// break_strain, and connect the points of the contact.  One change can
+// call for another (a spring that breaks in compression can leave its
+// points within the contact distance), so this is repeated until nothing
+// changes, and the root of breaking is positive again when the
+// integration restarts; otherwise it would stay negative and never
+// change sign.  (The contact root stays negative while a pair refused by
+// form_closest() is in contact, and changes sign when it parts.)  Returns
+// the number of springs broken and formed, or -1 if out of memory.
+//
+int bonds_update(bonds_t *bonds, const double *y)
+{
+    int count = 0;
+    int changes;
+
+    do {
+        changes = 0;
+        if (bonds->break_strain > 0) {
+            changes += break_strained(bonds, y);
+        }
+        if (bonds->form) {
+            int formed = form_closest(bonds, y);
+
+            if (formed < 0) {
+                return -1;
+            }
+            changes += formed;
+        }
+        count += changes;
+    } while (changes > 0);
+    return count;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,89 @@
+#ifndef _BONDS_H_
+#define _BONDS_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "de.h"
+
+//
+// Springs that break and form at run time.  A spring breaks when its
+// strain |r - L|/L reaches break_strain, and, if form is set, a spring of
+// natural length L forms between two points (not yet connected) that
+// come within the contact distance d of params->contact (contact.h).
+//
+// A spring is not formed if it would be strained to break_strain at once
+// (so the contact distance must be within break_strain*L of L), and
+// bonds_update() repeats its breaking and forming until nothing changes,
+// so the root of breaking below is positive again at the restart.
+//
+// Both are events of the root function contact_roots(): root ROOT_BREAK
+// is break_strain minus the largest strain, and the contacts are root
+// ROOT_CONTACT, which no longer counts the pairs already connected.  At a
+// root, bonds_update() changes the connections, and solver_reinit()
+// (solver.h) restarts the integrator from there:
+//
+//   flag = solver_evolve(solver, tout, y, &t);
+//   if (flag == CV_ROOT_RETURN && bonds_update(bonds, N_VGetArrayPointer(y)) > 0) {
+//       flag = solver_reinit(solver, t, y);
+//   }
+//
+// The connections are updated in place, together with whatever of
+// params has been created from them: the edge coloring of de_parallel()
+// (de_schedule_add()), the structure of arrays of de_simd()
+// (edge_soa_append()) and the Jacobian pattern of de_jac()
+// (de_jac_pattern_connect()).  A broken spring is replaced by the last
+// one; each point keeps the list of its connections, so a change costs
+// time in proportion to the number of connections of its two points, not
+// to the number of points.  Only a spring formed between two points that
+// had no blocks in the Jacobian pattern makes solver_reinit() create the
+// pattern again.  (Finding the springs that break takes a pass over the
+// connections, as does each evaluation of the root function.)
+//
+// bonds_create() takes over params->connections: they are copied to a
+// buffer that grows as springs form, and restored by bonds_free().  Create
+// params->contact, params->schedule and params->edges before, and the
+// solver after.  With bonds, the unrolled right-hand sides of de_fixed.h
+// are not used, since the topology can change.
+//
+
+// Relative tolerance of the strain and contact distance at a root.
+#define BONDS_ROOT_TOL 1e-6
+
+typedef struct _bonds {
+    xparams_t *params;
+    /* strain at which a spring breaks; 0 for none */
+    double break_strain;
+    /* whether springs form at the contacts */
+    int form;
+    /* the connections (params->connections), of length 2*capacity */
+    int *connections;
+    int capacity;
+    /* the connections of params before bonds_create() */
+    int *orig_connections;
+    int orig_num_connections;
+    /*
+     * The connections at each point: a list of the ends 2*idx and
+     * 2*idx + 1 of the connections (the positions of the points in
+     * connections), from head[point] through next; -1 ends.
+     */
+    int *head;
+    int *next, *prev;
+    /* number of springs broken and formed so far */
+    long num_broken, num_formed;
+} bonds_t;
+
+bonds_t *bonds_create(xparams_t *params, double break_strain, int form);
+void bonds_free(bonds_t *bonds);
+int bonds_connected(const bonds_t *bonds, int i, int j);
+double bonds_max_strain(const xparams_t *params, const double *y);
+void bonds_break(bonds_t *bonds, int idx);
+int bonds_form(bonds_t *bonds, int i, int j);
+int bonds_update(bonds_t *bonds, const double *y);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
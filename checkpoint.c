@@ -0,0 +1,566 @@
+#include <sundials/sundials_core.h>     // Provides core SUNDIALS types
+#include <nvector/nvector_serial.h>     // access to serial N_Vector
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "bonds.h"
+#include "checkpoint.h"
+#include "de.h"
+#include "force_law.h"
+#include "solver.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Bytes of the header: the magic string, seq, size and the hash.
+#define HEADER_SIZE 32
+
+// Bytes of t, h, k, L, b, g, r0 and of order, force_law, num_points,
+// num_connections, num_broken, num_formed.
+#define FIXED_SIZE (7*8 + 6*8)
+
+//
+// FNV-1a hash of size bytes, continuing from hash.
+//
+static uint64_t fnv1a(uint64_t hash, const void *data, size_t size)
+{
+    const unsigned char *b = data;
+    size_t i;
+
+    for (i = 0; i < size; ++i) {
+        hash = (hash ^ b[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+static uint64_t checksum(int64_t seq, int64_t size, const char *payload)
+{
+    uint64_t hash = 14695981039346656037ULL;
+
+    hash = fnv1a(hash, &seq, sizeof(seq));
+    hash = fnv1a(hash, &size, sizeof(size));
+    return fnv1a(hash, payload, size);
+}
+
+static int write_all(int fd, const char *data, size_t size)
+{
+    ssize_t n;
+
+    while (size > 0) {
+        n = write(fd, data, size);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        data += n;
+        size -= n;
+    }
+    return 0;
+}
+
+//
+// Write the checkpoint in buffer to the temporary file of its slot, and
+// rename it over the slot once it is on the disk.
+//
+static int write_file(checkpoint_t *checkpoint)
+{
+    const char *tmp = checkpoint->tmp_path[checkpoint->slot];
+    int fd;
+
+    fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+    if (write_all(fd, checkpoint->buffer, checkpoint->size) != 0 || fsync(fd) != 0) {
+        close(fd);
+        unlink(tmp);
+        return -1;
+    }
+    if (close(fd) != 0 || rename(tmp, checkpoint->path[checkpoint->slot]) != 0) {
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+//
+// The writer thread: writes each checkpoint that checkpoint_save() hands
+// over.
+//
+static void *writer(void *arg)
+{
+    checkpoint_t *checkpoint = arg;
+    int failed;
+
+    pthread_mutex_lock(&checkpoint->mutex);
+    for (;;) {
+        while (!checkpoint->pending && !checkpoint->quit) {
+            pthread_cond_wait(&checkpoint->cond, &checkpoint->mutex);
+        }
+        if (!checkpoint->pending) {
+            break;
+        }
+        pthread_mutex_unlock(&checkpoint->mutex);
+
+        failed = write_file(checkpoint) != 0;
+        if (failed) {
+            fprintf(stderr, "checkpoint: cannot write %s\n",
+                    checkpoint->path[checkpoint->slot]);
+        }
+
+        pthread_mutex_lock(&checkpoint->mutex);
+        if (failed) {
+            ++checkpoint->num_failed;
+        }
+        else {
+            ++checkpoint->num_written;
+        }
+        checkpoint->pending = 0;
+        pthread_cond_broadcast(&checkpoint->cond);
+    }
+    pthread_mutex_unlock(&checkpoint->mutex);
+    return NULL;
+}
+
+//
+// Start writing checkpoints to filename.0 and filename.1, numbered from
+// seq: 0 for a new integration, whose old checkpoints are removed, or
+// one more than the seq of the checkpoint it resumes from.  Returns NULL
+// on failure.
+//
+checkpoint_t *checkpoint_open(const char *filename, int64_t seq)
+{
+    checkpoint_t *checkpoint;
+    size_t len = strlen(filename);
+    int slot;
+
+    checkpoint = calloc(1, sizeof(checkpoint_t));
+    if (checkpoint == NULL) {
+        goto fail;
+    }
+    checkpoint->seq = seq;
+    for (slot = 0; slot < 2; ++slot) {
+        checkpoint->path[slot] = malloc(len + 3);
+        checkpoint->tmp_path[slot] = malloc(len + 7);
+        if (checkpoint->path[slot] == NULL || checkpoint->tmp_path[slot] == NULL) {
+            goto fail;
+        }
+        sprintf(checkpoint->path[slot], "%s.%d", filename, slot);
+        sprintf(checkpoint->tmp_path[slot], "%s.%d.tmp", filename, slot);
+        if (seq == 0) {
+            unlink(checkpoint->path[slot]);
+        }
+    }
+    pthread_mutex_init(&checkpoint->mutex, NULL);
+    pthread_cond_init(&checkpoint->cond, NULL);
+    if (pthread_create(&checkpoint->thread, NULL, writer, checkpoint) != 0) {
+        fprintf(stderr, "checkpoint_open: cannot create the writer thread\n");
+        pthread_cond_destroy(&checkpoint->cond);
+        pthread_mutex_destroy(&checkpoint->mutex);
+        goto cleanup;
+    }
+    return checkpoint;
+
+fail:
+    fprintf(stderr, "checkpoint_open: out of memory\n");
+cleanup:
+    if (checkpoint != NULL) {
+        for (slot = 0; slot < 2; ++slot) {
+            free(checkpoint->path[slot]);
+            free(checkpoint->tmp_path[slot]);
+        }
+        free(checkpoint);
+    }
+    return NULL;
+}
+
+static char *put(char *p, const void *value, size_t size)
+{
+    memcpy(p, value, size);
+    return p + size;
+}
+
+static char *put_double(char *p, double value)
+{
+    return put(p, &value, sizeof(value));
+}
+
+static char *put_int64(char *p, int64_t value)
+{
+    return put(p, &value, sizeof(value));
+}
+
+//
+// Take a checkpoint of the integration at the output time t, with the
+// state y, and hand it to the writer thread.  solver is the integrator,
+// for its history, or NULL to save the state only.  Returns 0, 1 if the
+// checkpoint has been skipped because the previous one is still being
+// written, or -1 if out of memory.
+//
+int checkpoint_save(checkpoint_t *checkpoint, const xparams_t *params,
+                    sunrealtype t, N_Vector y, solver_t *solver)
+{
+    size_t n = 4*params->num_points;
+    size_t conn_size = 2*params->num_connections * sizeof(int32_t);
+    size_t capacity;
+    sunrealtype h = 0.0;
+    int64_t size;
+    uint64_t hash;
+    char *p, *derivs;
+    int order, idx;
+
+    pthread_mutex_lock(&checkpoint->mutex);
+    if (checkpoint->pending) {
+        ++checkpoint->num_skipped;
+        pthread_mutex_unlock(&checkpoint->mutex);
+        return 1;
+    }
+    pthread_mutex_unlock(&checkpoint->mutex);
+
+    // The writer is idle, so the buffer is ours until pending is set.
+    capacity = HEADER_SIZE + FIXED_SIZE + conn_size +
+               (CHECKPOINT_MAX_ORDER + 1)*n * sizeof(double);
+    if (checkpoint->capacity < capacity) {
+        char *buffer = realloc(checkpoint->buffer, capacity);
+
+        if (buffer == NULL) {
+            fprintf(stderr, "checkpoint_save: out of memory\n");
+            return -1;
+        }
+        checkpoint->buffer = buffer;
+        checkpoint->capacity = capacity;
+    }
+    if (solver != NULL && checkpoint->dky == NULL) {
+        checkpoint->dky = N_VClone(y);
+        if (checkpoint->dky == NULL) {
+            fprintf(stderr, "checkpoint_save: out of memory\n");
+            return -1;
+        }
+    }
+
+    // The derivatives first, as their number is known when they are in.
+    derivs = checkpoint->buffer + HEADER_SIZE + FIXED_SIZE + conn_size;
+    memcpy(derivs, N_VGetArrayPointer(y), n * sizeof(double));
+    order = 0;
+    if (solver != NULL) {
+        if (solver_get_current_step(solver, &h) != 0) {
+            h = 0.0;
+        }
+        while (order < CHECKPOINT_MAX_ORDER &&
+               solver_get_dky(solver, t, order + 1, checkpoint->dky) == 0) {
+            ++order;
+            memcpy(derivs + order*n * sizeof(double),
+                   N_VGetArrayPointer(checkpoint->dky), n * sizeof(double));
+        }
+    }
+
+    p = checkpoint->buffer + HEADER_SIZE;
+    p = put_double(p, t);
+    p = put_double(p, h);
+    p = put_double(p, params->k);
+    p = put_double(p, params->L);
+    p = put_double(p, params->b);
+    p = put_double(p, params->g);
+    p = put_double(p, params->r0);
+    p = put_int64(p, order);
+    p = put_int64(p, params->force_law);
+    p = put_int64(p, params->num_points);
+    p = put_int64(p, params->num_connections);
+    p = put_int64(p, params->bonds != NULL ? params->bonds->num_broken : 0);
+    p = put_int64(p, params->bonds != NULL ? params->bonds->num_formed : 0);
+    for (idx = 0; idx < 2*params->num_connections; ++idx) {
+        int32_t point = params->connections[idx];
+
+        p = put(p, &point, sizeof(point));
+    }
+
+    size = FIXED_SIZE + conn_size + (order + 1)*n * sizeof(double);
+    hash = checksum(checkpoint->seq, size, checkpoint->buffer + HEADER_SIZE);
+    p = put(checkpoint->buffer, CHECKPOINT_MAGIC, 8);
+    p = put_int64(p, checkpoint->seq);
+    p = put_int64(p, size);
+    put(p, &hash, sizeof(hash));
+    checkpoint->size = HEADER_SIZE + size;
+    checkpoint->slot = checkpoint->seq % 2;
+    ++checkpoint->seq;
+
+    pthread_mutex_lock(&checkpoint->mutex);
+    checkpoint->pending = 1;
+    pthread_cond_broadcast(&checkpoint->cond);
+    pthread_mutex_unlock(&checkpoint->mutex);
+    return 0;
+}
+
+//
+// Wait until the checkpoint being written, if any, is on the disk, so the
+// next checkpoint_save() is not skipped.
+//
+void checkpoint_sync(checkpoint_t *checkpoint)
+{
+    pthread_mutex_lock(&checkpoint->mutex);
+    while (checkpoint->pending) {
+        pthread_cond_wait(&checkpoint->cond, &checkpoint->mutex);
+    }
+    pthread_mutex_unlock(&checkpoint->mutex);
+}
+
+//
+// Finish writing the last checkpoint and stop the writer thread.
+// Returns 0, or -1 if any checkpoint could not be written.
+//
+int checkpoint_close(checkpoint_t *checkpoint)
+{
+    int slot, error;
+
+    if (checkpoint == NULL) {
+        return 0;
+    }
+    checkpoint_sync(checkpoint);
+    pthread_mutex_lock(&checkpoint->mutex);
+    checkpoint->quit = 1;
+    pthread_cond_broadcast(&checkpoint->cond);
+    pthread_mutex_unlock(&checkpoint->mutex);
+    pthread_join(checkpoint->thread, NULL);
+
+    error = checkpoint->num_failed > 0;
+    pthread_cond_destroy(&checkpoint->cond);
+    pthread_mutex_destroy(&checkpoint->mutex);
+    for (slot = 0; slot < 2; ++slot) {
+        free(checkpoint->path[slot]);
+        free(checkpoint->tmp_path[slot]);
+    }
+    if (checkpoint->dky != NULL) {
+        N_VDestroy(checkpoint->dky);
+    }
+    free(checkpoint->buffer);
+    free(checkpoint);
+    return error ? -1 : 0;
+}
+
+//
+// Read the whole file path.  Returns NULL if it cannot be read.
+//
+static char *read_file(const char *path, size_t *size)
+{
+    FILE *f = fopen(path, "rb");
+    char *bytes = NULL;
+    long len;
+
+    if (f == NULL) {
+        return NULL;
+    }
+    if (fseek(f, 0, SEEK_END) == 0 && (len = ftell(f)) >= 0 &&
+            fseek(f, 0, SEEK_SET) == 0 && (bytes = malloc(len + 1)) != NULL) {
+        if (fread(bytes, 1, len, f) == (size_t) len) {
+            *size = len;
+        }
+        else {
+            free(bytes);
+            bytes = NULL;
+        }
+    }
+    fclose(f);
+    return bytes;
+}
+
+static const char *get(const char *p, void *value, size_t size)
+{
+    memcpy(value, p, size);
+    return p + size;
+}
+
+//
+// The checkpoint in the bytes of a file, or NULL if they are not a
+// complete and consistent checkpoint.
+//
+static checkpoint_data_t *parse(const char *bytes, size_t len)
+{
+    checkpoint_data_t *data;
+    const char *p;
+    int64_t seq, size, ints[6];
+    uint64_t hash;
+    size_t n;
+    int idx;
+
+    if (len < HEADER_SIZE + FIXED_SIZE || memcmp(bytes, CHECKPOINT_MAGIC, 8) != 0) {
+        return NULL;
+    }
+    p = get(bytes + 8, &seq, sizeof(seq));
+    p = get(p, &size, sizeof(size));
+    p = get(p, &hash, sizeof(hash));
+    if (size != (int64_t) (len - HEADER_SIZE) || checksum(seq, size, p) != hash) {
+        return NULL;
+    }
+
+    data = calloc(1, sizeof(checkpoint_data_t));
+    if (data == NULL) {
+        return NULL;
+    }
+    data->seq = seq;
+    p = get(p, &data->t, sizeof(double));
+    p = get(p, &data->h, sizeof(double));
+    p = get(p, &data->k, sizeof(double));
+    p = get(p, &data->L, sizeof(double));
+    p = get(p, &data->b, sizeof(double));
+    p = get(p, &data->g, sizeof(double));
+    p = get(p, &data->r0, sizeof(double));
+    p = get(p, ints, sizeof(ints));
+    if (ints[0] < 0 || ints[0] > CHECKPOINT_MAX_ORDER ||
+            ints[1] < 0 || ints[1] >= NUM_FORCE_LAWS || ints[2] < 1 ||
+            ints[2] > (1 << 28) || ints[3] < 0 || ints[3] > (1 << 28) ||
+            size != FIXED_SIZE + 2*ints[3]*(int64_t) sizeof(int32_t) +
+                    (ints[0] + 1)*4*ints[2]*(int64_t) sizeof(double)) {
+        free(data);
+        return NULL;
+    }
+    data->order = ints[0];
+    data->force_law = ints[1];
+    data->num_points = ints[2];
+    data->num_connections = ints[3];
+    data->num_broken = ints[4];
+    data->num_formed = ints[5];
+
+    n = 4*data->num_points;
+    data->connections = malloc((2*data->num_connections + 1) * sizeof(int));
+    data->dky = malloc((data->order + 1)*n * sizeof(double));
+    if (data->connections == NULL || data->dky == NULL) {
+        checkpoint_data_free(data);
+        return NULL;
+    }
+    for (idx = 0; idx < 2*data->num_connections; ++idx) {
+        int32_t point;
+
+        p = get(p, &point, sizeof(point));
+        if (point < 0 || point >= data->num_points) {
+            checkpoint_data_free(data);
+            return NULL;
+        }
+        data->connections[idx] = point;
+    }
+    get(p, data->dky, (data->order + 1)*n * sizeof(double));
+    return data;
+}
+
+//
+// The newest valid checkpoint of filename.0 and filename.1, or NULL if
+// neither is.
+//
+checkpoint_data_t *checkpoint_load(const char *filename)
+{
+    checkpoint_data_t *best = NULL;
+    char *path;
+    int slot;
+
+    path = malloc(strlen(filename) + 3);
+    if (path == NULL) {
+        fprintf(stderr, "checkpoint_load: out of memory\n");
+        return NULL;
+    }
+    for (slot = 0; slot < 2; ++slot) {
+        checkpoint_data_t *data;
+        char *bytes;
+        size_t len;
+
+        sprintf(path, "%s.%d", filename, slot);
+        bytes = read_file(path, &len);
+        if (bytes == NULL) {
+            continue;
+        }
+        data = parse(bytes, len);
+        free(bytes);
+        if (data == NULL) {
+            fprintf(stderr, "checkpoint_load: %s is not a valid checkpoint\n", path);
+        }
+        else if (best == NULL || data->seq > best->seq) {
+            checkpoint_data_free(best);
+            best = data;
+        }
+        else {
+            checkpoint_data_free(data);
+        }
+    }
+    free(path);
+    return best;
+}
+
+void checkpoint_data_free(checkpoint_data_t *data)
+{
+    if (data == NULL) {
+        return;
+    }
+    free(data->connections);
+    free(data->dky);
+    free(data);
+}
+
+//
+// Give params the parameters and connections of the checkpoint, and y its
+// state.  params->connections then points into data, which must outlive
+// it (bonds_create() copies them).  Returns 0, or -1 if the checkpoint is
+// of a different number of points.
+//
+int checkpoint_restore(const checkpoint_data_t *data, xparams_t *params, N_Vector y)
+{
+    if (data->num_points != params->num_points ||
+            N_VGetLength(y) != 4*data->num_points) {
+        fprintf(stderr, "checkpoint_restore: the checkpoint is of %d points, not %d\n",
+                data->num_points, params->num_points);
+        return -1;
+    }
+    params->k = data->k;
+    params->L = data->L;
+    params->b = data->b;
+    params->g = data->g;
+    params->r0 = data->r0;
+    params->force_law = data->force_law;
+    params->num_connections = data->num_connections;
+    params->connections = data->connections;
+    memcpy(N_VGetArrayPointer(y), data->dky, 4*data->num_points * sizeof(double));
+    return 0;
+}
+
+//
+// The first step size of the resumed integration, for the tolerances
+// rtol and atol: half the step size h at which h^2/2 |y''| = 1 in the
+// weighted RMS norm, as in CVODE's own choice of the first step, but no
+// more than the saved step size.  Without y'', the saved step size (0 if
+// unknown: let the integrator choose).
+//
+double checkpoint_initial_step(const checkpoint_data_t *data, double rtol, double atol)
+{
+    int n = 4*data->num_points;
+    const double *y = data->dky;
+    const double *ydd = data->dky + 2*n;
+    double sum = 0.0, norm, h;
+    int i;
+
+    if (data->order < 2) {
+        return data->h;
+    }
+    for (i = 0; i < n; ++i) {
+        double e = ydd[i]/(rtol*fabs(y[i]) + atol);
+
+        sum += e*e;
+    }
+    norm = sqrt(sum/n);
+    if (norm == 0.0) {
+        return data->h;
+    }
+    h = 0.5*sqrt(2.0/norm);
+    if (data->h > 0 && data->h < h) {
+        h = data->h;
+    }
+    return h;
+}
+
+#ifdef __cplusplus
+}
+#endif
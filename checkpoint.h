@@ -0,0 +1,112 @@
+#ifndef _CHECKPOINT_H_
+#define _CHECKPOINT_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include "de.h"
+#include "solver.h"
+
+//
+// Checkpoints of a long integration, from which it is resumed when the
+// process has been ended (pre-empted) instead of starting again at t = 0.
+//
+// A checkpoint, taken at an output time t, holds the time, the state, the
+// parameters and the connections of params (which change with bonds.h),
+// and the history of the integrator: the step size it would try next and
+// the derivatives y^(k)(t), k = 0..order, of its interpolating polynomial
+// (solver_get_dky(); for CVODE, order is that of the last step, and the
+// Nordsieck array is h^k/k! times the derivatives).  CVODE cannot be given
+// a Nordsieck array, so the resumed integration starts again at order 1,
+// with the first step of checkpoint_initial_step(): the step size at
+// which the error of a first order step, h^2/2 |y''|, meets the
+// tolerances, as CVODE's own first step, but from the saved y''.  The
+// resumed trajectory agrees with the original one to within the
+// tolerances, not bit for bit.  With no solver (the symplectic and
+// multirate integrators) only the state is saved, and order is 0.
+//
+// checkpoint_save() copies the checkpoint into a buffer, which a writer
+// thread writes to the file, as traj.h does with the frames.  If the
+// writer is still busy with the previous checkpoint, the new one is
+// skipped rather than waited for, so the integration never waits for the
+// disk.  The checkpoints go alternately to filename.0 and filename.1,
+// each by way of a temporary file that is synced and renamed, so the
+// previous checkpoint is intact while the next is written.
+// checkpoint_load() reads the newest of the two that is valid.
+//
+// The file is a header (CHECKPOINT_MAGIC, the sequence number of the
+// checkpoint, the size of the rest, and the FNV-1a hash of the sequence
+// number, size and rest), followed by t, h, k, L, b, g and r0 as doubles;
+// order, force_law, num_points, num_connections and the numbers of
+// springs broken and formed as 64 bit integers; the connections as 32
+// bit integers; and the derivatives, y first, as doubles.  All are in the
+// byte order of the machine.
+//
+
+#define CHECKPOINT_MAGIC "SPRNGCK1"
+
+// The highest derivative that is saved (CVODE's Adams methods go up to
+// order 12).
+#define CHECKPOINT_MAX_ORDER 12
+
+typedef struct _checkpoint {
+    /* filename.0 or filename.1, and the temporary file, of each slot */
+    char *path[2];
+    char *tmp_path[2];
+    /* sequence number of the next checkpoint; its slot is seq % 2 */
+    int64_t seq;
+    /* the checkpoint being written: its slot, bytes and size */
+    int slot;
+    char *buffer;
+    size_t size, capacity;
+    /* set while the writer thread writes buffer */
+    int pending;
+    /* work space for solver_get_dky() */
+    N_Vector dky;
+    /* number of checkpoints written, skipped, and failed */
+    long num_written, num_skipped, num_failed;
+    int quit;
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} checkpoint_t;
+
+//
+// A checkpoint read by checkpoint_load().
+//
+typedef struct _checkpoint_data {
+    int64_t seq;
+    double t;
+    /* step size to try next; 0 if unknown */
+    double h;
+    double k, L, b, g, r0;
+    int force_law;
+    int num_points;
+    int num_connections;
+    int *connections;
+    /* dky[k*4*num_points + i], for k = 0..order; y is dky[0..4*num_points-1] */
+    int order;
+    double *dky;
+    long num_broken, num_formed;
+} checkpoint_data_t;
+
+checkpoint_t *checkpoint_open(const char *filename, int64_t seq);
+int checkpoint_save(checkpoint_t *checkpoint, const xparams_t *params,
+                    sunrealtype t, N_Vector y, solver_t *solver);
+void checkpoint_sync(checkpoint_t *checkpoint);
+int checkpoint_close(checkpoint_t *checkpoint);
+
+checkpoint_data_t *checkpoint_load(const char *filename);
+void checkpoint_data_free(checkpoint_data_t *data);
+int checkpoint_restore(const checkpoint_data_t *data, xparams_t *params, N_Vector y);
+double checkpoint_initial_step(const checkpoint_data_t *data, double rtol, double atol);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
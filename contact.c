@@ -0,0 +1,259 @@
+#include <sundials/sundials_core.h> // Provides core SUNDIALS types
+
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "bonds.h"
+#include "contact.h"
+#include "de.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// Bucket of the cell (cx, cy).
+//
+static unsigned cell_bucket(const contact_t *c, int cx, int cy)
+{
+    return ((unsigned) cx*73856093u ^ (unsigned) cy*19349663u) & c->mask;
+}
+
+//
+// Create the grid for num_points points with contact distance d.
+// Returns NULL on failure.
+//
+contact_t *contact_create(int num_points, double d)
+{
+    contact_t *c;
+    unsigned num_buckets;
+    int i;
+
+    if (!(d > 0)) {
+        fprintf(stderr, "contact_create: the contact distance must be positive\n");
+        return NULL;
+    }
+    c = calloc(1, sizeof(contact_t));
+    if (c == NULL) {
+        goto fail;
+    }
+    c->num_points = num_points;
+    c->d = d;
+    c->h = 2*d;
+    // At least two buckets per point.
+    num_buckets = 16;
+    while (num_buckets < 2*(unsigned) num_points) {
+        num_buckets *= 2;
+    }
+    c->mask = num_buckets - 1;
+    c->head = malloc(num_buckets * sizeof(int));
+    c->next = malloc(num_points * sizeof(int));
+    c->prev = malloc(num_points * sizeof(int));
+    c->cx = malloc(num_points * sizeof(int));
+    c->cy = malloc(num_points * sizeof(int));
+    if (c->head == NULL || c->next == NULL || c->prev == NULL ||
+            c->cx == NULL || c->cy == NULL) {
+        goto fail;
+    }
+    for (i = 0; i < (int) num_buckets; ++i) {
+        c->head[i] = -1;
+    }
+    // No point is in a bucket yet: the first update inserts them all.
+    for (i = 0; i < num_points; ++i) {
+        c->cx[i] = INT_MIN;
+        c->cy[i] = INT_MIN;
+        c->next[i] = -1;
+        c->prev[i] = -1;
+    }
+    return c;
+
+fail:
+    fprintf(stderr, "contact_create: out of memory\n");
+    contact_free(c);
+    return NULL;
+}
+
+void contact_free(contact_t *c)
+{
+    if (c == NULL) {
+        return;
+    }
+    free(c->head);
+    free(c->next);
+    free(c->prev);
+    free(c->cx);
+    free(c->cy);
+    free(c);
+}
+
+//
+// Move the points that have changed cells to their new buckets.  Returns
+// 0, or -1 if a position is not finite (NaN has no cell).
+//
+static int contact_update(contact_t *c, const double *y)
+{
+    int i;
+
+    for (i = 0; i < c->num_points; ++i) {
+        double fx = floor(y[2*i]/c->h), fy = floor(y[2*i+1]/c->h);
+        int cx, cy;
+        unsigned b;
+
+        if (!isfinite(y[2*i]) || !isfinite(y[2*i+1])) {
+            fprintf(stderr, "contact_closest: point %d is at (%g, %g)\n",
+                    i, y[2*i], y[2*i+1]);
+            return -1;
+        }
+        // (Points beyond the range of int share the outermost cells.)
+        cx = fx < INT_MIN + 2 ? INT_MIN + 2 : fx > INT_MAX - 2 ? INT_MAX - 2 : (int) fx;
+        cy = fy < INT_MIN + 2 ? INT_MIN + 2 : fy > INT_MAX - 2 ? INT_MAX - 2 : (int) fy;
+        if (cx == c->cx[i] && cy == c->cy[i]) {
+            continue;
+        }
+        if (c->cx[i] != INT_MIN) {
+            // Unlink i from its old bucket.
+            if (c->prev[i] >= 0) {
+                c->next[c->prev[i]] = c->next[i];
+            }
+            else {
+                c->head[cell_bucket(c, c->cx[i], c->cy[i])] = c->next[i];
+            }
+            if (c->next[i] >= 0) {
+                c->prev[c->next[i]] = c->prev[i];
+            }
+        }
+        b = cell_bucket(c, cx, cy);
+        c->prev[i] = -1;
+        c->next[i] = c->head[b];
+        if (c->head[b] >= 0) {
+            c->prev[c->head[b]] = i;
+        }
+        c->head[b] = i;
+        c->cx[i] = cx;
+        c->cy[i] = cy;
+        ++c->moves;
+    }
+    return 0;
+}
+
+//
+// The distance of the two nearest points at the positions y (x, y of each
+// point), and the points in *i and *j; or 2*d and -1 if no two points are
+// closer than 2*d.  Points connected by a spring of c->bonds are skipped.
+// Returns -1 (and -1 in *i and *j) if a position is not finite.
+//
+double contact_closest(contact_t *c, const double *y, int *i, int *j)
+{
+    double min2 = c->h*c->h;
+    int p, q, a, b;
+
+    *i = -1;
+    *j = -1;
+    if (contact_update(c, y) != 0) {
+        return -1.0;
+    }
+    for (p = 0; p < c->num_points; ++p) {
+        for (a = -1; a <= 1; ++a) {
+            for (b = -1; b <= 1; ++b) {
+                int cx = c->cx[p] + a, cy = c->cy[p] + b;
+
+                for (q = c->head[cell_bucket(c, cx, cy)]; q >= 0; q = c->next[q]) {
+                    double dx, dy, d2;
+
+                    // Each pair once; skip the other cells of the bucket.
+                    if (q <= p || c->cx[q] != cx || c->cy[q] != cy) {
+                        continue;
+                    }
+                    dx = y[2*q] - y[2*p];
+                    dy = y[2*q+1] - y[2*p+1];
+                    d2 = dx*dx + dy*dy;
+                    if (d2 < min2 && (c->bonds == NULL ||
+                                      !bonds_connected(c->bonds, p, q))) {
+                        min2 = d2;
+                        *i = p;
+                        *j = q;
+                    }
+                }
+            }
+        }
+    }
+    return sqrt(min2);
+}
+
+//
+// The point nearest the origin at the positions y.
+//
+int collision_point(const xparams_t *params, const double *y)
+{
+    double min2 = HUGE_VAL;
+    int idx, imin = 0;
+
+    for (idx = 0; idx < params->num_points; ++idx) {
+        double r2 = y[2*idx]*y[2*idx] + y[2*idx+1]*y[2*idx+1];
+        if (r2 < min2) {
+            min2 = r2;
+            imin = idx;
+        }
+    }
+    return imin;
+}
+
+int contact_num_roots(const xparams_t *params)
+{
+    return 1 + (params->contact != NULL) +
+           (params->bonds != NULL && params->bonds->break_strain > 0);
+}
+
+int contact_root_index(const xparams_t *params, int root)
+{
+    switch (root) {
+    case ROOT_CENTRAL:
+        return 0;
+    case ROOT_CONTACT:
+        return params->contact != NULL ? 1 : -1;
+    case ROOT_BREAK:
+        if (params->bonds != NULL && params->bonds->break_strain > 0) {
+            return params->contact != NULL ? 2 : 1;
+        }
+        return -1;
+    }
+    return -1;
+}
+
+//
+// Root function for CVODE with contact_num_roots(params) roots; see
+// contact.h.  Fails (returns -1, which stops the solver) if a position is
+// not finite.
+//
+int contact_roots(sunrealtype t, N_Vector w, sunrealtype *gout, void *params)
+{
+    xparams_t *p = params;
+    const double *y = N_VGetArrayPointer(w);
+
+    if (p->g > 0) {
+        int imin = collision_point(p, y);
+        gout[0] = hypot(y[2*imin], y[2*imin+1]) - p->r0;
+    }
+    else {
+        gout[0] = 1.0;
+    }
+    if (p->contact != NULL) {
+        int i, j;
+        double d = contact_closest(p->contact, y, &i, &j);
+
+        if (d < 0) {
+            return -1;
+        }
+        gout[1] = d - p->contact->d;
+    }
+    if (p->bonds != NULL && p->bonds->break_strain > 0) {
+        gout[contact_root_index(p, ROOT_BREAK)] =
+            p->bonds->break_strain - bonds_max_strain(p, y);
+    }
+    return 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
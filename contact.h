@@ -0,0 +1,75 @@
+#ifndef _CONTACT_H_
+#define _CONTACT_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sundials/sundials_core.h>
+#include <nvector/nvector_serial.h>
+
+#include "de.h"
+
+//
+// Collisions as CVODE roots, with a number of root functions that does
+// not grow with the number of points (collision() has one per point):
+//
+//   root 0:  the distance of the point nearest the origin, minus r0 (1 if
+//            there is no central mass); collision_point() tells which
+//            point it is.
+//   root 1:  only if params->contact has been created (contact_create()):
+//            the distance of the two nearest points, minus the contact
+//            distance d; contact_closest() tells which points they are.
+//            With springs that break and form (bonds.h), the points
+//            connected by a spring are not counted.
+//   root 2:  only if params->bonds has a break strain: the break strain
+//            minus the largest strain of the springs (bonds_max_strain()).
+//
+// contact_num_roots() is the number of root functions for
+// CVodeRootInit() and contact_roots() the root function;
+// contact_root_index() is the index of root ROOT_CENTRAL, ROOT_CONTACT
+// or ROOT_BREAK among them, or -1 if it is not there.
+//
+// The nearest points are found with a uniform grid of cells of size 2*d,
+// hashed into a table of buckets, so that any two points closer than 2*d
+// are in the same or neighboring cells; the cost is proportional to the
+// number of points.  The grid is kept from one call to the next: only the
+// points that have moved to another cell are moved between the buckets
+// (doubly linked lists).  Distances of 2*d or more are reported as 2*d,
+// which keeps root 1 continuous.
+//
+
+#define ROOT_CENTRAL 0
+#define ROOT_CONTACT 1
+#define ROOT_BREAK   2
+
+typedef struct _contact {
+    int num_points;
+    /* contact distance, and the cell size 2*d */
+    double d, h;
+    /* number of buckets minus 1 (a power of 2 minus 1) */
+    unsigned mask;
+    /* first point of each bucket, and the lists of points; -1 ends */
+    int *head;
+    int *next, *prev;
+    /* cell of each point */
+    int *cx, *cy;
+    /* number of points moved between cells so far */
+    long moves;
+    /* the springs, whose points are not in contact; NULL for none */
+    const struct _bonds *bonds;
+} contact_t;
+
+contact_t *contact_create(int num_points, double d);
+void contact_free(contact_t *contact);
+double contact_closest(contact_t *contact, const double *y, int *i, int *j);
+int collision_point(const xparams_t *params, const double *y);
+int contact_num_roots(const xparams_t *params);
+int contact_root_index(const xparams_t *params, int root);
+int contact_roots(sunrealtype t, N_Vector w, sunrealtype *gout, void *params);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
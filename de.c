@@ -2,7 +2,10 @@
 
 #include <math.h>
 #include <stdio.h>
+#include <string.h>
 #include "de.h"
+#include "bh.h"
+#include "force_law.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -10,14 +13,55 @@ extern "C" {
 
 //
 // Force of the spring, given separation r, spring constant k,
-// and natural length L.
+// and natural length L, for the default force law FORCE_CUBIC.
+// (The other laws are in force_law.h.)
 //
 double spring_force(double r, double k, double L)
 {
-    double rho = L/r;
-    return -k*r*(1 - rho)*(1 + rho + rho*rho);
-    // return k*r*(1 - rho);
-    // return k*(L - r);
+    return force_cubic(r, k, L);
+}
+
+//
+// Derivative with respect to r of spring_force(r, k, L).
+//
+double spring_force_deriv(double r, double k, double L)
+{
+    return force_cubic_deriv(r, k, L);
+}
+
+// (At r = L the slope of "cubic" is -3k, that of the others -k, in
+// tension for "bilinear"; see force_law.h.)
+const force_law_t force_laws[NUM_FORCE_LAWS] = {
+    {"cubic",    force_cubic,    force_cubic_deriv},
+    {"hooke",    force_hooke,    force_hooke_deriv},
+    {"lj",       force_lj,       force_lj_deriv},
+    {"bilinear", force_bilinear, force_bilinear_deriv}
+};
+
+//
+// The force law (FORCE_CUBIC etc.) of the given name, or -1 if there is
+// none.
+//
+int force_law_lookup(const char *name)
+{
+    int law;
+
+    for (law = 0; law < NUM_FORCE_LAWS; ++law) {
+        if (strcmp(name, force_laws[law].name) == 0) {
+            return law;
+        }
+    }
+    return -1;
+}
+
+//
+// Zero all the fields of an xparams_t.  Optional fields (pointers to
+// solver work space) are then NULL, so only the physical parameters and
+// the connections need to be filled in by the caller.
+//
+void xparams_init(xparams_t *p)
+{
+    memset(p, 0, sizeof(xparams_t));
 }
 
 
@@ -90,33 +134,18 @@ int de3(sunrealtype t, N_Vector w, N_Vector f, void *params)
 
 
 //
-// The vector field for a system of point masses in a plane connected
-// by springs.
-//
+// The spring and friction forces of the connections, added to the
+// accelerations in f, with the force law spring.  de() calls this with a
+// constant spring for each law, so that the call is specialized for the
+// law with no dispatch per connection.
 //
-//  w holds [x0, y0, x1, y1, x2, y2, ...,
-//           dx0/dt, dy0/dt, dx1/dt, dy1/dt, dx2/dt, dy2/dt, ...]
-//
-
-
-int de(sunrealtype t, N_Vector w, N_Vector f, void *params)
+static inline void de_connections(const xparams_t *p, N_Vector w, N_Vector f,
+                                  force_fn spring)
 {
-    xparams_t *p = params;
-    int num_points;
+    int num_points = p->num_points;
+    int num_connections = p->num_connections;
+    int *connections = p->connections;
     int idx;
-    int num_connections;
-    int *connections;
-
-    num_points = p->num_points;
-    num_connections = p->num_connections;
-    connections = p->connections;
-
-    for (idx = 0; idx < num_points; ++idx) {
-        NV_Ith_S(f, 2*idx) = NV_Ith_S(w, 2*num_points + 2*idx);
-        NV_Ith_S(f, 2*idx+1) = NV_Ith_S(w, 2*num_points + 2*idx + 1);
-        NV_Ith_S(f, 2*num_points + 2*idx) = 0.0;
-        NV_Ith_S(f, 2*num_points + 2*idx + 1) = 0.0;
-    }
 
     for (idx = 0; idx < num_connections; ++idx) {
         int i, j, ii, jj;
@@ -137,7 +166,7 @@ int de(sunrealtype t, N_Vector w, N_Vector f, void *params)
         //
         // Compute the contribution of the spring forces to the system of equations.
         //
-        force = spring_force(dist, p->k, p->L);
+        force = spring(dist, p->k, p->L);
         fvec[0] = force*uvec[0];
         fvec[1] = force*uvec[1];
         ii = 2*num_points + 2*i;
@@ -165,6 +194,48 @@ int de(sunrealtype t, N_Vector w, N_Vector f, void *params)
         NV_Ith_S(f, jj)   -= fvec[0];
         NV_Ith_S(f, jj+1) -= fvec[1];
     }
+}
+
+
+//
+// The vector field for a system of point masses in a plane connected
+// by springs.
+//
+//
+//  w holds [x0, y0, x1, y1, x2, y2, ...,
+//           dx0/dt, dy0/dt, dx1/dt, dy1/dt, dx2/dt, dy2/dt, ...]
+//
+
+
+int de(sunrealtype t, N_Vector w, N_Vector f, void *params)
+{
+    xparams_t *p = params;
+    int num_points;
+    int idx;
+
+    num_points = p->num_points;
+
+    for (idx = 0; idx < num_points; ++idx) {
+        NV_Ith_S(f, 2*idx) = NV_Ith_S(w, 2*num_points + 2*idx);
+        NV_Ith_S(f, 2*idx+1) = NV_Ith_S(w, 2*num_points + 2*idx + 1);
+        NV_Ith_S(f, 2*num_points + 2*idx) = 0.0;
+        NV_Ith_S(f, 2*num_points + 2*idx + 1) = 0.0;
+    }
+
+    switch (p->force_law) {
+    case FORCE_HOOKE:
+        de_connections(p, w, f, force_hooke);
+        break;
+    case FORCE_LJ:
+        de_connections(p, w, f, force_lj);
+        break;
+    case FORCE_BILINEAR:
+        de_connections(p, w, f, force_bilinear);
+        break;
+    default:
+        de_connections(p, w, f, force_cubic);
+        break;
+    }
 
     if (p->g > 0) {
         // Compute the contribution of the gravitational forces to
@@ -180,6 +251,50 @@ int de(sunrealtype t, N_Vector w, N_Vector f, void *params)
         }
     }
 
+    if (p->bh != NULL) {
+        // Mutual gravity between the points.
+        if (bh_gravity(p->bh, num_points, N_VGetArrayPointer(w),
+                       N_VGetArrayPointer(f) + 2*num_points) != 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+//
+// The gravity terms of de() alone: the central mass and, if params->bh
+// has been created, the mutual gravity; zero for the positions.  (de()
+// with g = 0 and no bh is the rest.)  This is the slow partition of the
+// multirate integrator and the explicit part of the IMEX one.
+//
+int de_gravity(sunrealtype t, N_Vector w, N_Vector f, void *params)
+{
+    xparams_t *p = params;
+    int num_points = p->num_points;
+    const double *y = N_VGetArrayPointer(w);
+    double *fy = N_VGetArrayPointer(f);
+    double *acc = fy + 2*num_points;
+    int idx;
+
+    for (idx = 0; idx < 4*num_points; ++idx) {
+        fy[idx] = 0.0;
+    }
+    if (p->g > 0) {
+        for (idx = 0; idx < num_points; ++idx) {
+            double xi = y[2*idx];
+            double yi = y[2*idx+1];
+            double r = hypot(xi, yi);
+            double r3 = r*r*r;
+            acc[2*idx] = -p->g * xi / r3;
+            acc[2*idx+1] = -p->g * yi / r3;
+        }
+    }
+    if (p->bh != NULL) {
+        if (bh_gravity(p->bh, num_points, y, acc) != 0) {
+            return -1;
+        }
+    }
     return 0;
 }
 
@@ -209,6 +324,25 @@ int collision(sunrealtype t, N_Vector w, sunrealtype *gout, void *user_data)
 }
 
 
+//
+// Connections of the 7 point hexagon created by hex_ics(): the center
+// (point 0) to each corner, and each corner to the next.
+//
+int hex_connections[2*HEX_NUM_CONNECTIONS] = {
+    0, 1,
+    0, 2,
+    0, 3,
+    0, 4,
+    0, 5,
+    0, 6,
+    1, 2,
+    2, 3,
+    3, 4,
+    4, 5,
+    5, 6,
+    6, 1
+};
+
 int hex_ics(double cx, double cy, double L, double *p)
 {
     int i;
@@ -261,8 +395,10 @@ int de_rigid_hex(sunrealtype t, N_Vector w, N_Vector f, void *params)
         double dx, dy, xi, yi, ri, ri3, fx, fy;
 
         if (idx < 6) {
-            dx = (p->L)*cos(theta);
-            dy = (p->L)*sin(theta);
+            // The corners, at the angles animate_dynamics_rigid_hex draws
+            // them at (and symplectic.c detects their collisions at).
+            dx = (p->L)*cos(theta + idx*M_PI/3);
+            dy = (p->L)*sin(theta + idx*M_PI/3);
         }
         else {
             // idx == 6 is the center point.
@@ -280,7 +416,7 @@ int de_rigid_hex(sunrealtype t, N_Vector w, N_Vector f, void *params)
 
         NV_Ith_S(f, 3) += fx;
         NV_Ith_S(f, 4) += fy;
-        NV_Ith_S(f, 5) += -dx*fy + dy*fx;  // torque about (xc,yc)
+        NV_Ith_S(f, 5) += dx*fy - dy*fx;  // torque about (xc,yc)
     }
     // Total mass is 7.
     NV_Ith_S(f, 3) /= 7.0;
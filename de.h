@@ -7,6 +7,15 @@ extern "C" {
 
 #include <nvector/nvector_serial.h> // access to serial N_Vector
 
+struct _de_jac_pattern;
+struct _de_prec;
+struct _de_schedule;
+struct _edge_soa;
+struct _bh_tree;
+struct _de_stats;
+struct _contact;
+struct _bonds;
+
 typedef struct _params {
     double k, L, b, g;
 } params_t;
@@ -14,12 +23,57 @@ typedef struct _params {
 typedef struct _xparams {
     double k, L, b, g;
     double r0;
+    /* force law of the springs, FORCE_CUBIC (0) etc. (see force_law.h) */
+    int force_law;
     /* num_points is the number of points */
 	int num_points;
 	/* num_connections is the number of connections between points */
     int num_connections;
     /* connections is an array of length 2*n */
     int *connections;
+    /*
+     * Sparsity pattern of the Jacobian of de(), created by
+     * de_jac_pattern_create().  NULL unless a sparse linear
+     * solver is in use.
+     */
+    struct _de_jac_pattern *jac_pattern;
+    /*
+     * Block diagonal preconditioner used with the Krylov linear
+     * solvers, created by de_prec_create().  NULL otherwise.
+     */
+    struct _de_prec *prec;
+    /*
+     * Edge coloring for the threaded right-hand side de_parallel(),
+     * created by de_schedule_create().  NULL otherwise.
+     */
+    struct _de_schedule *schedule;
+    /*
+     * Structure-of-arrays copy of the connections for the vectorized
+     * right-hand side de_simd(), created by edge_soa_create().
+     * NULL otherwise.
+     */
+    struct _edge_soa *edges;
+    /*
+     * Mutual gravity between the points, computed with a Barnes-Hut
+     * quadtree (see bh.h).  Created with bh_create(); NULL for no mutual
+     * gravity.  (It is not included in the analytic Jacobians.)
+     */
+    struct _bh_tree *bh;
+    /*
+     * Call counts and timing of the right-hand side and root function,
+     * created by stats_create() (see stats.h).  NULL for no timing.
+     */
+    struct _de_stats *stats;
+    /*
+     * Grid for the contacts between the points, created by
+     * contact_create() (see contact.h).  NULL for no contacts.
+     */
+    struct _contact *contact;
+    /*
+     * Springs that break and form at run time, created by bonds_create()
+     * (see bonds.h).  NULL for connections that do not change.
+     */
+    struct _bonds *bonds;
 } xparams_t;
 
 typedef struct _rigid_hex_params {
@@ -27,13 +81,22 @@ typedef struct _rigid_hex_params {
 	double r0;
 } rigid_hex_params_t;
 
+#define HEX_NUM_POINTS      7
+#define HEX_NUM_CONNECTIONS 12
+
+extern int hex_connections[2*HEX_NUM_CONNECTIONS];
+
 #define X(w,i)  NV_Ith_S(w, 2*(i))
 #define Y(w,i)  NV_Ith_S(w, 2*(i)+1)
 #define U(w,i)  NV_Ith_S(w, 2*(i)+6)
 #define V(w,i)  NV_Ith_S(w, 2*(i)+7)
 
+void xparams_init(xparams_t *p);
+double spring_force(double r, double k, double L);
+double spring_force_deriv(double r, double k, double L);
 int de3(sunrealtype t, N_Vector w, N_Vector f, void *params);
 int de(sunrealtype t, N_Vector w, N_Vector f, void *params);
+int de_gravity(sunrealtype t, N_Vector w, N_Vector f, void *params);
 int collision(sunrealtype t, N_Vector y, sunrealtype *gout, void *user_data);
 int hex_ics(double cx, double cy, double L, double *p);
 int de_rigid_hex(sunrealtype t, N_Vector w, N_Vector f, void *params);
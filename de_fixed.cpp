@@ -0,0 +1,177 @@
+#include <sundials/sundials_core.h>     // Provides core SUNDIALS types
+#include <nvector/nvector_serial.h>     // access to serial N_Vector
+#include <sunmatrix/sunmatrix_dense.h>  // access to dense SUNMatrix
+
+#include "de_fixed.h"
+#include "topology.h"
+
+
+//
+// The topologies of de_fixed.h.
+//
+struct Triangle {
+    static constexpr int num_points = 3;
+    static constexpr int num_connections = 3;
+    static constexpr int connections[3][2] = {{0, 1}, {0, 2}, {1, 2}};
+};
+
+// lattice_build() for LATTICE_HEX with rings = 1.
+struct LatticeHexagon {
+    static constexpr int num_points = HEX_NUM_POINTS;
+    static constexpr int num_connections = HEX_NUM_CONNECTIONS;
+    static constexpr int connections[HEX_NUM_CONNECTIONS][2] = {
+        {0, 1}, {0, 2}, {0, 3}, {1, 2}, {3, 2}, {4, 0},
+        {4, 3}, {5, 6}, {5, 0}, {5, 4}, {6, 1}, {6, 0}
+    };
+};
+
+// hex_connections.
+struct Hexagon {
+    static constexpr int num_points = HEX_NUM_POINTS;
+    static constexpr int num_connections = HEX_NUM_CONNECTIONS;
+    static constexpr int connections[HEX_NUM_CONNECTIONS][2] = {
+        {0, 1}, {0, 2}, {0, 3}, {0, 4}, {0, 5}, {0, 6},
+        {1, 2}, {2, 3}, {3, 4}, {4, 5}, {5, 6}, {6, 1}
+    };
+};
+
+typedef FixedSystem<Triangle, CubicSpring> TriSystem;
+typedef FixedSystem<LatticeHexagon, CubicSpring> HexSystem;
+typedef FixedSystem<Hexagon, CubicSpring> HexIcsSystem;
+
+
+//
+// The CVODE interface of FixedSystem<...>::rhs() and jac().
+//
+template <class System>
+static int fixed_rhs(N_Vector w, N_Vector f, void *params)
+{
+    System::rhs(N_VGetArrayPointer(w), N_VGetArrayPointer(f),
+                (const xparams_t *) params);
+    return 0;
+}
+
+template <class System>
+static int fixed_jac(N_Vector w, SUNMatrix J, void *params)
+{
+    System::jac(N_VGetArrayPointer(w), SM_DATA_D(J), SM_ROWS_D(J),
+                (const xparams_t *) params);
+    return 0;
+}
+
+template <class Topology, class Force>
+static int law_rhs(sunrealtype t, N_Vector w, N_Vector f, void *params)
+{
+    return fixed_rhs<FixedSystem<Topology, Force> >(w, f, params);
+}
+
+template <class Topology, class Force>
+static int law_jac(sunrealtype t, N_Vector w, N_Vector fw, SUNMatrix J, void *params,
+                   N_Vector tmp1, N_Vector tmp2, N_Vector tmp3)
+{
+    return fixed_jac<FixedSystem<Topology, Force> >(w, J, params);
+}
+
+//
+// The right-hand sides and Jacobians of a topology for each force law,
+// indexed by xparams_t.force_law.
+//
+template <class Topology>
+struct LawTable {
+    static const CVRhsFn rhs[NUM_FORCE_LAWS];
+    static const CVLsJacFn jac[NUM_FORCE_LAWS];
+};
+
+template <class Topology>
+const CVRhsFn LawTable<Topology>::rhs[NUM_FORCE_LAWS] = {
+    law_rhs<Topology, CubicSpring>,
+    law_rhs<Topology, HookeSpring>,
+    law_rhs<Topology, LennardJonesSpring>,
+    law_rhs<Topology, BilinearSpring>
+};
+
+template <class Topology>
+const CVLsJacFn LawTable<Topology>::jac[NUM_FORCE_LAWS] = {
+    law_jac<Topology, CubicSpring>,
+    law_jac<Topology, HookeSpring>,
+    law_jac<Topology, LennardJonesSpring>,
+    law_jac<Topology, BilinearSpring>
+};
+
+
+extern "C" {
+
+int de_tri(sunrealtype t, N_Vector w, N_Vector f, void *params)
+{
+    return fixed_rhs<TriSystem>(w, f, params);
+}
+
+int de_tri_jac(sunrealtype t, N_Vector w, N_Vector fw, SUNMatrix J, void *params,
+               N_Vector tmp1, N_Vector tmp2, N_Vector tmp3)
+{
+    return fixed_jac<TriSystem>(w, J, params);
+}
+
+int de_hex(sunrealtype t, N_Vector w, N_Vector f, void *params)
+{
+    return fixed_rhs<HexSystem>(w, f, params);
+}
+
+int de_hex_jac(sunrealtype t, N_Vector w, N_Vector fw, SUNMatrix J, void *params,
+               N_Vector tmp1, N_Vector tmp2, N_Vector tmp3)
+{
+    return fixed_jac<HexSystem>(w, J, params);
+}
+
+int de_hex_ics(sunrealtype t, N_Vector w, N_Vector f, void *params)
+{
+    return fixed_rhs<HexIcsSystem>(w, f, params);
+}
+
+int de_hex_ics_jac(sunrealtype t, N_Vector w, N_Vector fw, SUNMatrix J, void *params,
+                   N_Vector tmp1, N_Vector tmp2, N_Vector tmp3)
+{
+    return fixed_jac<HexIcsSystem>(w, J, params);
+}
+
+CVRhsFn de_fixed_rhs(const xparams_t *params)
+{
+    int law = params->force_law;
+
+    if (params->bh != NULL || params->bonds != NULL ||
+            law < 0 || law >= NUM_FORCE_LAWS) {
+        return NULL;
+    }
+    if (topology_matches<Triangle>(params)) {
+        return LawTable<Triangle>::rhs[law];
+    }
+    if (topology_matches<LatticeHexagon>(params)) {
+        return LawTable<LatticeHexagon>::rhs[law];
+    }
+    if (topology_matches<Hexagon>(params)) {
+        return LawTable<Hexagon>::rhs[law];
+    }
+    return NULL;
+}
+
+CVLsJacFn de_fixed_jac(const xparams_t *params)
+{
+    int law = params->force_law;
+
+    if (params->bh != NULL || params->bonds != NULL ||
+            law < 0 || law >= NUM_FORCE_LAWS) {
+        return NULL;
+    }
+    if (topology_matches<Triangle>(params)) {
+        return LawTable<Triangle>::jac[law];
+    }
+    if (topology_matches<LatticeHexagon>(params)) {
+        return LawTable<LatticeHexagon>::jac[law];
+    }
+    if (topology_matches<Hexagon>(params)) {
+        return LawTable<Hexagon>::jac[law];
+    }
+    return NULL;
+}
+
+}
@@ -0,0 +1,50 @@
+#ifndef _DE_FIXED_H_
+#define _DE_FIXED_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sundials/sundials_core.h>
+#include <cvode/cvode.h>
+#include <nvector/nvector_serial.h>
+
+#include "de.h"
+
+//
+// de() and its Jacobian for the small systems of fixed topology, unrolled
+// at compile time (topology.h):
+//
+//   de_tri():      3 points, the connections {0, 1, 0, 2, 1, 2} of
+//                  demain (the system of de3()).
+//   de_hex():      7 points, the connections of lattice_build() for a
+//                  hexagon of one ring (animate_dynamics2).
+//   de_hex_ics():  7 points, hex_connections (hex_ics()).
+//
+// The Jacobians (de_tri_jac() etc.) are for a dense SUNMatrix.  These
+// are for the default force law, FORCE_CUBIC.
+//
+// de_fixed_rhs() and de_fixed_jac() return the functions for the topology
+// and the force law of params, or NULL if there are none (or params->bh
+// or params->bonds has been created), in which case de() and the generic
+// Jacobians apply.  solver_rhs() and
+// solver_create() use them.
+//
+
+int de_tri(sunrealtype t, N_Vector w, N_Vector f, void *params);
+int de_tri_jac(sunrealtype t, N_Vector w, N_Vector fw, SUNMatrix J, void *params,
+               N_Vector tmp1, N_Vector tmp2, N_Vector tmp3);
+int de_hex(sunrealtype t, N_Vector w, N_Vector f, void *params);
+int de_hex_jac(sunrealtype t, N_Vector w, N_Vector fw, SUNMatrix J, void *params,
+               N_Vector tmp1, N_Vector tmp2, N_Vector tmp3);
+int de_hex_ics(sunrealtype t, N_Vector w, N_Vector f, void *params);
+int de_hex_ics_jac(sunrealtype t, N_Vector w, N_Vector fw, SUNMatrix J, void *params,
+                   N_Vector tmp1, N_Vector tmp2, N_Vector tmp3);
+CVRhsFn de_fixed_rhs(const xparams_t *params);
+CVLsJacFn de_fixed_jac(const xparams_t *params);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
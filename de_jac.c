@@ -0,0 +1,589 @@
+#include <sundials/sundials_core.h> // Provides core SUNDIALS types
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "de.h"
+#include "de_jac.h"
+#include "force_law.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static int compare_int(const void *a, const void *b)
+{
+    int ia = *(const int *) a;
+    int ib = *(const int *) b;
+    return (ia > ib) - (ia < ib);
+}
+
+//
+// Position of value in the sorted array list[0:n], or -1.
+//
+static int find_int(const int *list, int n, int value)
+{
+    int lo = 0, hi = n - 1;
+
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (list[mid] < value) {
+            lo = mid + 1;
+        }
+        else if (list[mid] > value) {
+            hi = mid - 1;
+        }
+        else {
+            return mid;
+        }
+    }
+    return -1;
+}
+
+de_jac_pattern_t *de_jac_pattern_create(const xparams_t *p)
+{
+    de_jac_pattern_t *pattern;
+    int num_points = p->num_points;
+    int num_connections = p->num_connections;
+    int *start, *fill, *nbrs;
+    int idx;
+    sunindextype nnz, row;
+
+    pattern = calloc(1, sizeof(de_jac_pattern_t));
+    start = calloc(num_points + 1, sizeof(int));
+    fill = calloc(num_points, sizeof(int));
+    nbrs = malloc((2*num_connections + num_points) * sizeof(int));
+    if (pattern == NULL || start == NULL || fill == NULL || nbrs == NULL) {
+        goto fail;
+    }
+    pattern->num_points = num_points;
+    pattern->num_connections = num_connections;
+    pattern->capacity = num_connections;
+
+    // Neighbor lists of each point, including the point itself.
+    for (idx = 0; idx < num_connections; ++idx) {
+        ++start[p->connections[2*idx] + 1];
+        ++start[p->connections[2*idx + 1] + 1];
+    }
+    for (idx = 0; idx < num_points; ++idx) {
+        start[idx + 1] += start[idx] + 1;
+    }
+    for (idx = 0; idx < num_points; ++idx) {
+        nbrs[start[idx] + fill[idx]++] = idx;
+    }
+    for (idx = 0; idx < num_connections; ++idx) {
+        int i = p->connections[2*idx];
+        int j = p->connections[2*idx + 1];
+        nbrs[start[i] + fill[i]++] = j;
+        nbrs[start[j] + fill[j]++] = i;
+    }
+
+    pattern->nblocks = malloc(num_points * sizeof(int));
+    pattern->diag = malloc(num_points * sizeof(int));
+    pattern->offdiag = malloc(2*num_connections * sizeof(int));
+    pattern->rowptrs = malloc((4*num_points + 1) * sizeof(sunindextype));
+    if (pattern->nblocks == NULL || pattern->diag == NULL ||
+            pattern->offdiag == NULL || pattern->rowptrs == NULL) {
+        goto fail;
+    }
+
+    // Sort each list and drop duplicate connections.
+    nnz = 2*num_points;
+    for (idx = 0; idx < num_points; ++idx) {
+        int *list = nbrs + start[idx];
+        int n = start[idx + 1] - start[idx];
+        int m = 0, k;
+
+        qsort(list, n, sizeof(int), compare_int);
+        for (k = 0; k < n; ++k) {
+            if (m == 0 || list[k] != list[m - 1]) {
+                list[m++] = list[k];
+            }
+        }
+        pattern->nblocks[idx] = m;
+        pattern->diag[idx] = find_int(list, m, idx);
+        nnz += 8*m;
+    }
+    for (idx = 0; idx < num_connections; ++idx) {
+        int i = p->connections[2*idx];
+        int j = p->connections[2*idx + 1];
+        pattern->offdiag[2*idx] = find_int(nbrs + start[i], pattern->nblocks[i], j);
+        pattern->offdiag[2*idx + 1] = find_int(nbrs + start[j], pattern->nblocks[j], i);
+    }
+
+    pattern->nnz = nnz;
+    pattern->colvals = malloc(nnz * sizeof(sunindextype));
+    if (pattern->colvals == NULL) {
+        goto fail;
+    }
+
+    // d(position)/dt = velocity
+    for (row = 0; row < 2*num_points; ++row) {
+        pattern->rowptrs[row] = row;
+        pattern->colvals[row] = 2*num_points + row;
+    }
+    // d(velocity)/dt depends on the positions and velocities of the
+    // point and its neighbors.
+    nnz = 2*num_points;
+    for (idx = 0; idx < num_points; ++idx) {
+        const int *list = nbrs + start[idx];
+        int m = pattern->nblocks[idx];
+        int d, k;
+
+        for (d = 0; d < 2; ++d) {
+            pattern->rowptrs[2*num_points + 2*idx + d] = nnz;
+            for (k = 0; k < m; ++k) {
+                pattern->colvals[nnz++] = 2*list[k];
+                pattern->colvals[nnz++] = 2*list[k] + 1;
+            }
+            for (k = 0; k < m; ++k) {
+                pattern->colvals[nnz++] = 2*num_points + 2*list[k];
+                pattern->colvals[nnz++] = 2*num_points + 2*list[k] + 1;
+            }
+        }
+    }
+    pattern->rowptrs[4*num_points] = nnz;
+
+    free(start);
+    free(fill);
+    free(nbrs);
+    return pattern;
+
+fail:
+    fprintf(stderr, "de_jac_pattern_create: out of memory\n");
+    free(start);
+    free(fill);
+    free(nbrs);
+    de_jac_pattern_free(pattern);
+    return NULL;
+}
+
+void de_jac_pattern_free(de_jac_pattern_t *pattern)
+{
+    if (pattern == NULL) {
+        return;
+    }
+    free(pattern->rowptrs);
+    free(pattern->colvals);
+    free(pattern->nblocks);
+    free(pattern->diag);
+    free(pattern->offdiag);
+    free(pattern);
+}
+
+//
+// Position of point j in the list of point i, or -1 if it is not there.
+// The list is the x columns of the first row of point i.
+//
+static int find_block(const de_jac_pattern_t *pattern, int i, int j)
+{
+    const sunindextype *cols;
+    int lo = 0, hi = pattern->nblocks[i] - 1;
+
+    cols = pattern->colvals + pattern->rowptrs[2*pattern->num_points + 2*i];
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (cols[2*mid] < 2*j) {
+            lo = mid + 1;
+        }
+        else if (cols[2*mid] > 2*j) {
+            hi = mid - 1;
+        }
+        else {
+            return mid;
+        }
+    }
+    return -1;
+}
+
+//
+// Record connection idx = (i, j), the one after the last; if the pattern
+// has no blocks for i and j, mark it stale.  Returns 0, or -1 if out of
+// memory.
+//
+int de_jac_pattern_connect(de_jac_pattern_t *pattern, int idx, int i, int j)
+{
+    if (idx >= pattern->capacity) {
+        int capacity = pattern->capacity < 8 ? 16 : 2*pattern->capacity;
+        int *offdiag = realloc(pattern->offdiag, 2*capacity * sizeof(int));
+
+        if (offdiag == NULL) {
+            fprintf(stderr, "de_jac_pattern_connect: out of memory\n");
+            return -1;
+        }
+        pattern->offdiag = offdiag;
+        pattern->capacity = capacity;
+    }
+    pattern->offdiag[2*idx] = find_block(pattern, i, j);
+    pattern->offdiag[2*idx + 1] = find_block(pattern, j, i);
+    if (pattern->offdiag[2*idx] < 0 || pattern->offdiag[2*idx + 1] < 0) {
+        pattern->stale = 1;
+    }
+    pattern->num_connections = idx + 1;
+    return 0;
+}
+
+//
+// Forget connection idx; the last connection takes its place.
+//
+void de_jac_pattern_disconnect(de_jac_pattern_t *pattern, int idx)
+{
+    int last = --pattern->num_connections;
+
+    pattern->offdiag[2*idx] = pattern->offdiag[2*last];
+    pattern->offdiag[2*idx + 1] = pattern->offdiag[2*last + 1];
+}
+
+//
+// Create a CSR SUNMatrix large enough to hold the given pattern.
+//
+SUNMatrix de_jac_matrix(const de_jac_pattern_t *pattern, SUNContext sunctx)
+{
+    sunindextype n = 4*pattern->num_points;
+    return SUNSparseMatrix(n, n, pattern->nnz, CSR_MAT, sunctx);
+}
+
+//
+// Add sign*B to the 2x2 block in the rows of point a at position k of
+// its neighbor list; vel selects the velocity columns.
+//
+static void add_block(sunrealtype *data, const de_jac_pattern_t *pattern,
+                      int a, int k, int vel, double B[2][2], double sign)
+{
+    int num_points = pattern->num_points;
+    sunindextype offset = 2*k + (vel ? 2*pattern->nblocks[a] : 0);
+    sunindextype r0 = pattern->rowptrs[2*num_points + 2*a] + offset;
+    sunindextype r1 = pattern->rowptrs[2*num_points + 2*a + 1] + offset;
+
+    data[r0]     += sign*B[0][0];
+    data[r0 + 1] += sign*B[0][1];
+    data[r1]     += sign*B[1][0];
+    data[r1 + 1] += sign*B[1][1];
+}
+
+//
+// The derivatives of the acceleration of point i due to the spring and
+// friction forces of the connection (i, j).  M is the derivative with
+// respect to the position of i, and -C is the derivative with respect to
+// the velocity of i.  The derivatives with respect to j are -M and C, and
+// the derivatives of the acceleration of j are the same with i and j
+// swapped.
+//
+static void edge_blocks(N_Vector w, int num_points, int i, int j,
+                        const xparams_t *p, double M[2][2], double C[2][2])
+{
+    double uvec[2], dist, relvel[2], s, pw[2];
+    double force, dforce;
+    int a, b;
+
+    uvec[0] = NV_Ith_S(w, 2*j) - NV_Ith_S(w, 2*i);
+    uvec[1] = NV_Ith_S(w, 2*j+1) - NV_Ith_S(w, 2*i+1);
+    dist = hypot(uvec[0], uvec[1]);
+    uvec[0] /= dist;
+    uvec[1] /= dist;
+
+    force = force_laws[p->force_law].force(dist, p->k, p->L);
+    dforce = force_laws[p->force_law].deriv(dist, p->k, p->L);
+
+    relvel[0] = NV_Ith_S(w, 2*num_points + 2*j) - NV_Ith_S(w, 2*num_points + 2*i);
+    relvel[1] = NV_Ith_S(w, 2*num_points + 2*j+1) - NV_Ith_S(w, 2*num_points + 2*i+1);
+    s = relvel[0]*uvec[0] + relvel[1]*uvec[1];
+    // Component of relvel perpendicular to uvec.
+    pw[0] = relvel[0] - s*uvec[0];
+    pw[1] = relvel[1] - s*uvec[1];
+
+    for (a = 0; a < 2; ++a) {
+        for (b = 0; b < 2; ++b) {
+            double uu = uvec[a]*uvec[b];
+            double perp = (a == b) - uu;
+            // Spring: d(force*uvec)/d(xj - xi)
+            double K = dforce*uu + force/dist*perp;
+            // Friction: d(s*uvec)/d(xj - xi)
+            double D = (uvec[a]*pw[b] + s*perp)/dist;
+            M[a][b] = K - p->b*D;
+            C[a][b] = p->b*uu;
+        }
+    }
+}
+
+//
+// Derivative of the acceleration -g*x/r**3 due to the central mass.
+//
+static void gravity_block(double x, double y, double g, double G[2][2])
+{
+    double r = hypot(x, y);
+    double r3 = r*r*r;
+    double xhat = x/r, yhat = y/r;
+
+    G[0][0] = -g/r3*(1 - 3*xhat*xhat);
+    G[0][1] = 3*g/r3*xhat*yhat;
+    G[1][0] = G[0][1];
+    G[1][1] = -g/r3*(1 - 3*yhat*yhat);
+}
+
+//
+// Analytic Jacobian of de(), for use with a sparse direct linear solver.
+// params must be an xparams_t whose jac_pattern has been created with
+// de_jac_pattern_create(), and J must have been created with
+// de_jac_matrix().
+//
+int de_jac(sunrealtype t, N_Vector w, N_Vector fw, SUNMatrix J, void *params,
+           N_Vector tmp1, N_Vector tmp2, N_Vector tmp3)
+{
+    xparams_t *p = params;
+    const de_jac_pattern_t *pattern = p->jac_pattern;
+    sunrealtype *data;
+    int num_points;
+    int idx;
+
+    if (pattern == NULL || SM_NNZ_S(J) < pattern->nnz || pattern->stale ||
+            pattern->num_connections != p->num_connections) {
+        fprintf(stderr, "de_jac: missing or mismatched Jacobian pattern\n");
+        return -1;
+    }
+    num_points = pattern->num_points;
+
+    memcpy(SM_INDEXPTRS_S(J), pattern->rowptrs,
+           (4*num_points + 1) * sizeof(sunindextype));
+    memcpy(SM_INDEXVALS_S(J), pattern->colvals,
+           pattern->nnz * sizeof(sunindextype));
+    data = SM_DATA_S(J);
+    memset(data, 0, pattern->nnz * sizeof(sunrealtype));
+
+    for (idx = 0; idx < 2*num_points; ++idx) {
+        data[idx] = 1.0;
+    }
+
+    for (idx = 0; idx < p->num_connections; ++idx) {
+        int i, j;
+        double M[2][2], C[2][2];
+
+        i = p->connections[2*idx];
+        j = p->connections[2*idx + 1];
+        edge_blocks(w, num_points, i, j, p, M, C);
+
+        add_block(data, pattern, i, pattern->diag[i], 0, M, 1.0);
+        add_block(data, pattern, i, pattern->offdiag[2*idx], 0, M, -1.0);
+        add_block(data, pattern, j, pattern->diag[j], 0, M, 1.0);
+        add_block(data, pattern, j, pattern->offdiag[2*idx + 1], 0, M, -1.0);
+
+        add_block(data, pattern, i, pattern->diag[i], 1, C, -1.0);
+        add_block(data, pattern, i, pattern->offdiag[2*idx], 1, C, 1.0);
+        add_block(data, pattern, j, pattern->diag[j], 1, C, -1.0);
+        add_block(data, pattern, j, pattern->offdiag[2*idx + 1], 1, C, 1.0);
+    }
+
+    if (p->g > 0) {
+        for (idx = 0; idx < num_points; ++idx) {
+            double G[2][2];
+            gravity_block(NV_Ith_S(w, 2*idx), NV_Ith_S(w, 2*idx+1), p->g, G);
+            add_block(data, pattern, idx, pattern->diag[idx], 0, G, 1.0);
+        }
+    }
+
+    return 0;
+}
+
+//
+// Jacobian-vector product Jv = J(w)*v for the vector field de(), for the
+// matrix-free linear solvers.  The connections are traversed once.
+//
+int de_jtimes(N_Vector v, N_Vector Jv, sunrealtype t, N_Vector w, N_Vector fw,
+              void *params, N_Vector tmp)
+{
+    xparams_t *p = params;
+    int num_points = p->num_points;
+    int idx;
+
+    for (idx = 0; idx < 2*num_points; ++idx) {
+        NV_Ith_S(Jv, idx) = NV_Ith_S(v, 2*num_points + idx);
+        NV_Ith_S(Jv, 2*num_points + idx) = 0.0;
+    }
+
+    for (idx = 0; idx < p->num_connections; ++idx) {
+        int i, j, ii, jj, a;
+        double M[2][2], C[2][2];
+        double dx[2], dv[2];
+
+        i = p->connections[2*idx];
+        j = p->connections[2*idx + 1];
+        edge_blocks(w, num_points, i, j, p, M, C);
+
+        ii = 2*num_points + 2*i;
+        jj = 2*num_points + 2*j;
+        dx[0] = NV_Ith_S(v, 2*j) - NV_Ith_S(v, 2*i);
+        dx[1] = NV_Ith_S(v, 2*j+1) - NV_Ith_S(v, 2*i+1);
+        dv[0] = NV_Ith_S(v, jj) - NV_Ith_S(v, ii);
+        dv[1] = NV_Ith_S(v, jj+1) - NV_Ith_S(v, ii+1);
+
+        for (a = 0; a < 2; ++a) {
+            double s = M[a][0]*dx[0] + M[a][1]*dx[1]
+                       - C[a][0]*dv[0] - C[a][1]*dv[1];
+            NV_Ith_S(Jv, ii + a) -= s;
+            NV_Ith_S(Jv, jj + a) += s;
+        }
+    }
+
+    if (p->g > 0) {
+        for (idx = 0; idx < num_points; ++idx) {
+            double G[2][2];
+            double vx = NV_Ith_S(v, 2*idx);
+            double vy = NV_Ith_S(v, 2*idx+1);
+            gravity_block(NV_Ith_S(w, 2*idx), NV_Ith_S(w, 2*idx+1), p->g, G);
+            NV_Ith_S(Jv, 2*num_points + 2*idx) += G[0][0]*vx + G[0][1]*vy;
+            NV_Ith_S(Jv, 2*num_points + 2*idx + 1) += G[1][0]*vx + G[1][1]*vy;
+        }
+    }
+
+    return 0;
+}
+
+de_prec_t *de_prec_create(int num_points)
+{
+    de_prec_t *prec;
+
+    prec = calloc(1, sizeof(de_prec_t));
+    if (prec == NULL) {
+        return NULL;
+    }
+    prec->num_points = num_points;
+    prec->A = calloc(4*num_points, sizeof(double));
+    prec->B = calloc(4*num_points, sizeof(double));
+    prec->S = calloc(4*num_points, sizeof(double));
+    if (prec->A == NULL || prec->B == NULL || prec->S == NULL) {
+        fprintf(stderr, "de_prec_create: out of memory\n");
+        de_prec_free(prec);
+        return NULL;
+    }
+    return prec;
+}
+
+void de_prec_free(de_prec_t *prec)
+{
+    if (prec == NULL) {
+        return;
+    }
+    free(prec->A);
+    free(prec->B);
+    free(prec->S);
+    free(prec);
+}
+
+//
+// Preconditioner setup.  The diagonal blocks of the Jacobian are
+// recomputed only when CVODE says the saved ones are out of date
+// (jok is false); the 2x2 Schur complements are inverted for the
+// current gamma every time.
+//
+int de_psetup(sunrealtype t, N_Vector w, N_Vector fw, sunbooleantype jok,
+              sunbooleantype *jcurPtr, sunrealtype gamma, void *params)
+{
+    xparams_t *p = params;
+    de_prec_t *prec = p->prec;
+    int num_points = p->num_points;
+    int idx;
+
+    if (prec == NULL) {
+        fprintf(stderr, "de_psetup: missing preconditioner\n");
+        return -1;
+    }
+
+    if (jok) {
+        *jcurPtr = SUNFALSE;
+    }
+    else {
+        memset(prec->A, 0, 4*num_points * sizeof(double));
+        memset(prec->B, 0, 4*num_points * sizeof(double));
+
+        for (idx = 0; idx < p->num_connections; ++idx) {
+            int i, j, a;
+            double M[2][2], C[2][2];
+
+            i = p->connections[2*idx];
+            j = p->connections[2*idx + 1];
+            edge_blocks(w, num_points, i, j, p, M, C);
+            for (a = 0; a < 4; ++a) {
+                prec->A[4*i + a] += M[a/2][a%2];
+                prec->A[4*j + a] += M[a/2][a%2];
+                prec->B[4*i + a] -= C[a/2][a%2];
+                prec->B[4*j + a] -= C[a/2][a%2];
+            }
+        }
+        if (p->g > 0) {
+            for (idx = 0; idx < num_points; ++idx) {
+                double G[2][2];
+                int a;
+                gravity_block(NV_Ith_S(w, 2*idx), NV_Ith_S(w, 2*idx+1), p->g, G);
+                for (a = 0; a < 4; ++a) {
+                    prec->A[4*idx + a] += G[a/2][a%2];
+                }
+            }
+        }
+        *jcurPtr = SUNTRUE;
+    }
+
+    for (idx = 0; idx < num_points; ++idx) {
+        double *A = prec->A + 4*idx;
+        double *B = prec->B + 4*idx;
+        double *S = prec->S + 4*idx;
+        double s00, s01, s10, s11, det;
+
+        s00 = 1 - gamma*B[0] - gamma*gamma*A[0];
+        s01 =   - gamma*B[1] - gamma*gamma*A[1];
+        s10 =   - gamma*B[2] - gamma*gamma*A[2];
+        s11 = 1 - gamma*B[3] - gamma*gamma*A[3];
+        det = s00*s11 - s01*s10;
+        if (det == 0.0) {
+            // Recoverable; CVODE will retry with a smaller step.
+            return 1;
+        }
+        S[0] =  s11/det;
+        S[1] = -s01/det;
+        S[2] = -s10/det;
+        S[3] =  s00/det;
+    }
+    prec->gamma = gamma;
+
+    return 0;
+}
+
+//
+// Solve P*z = r with the block diagonal preconditioner.  With r = (r1, r2)
+// split into position and velocity parts, the velocity part of z is
+// S*(r2 + gamma*A*r1), and the position part is r1 + gamma*z2.
+//
+int de_psolve(sunrealtype t, N_Vector w, N_Vector fw, N_Vector r, N_Vector z,
+              sunrealtype gamma, sunrealtype delta, int lr, void *params)
+{
+    xparams_t *p = params;
+    de_prec_t *prec = p->prec;
+    int num_points = p->num_points;
+    sunrealtype g = prec->gamma;
+    int idx;
+
+    for (idx = 0; idx < num_points; ++idx) {
+        const double *A = prec->A + 4*idx;
+        const double *S = prec->S + 4*idx;
+        double r1x, r1y, bx, by, z2x, z2y;
+        int ii = 2*num_points + 2*idx;
+
+        r1x = NV_Ith_S(r, 2*idx);
+        r1y = NV_Ith_S(r, 2*idx+1);
+        bx = NV_Ith_S(r, ii)   + g*(A[0]*r1x + A[1]*r1y);
+        by = NV_Ith_S(r, ii+1) + g*(A[2]*r1x + A[3]*r1y);
+        z2x = S[0]*bx + S[1]*by;
+        z2y = S[2]*bx + S[3]*by;
+
+        NV_Ith_S(z, ii)      = z2x;
+        NV_Ith_S(z, ii+1)    = z2y;
+        NV_Ith_S(z, 2*idx)   = r1x + g*z2x;
+        NV_Ith_S(z, 2*idx+1) = r1y + g*z2y;
+    }
+
+    return 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
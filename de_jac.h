@@ -0,0 +1,97 @@
+#ifndef _DE_JAC_H_
+#define _DE_JAC_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sundials/sundials_core.h>
+#include <sunmatrix/sunmatrix_sparse.h>  // access to sparse SUNMatrix
+
+#include "de.h"
+
+//
+// Sparsity pattern (CSR) of the Jacobian of de().  It is built once from
+// the connections in an xparams_t, and copied into the SUNMatrix by
+// de_jac() (the linear solver interface zeros the matrix, including its
+// index arrays, before each Jacobian evaluation).
+//
+// The rows for the positions (0 <= row < 2*num_points) have a single
+// entry, the 1 in the column of the corresponding velocity.  The two rows
+// for the velocity of point i have identical structure: the x and y
+// columns of point i and each of its neighbors (in increasing order), then
+// the u and v columns of the same points.
+//
+// When the connections change at run time (bonds.h), the pattern follows
+// them with de_jac_pattern_connect() and de_jac_pattern_disconnect(), at
+// a cost independent of the number of points.  A removed connection
+// leaves its blocks in the pattern, as structural zeros; a new one that
+// has no blocks in the pattern (its points were never connected) marks
+// the pattern stale, and it must then be created again before the next
+// de_jac().
+//
+typedef struct _de_jac_pattern {
+    int num_points;
+    int num_connections;
+    /* length of offdiag, in connections */
+    int capacity;
+    /* a connection has no blocks in the pattern */
+    int stale;
+    sunindextype nnz;
+    /* rowptrs has length 4*num_points + 1; colvals has length nnz. */
+    sunindextype *rowptrs;
+    sunindextype *colvals;
+    /*
+     * nblocks[i] is the number of points (i and its neighbors) in the
+     * rows of point i.  diag[i] is the position of point i in that list,
+     * and offdiag[2*idx] (offdiag[2*idx+1]) is the position of point j in
+     * the list of point i (point i in the list of point j), where
+     * (i, j) is connection idx.
+     */
+    int *nblocks;
+    int *diag;
+    int *offdiag;
+} de_jac_pattern_t;
+
+//
+// Block diagonal preconditioner for the matrix-free (Krylov) linear
+// solvers.  For each point i, the 4x4 diagonal block of I - gamma*J is
+//
+//     [ I          -gamma*I       ]
+//     [ -gamma*A_i  I - gamma*B_i ]
+//
+// where A_i and B_i are the derivatives of the acceleration of point i
+// with respect to its own position and velocity.  A and B hold the 2x2
+// blocks (row major) for each point; S holds the inverse of the Schur
+// complement I - gamma*B_i - gamma**2*A_i for the gamma of the last setup.
+//
+typedef struct _de_prec {
+    int num_points;
+    sunrealtype gamma;
+    double *A;
+    double *B;
+    double *S;
+} de_prec_t;
+
+de_jac_pattern_t *de_jac_pattern_create(const xparams_t *p);
+void de_jac_pattern_free(de_jac_pattern_t *pattern);
+int de_jac_pattern_connect(de_jac_pattern_t *pattern, int idx, int i, int j);
+void de_jac_pattern_disconnect(de_jac_pattern_t *pattern, int idx);
+SUNMatrix de_jac_matrix(const de_jac_pattern_t *pattern, SUNContext sunctx);
+int de_jac(sunrealtype t, N_Vector w, N_Vector fw, SUNMatrix J, void *params,
+           N_Vector tmp1, N_Vector tmp2, N_Vector tmp3);
+
+int de_jtimes(N_Vector v, N_Vector Jv, sunrealtype t, N_Vector w, N_Vector fw,
+              void *params, N_Vector tmp);
+de_prec_t *de_prec_create(int num_points);
+void de_prec_free(de_prec_t *prec);
+int de_psetup(sunrealtype t, N_Vector w, N_Vector fw, sunbooleantype jok,
+              sunbooleantype *jcurPtr, sunrealtype gamma, void *params);
+int de_psolve(sunrealtype t, N_Vector w, N_Vector fw, N_Vector r, N_Vector z,
+              sunrealtype gamma, sunrealtype delta, int lr, void *params);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
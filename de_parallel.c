@@ -0,0 +1,338 @@
+#include <sundials/sundials_core.h> // Provides core SUNDIALS types
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "de.h"
+#include "bh.h"
+#include "de_parallel.h"
+#include "force_law.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// Greedy edge coloring: each connection gets the smallest color not
+// already used by a connection at either of its points.  This uses at
+// most 2*d - 1 colors, where d is the maximum number of connections at
+// a point.
+//
+de_schedule_t *de_schedule_create(const xparams_t *p)
+{
+    de_schedule_t *schedule;
+    int num_points = p->num_points;
+    int num_connections = p->num_connections;
+    int *start, *fill, *incident, *color, *mark;
+    int idx, c;
+
+    schedule = calloc(1, sizeof(de_schedule_t));
+    start = calloc(num_points + 1, sizeof(int));
+    fill = calloc(num_points, sizeof(int));
+    incident = malloc(2*num_connections * sizeof(int));
+    color = malloc(num_connections * sizeof(int));
+    // There are at most 2*num_connections colors, so mark (indexed by
+    // color) can't overflow.
+    mark = malloc((2*num_connections + 1) * sizeof(int));
+    if (schedule == NULL || start == NULL || fill == NULL || incident == NULL
+            || color == NULL || mark == NULL) {
+        goto fail;
+    }
+
+    // Connections incident on each point.
+    for (idx = 0; idx < num_connections; ++idx) {
+        ++start[p->connections[2*idx] + 1];
+        ++start[p->connections[2*idx + 1] + 1];
+    }
+    for (idx = 0; idx < num_points; ++idx) {
+        start[idx + 1] += start[idx];
+    }
+    for (idx = 0; idx < num_connections; ++idx) {
+        int i = p->connections[2*idx];
+        int j = p->connections[2*idx + 1];
+        incident[start[i] + fill[i]++] = idx;
+        incident[start[j] + fill[j]++] = idx;
+    }
+
+    for (idx = 0; idx < 2*num_connections + 1; ++idx) {
+        mark[idx] = -1;
+    }
+    schedule->num_colors = 0;
+    for (idx = 0; idx < num_connections; ++idx) {
+        int ends[2], e, k;
+
+        ends[0] = p->connections[2*idx];
+        ends[1] = p->connections[2*idx + 1];
+        for (e = 0; e < 2; ++e) {
+            for (k = start[ends[e]]; k < start[ends[e] + 1]; ++k) {
+                // Only connections before idx have been colored.
+                if (incident[k] < idx) {
+                    mark[color[incident[k]]] = idx;
+                }
+            }
+        }
+        for (c = 0; mark[c] == idx; ++c) {
+        }
+        color[idx] = c;
+        if (c + 1 > schedule->num_colors) {
+            schedule->num_colors = c + 1;
+        }
+    }
+
+    // Counting sort of the connections by color.  Within a color the
+    // original order is kept.
+    schedule->color_start = calloc(schedule->num_colors + 1, sizeof(int));
+    schedule->edges = malloc(num_connections * sizeof(int));
+    schedule->slot = malloc(num_connections * sizeof(int));
+    if (schedule->color_start == NULL || schedule->edges == NULL ||
+            schedule->slot == NULL) {
+        goto fail;
+    }
+    schedule->capacity = num_connections;
+    schedule->color_capacity = schedule->num_colors + 1;
+    for (idx = 0; idx < num_connections; ++idx) {
+        ++schedule->color_start[color[idx] + 1];
+    }
+    for (c = 0; c < schedule->num_colors; ++c) {
+        schedule->color_start[c + 1] += schedule->color_start[c];
+        mark[c] = 0;
+    }
+    for (idx = 0; idx < num_connections; ++idx) {
+        c = color[idx];
+        schedule->slot[idx] = schedule->color_start[c] + mark[c]++;
+        schedule->edges[schedule->slot[idx]] = idx;
+    }
+    // (The schedule keeps the colors.)
+    schedule->color = color;
+
+    free(start);
+    free(fill);
+    free(incident);
+    free(mark);
+    return schedule;
+
+fail:
+    fprintf(stderr, "de_schedule_create: out of memory\n");
+    free(start);
+    free(fill);
+    free(incident);
+    free(color);
+    free(mark);
+    de_schedule_free(schedule);
+    return NULL;
+}
+
+void de_schedule_free(de_schedule_t *schedule)
+{
+    if (schedule == NULL) {
+        return;
+    }
+    free(schedule->color_start);
+    free(schedule->edges);
+    free(schedule->color);
+    free(schedule->slot);
+    free(schedule);
+}
+
+//
+// Add connection idx, the one after the last, with the given color: an
+// existing one, or num_colors for a new one.  The caller chooses a color
+// that no other connection at its points has.  Returns 0, or -1 if out
+// of memory.
+//
+int de_schedule_add(de_schedule_t *schedule, int idx, int color)
+{
+    int hole, c;
+
+    if (idx >= schedule->capacity) {
+        int capacity = schedule->capacity < 8 ? 16 : 2*schedule->capacity;
+        int *a;
+
+        // (Each array that has grown is kept, so a failure loses nothing.)
+        if ((a = realloc(schedule->edges, capacity * sizeof(int))) == NULL) {
+            goto fail;
+        }
+        schedule->edges = a;
+        if ((a = realloc(schedule->color, capacity * sizeof(int))) == NULL) {
+            goto fail;
+        }
+        schedule->color = a;
+        if ((a = realloc(schedule->slot, capacity * sizeof(int))) == NULL) {
+            goto fail;
+        }
+        schedule->slot = a;
+        schedule->capacity = capacity;
+    }
+    if (color == schedule->num_colors) {
+        if (color + 2 > schedule->color_capacity) {
+            int *color_start = realloc(schedule->color_start,
+                                       2*schedule->color_capacity * sizeof(int));
+            if (color_start == NULL) {
+                goto fail;
+            }
+            schedule->color_start = color_start;
+            schedule->color_capacity *= 2;
+        }
+        schedule->color_start[color + 1] = schedule->color_start[color];
+        ++schedule->num_colors;
+    }
+
+    // The hole at the end moves down to the end of the color: the first
+    // connection of each later color moves to the end of that color.
+    hole = schedule->color_start[schedule->num_colors]++;
+    for (c = schedule->num_colors - 1; c > color; --c) {
+        int first = schedule->color_start[c]++;
+
+        // (An empty color has no first connection.)
+        if (first != hole) {
+            schedule->edges[hole] = schedule->edges[first];
+            schedule->slot[schedule->edges[hole]] = hole;
+            hole = first;
+        }
+    }
+    schedule->edges[hole] = idx;
+    schedule->slot[idx] = hole;
+    schedule->color[idx] = color;
+    return 0;
+
+fail:
+    fprintf(stderr, "de_schedule_add: out of memory\n");
+    return -1;
+}
+
+//
+// Remove connection idx; the last connection takes its place.
+//
+void de_schedule_remove(de_schedule_t *schedule, int idx)
+{
+    int last = schedule->color_start[schedule->num_colors] - 1;
+    int hole = schedule->slot[idx];
+    int c;
+
+    // The hole moves up to the end: the last connection of each color,
+    // from that of idx on, moves into it.
+    for (c = schedule->color[idx]; c < schedule->num_colors; ++c) {
+        int end = --schedule->color_start[c + 1];
+
+        // (An empty color has no last connection.)
+        if (end != hole) {
+            schedule->edges[hole] = schedule->edges[end];
+            schedule->slot[schedule->edges[hole]] = hole;
+            hole = end;
+        }
+    }
+    if (last != idx) {
+        schedule->slot[idx] = schedule->slot[last];
+        schedule->color[idx] = schedule->color[last];
+        schedule->edges[schedule->slot[idx]] = idx;
+    }
+    while (schedule->num_colors > 0 &&
+           schedule->color_start[schedule->num_colors - 1] ==
+           schedule->color_start[schedule->num_colors]) {
+        --schedule->num_colors;
+    }
+}
+
+//
+// The same vector field as de(), computed with OpenMP threads.  params
+// must be an xparams_t whose schedule has been created with
+// de_schedule_create().
+//
+// The result does not depend on the number of threads, but it is not
+// bitwise identical to de(), because the contributions to each point are
+// summed in a different order.
+//
+int de_parallel(sunrealtype t, N_Vector w, N_Vector f, void *params)
+{
+    xparams_t *p = params;
+    const de_schedule_t *schedule = p->schedule;
+    const sunrealtype *wd = N_VGetArrayPointer(w);
+    sunrealtype *fd = N_VGetArrayPointer(f);
+    int num_points = p->num_points;
+    const int *connections = p->connections;
+    double k = p->k, L = p->L, b = p->b, g = p->g;
+    force_fn spring = force_laws[p->force_law].force;
+
+    if (schedule == NULL) {
+        fprintf(stderr, "de_parallel: missing schedule\n");
+        return -1;
+    }
+
+    #pragma omp parallel
+    {
+        int idx, c;
+
+        #pragma omp for schedule(static)
+        for (idx = 0; idx < num_points; ++idx) {
+            fd[2*idx] = wd[2*num_points + 2*idx];
+            fd[2*idx+1] = wd[2*num_points + 2*idx + 1];
+            fd[2*num_points + 2*idx] = 0.0;
+            fd[2*num_points + 2*idx + 1] = 0.0;
+        }
+
+        // The implicit barrier at the end of each loop separates
+        // the colors.
+        for (c = 0; c < schedule->num_colors; ++c) {
+            #pragma omp for schedule(static)
+            for (idx = schedule->color_start[c]; idx < schedule->color_start[c+1]; ++idx) {
+                int e, i, j, ii, jj;
+                double uvec[2], dist, fvec[2];
+                double relvel[2], s;
+                double force;
+
+                e = schedule->edges[idx];
+                i = connections[2*e];
+                j = connections[2*e + 1];
+
+                uvec[0] = wd[2*j] - wd[2*i];
+                uvec[1] = wd[2*j+1] - wd[2*i+1];
+                dist = hypot(uvec[0], uvec[1]);
+                uvec[0] /= dist;
+                uvec[1] /= dist;
+
+                ii = 2*num_points + 2*i;
+                jj = 2*num_points + 2*j;
+
+                // Spring force minus friction force, acting on j.
+                force = spring(dist, k, L);
+                relvel[0] = wd[jj] - wd[ii];
+                relvel[1] = wd[jj+1] - wd[ii+1];
+                s = relvel[0]*uvec[0] + relvel[1]*uvec[1];
+                force -= b * s;
+                fvec[0] = force*uvec[0];
+                fvec[1] = force*uvec[1];
+
+                fd[ii]   -= fvec[0];
+                fd[ii+1] -= fvec[1];
+                fd[jj]   += fvec[0];
+                fd[jj+1] += fvec[1];
+            }
+        }
+
+        if (g > 0) {
+            #pragma omp for schedule(static)
+            for (idx = 0; idx < num_points; ++idx) {
+                double xi = wd[2*idx];
+                double yi = wd[2*idx+1];
+                double r = hypot(xi, yi);
+                double r3 = r*r*r;
+                fd[2*num_points + 2*idx] += -g * xi / r3;
+                fd[2*num_points + 2*idx + 1] += -g * yi / r3;
+            }
+        }
+    }
+
+    if (p->bh != NULL) {
+        // Mutual gravity between the points.  (bh_accel() has its own
+        // parallel loop.)
+        if (bh_gravity(p->bh, num_points, wd, fd + 2*num_points) != 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,48 @@
+#ifndef _DE_PARALLEL_H_
+#define _DE_PARALLEL_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sundials/sundials_core.h>
+
+#include "de.h"
+
+//
+// Conflict-free schedule of the connections for the threaded right-hand
+// side.  The connections are colored so that no two connections with the
+// same color share a point; the connections of color c are
+// edges[color_start[c]:color_start[c+1]].  Within a color the threads
+// update disjoint points, so no atomics are needed, and every point
+// receives its contributions in color order, independent of the number
+// of threads.
+//
+// de_schedule_add() and de_schedule_remove() follow the changes of the
+// connections at run time (bonds.h); each moves at most one connection
+// per color, so the cost is independent of the number of connections.
+// The colors are then no longer the greedy ones, but remain conflict-free.
+//
+typedef struct _de_schedule {
+    int num_colors;
+    int *color_start;
+    int *edges;
+    /* color of each connection, and its position in edges */
+    int *color;
+    int *slot;
+    /* lengths of edges, color and slot, and of color_start */
+    int capacity;
+    int color_capacity;
+} de_schedule_t;
+
+de_schedule_t *de_schedule_create(const xparams_t *p);
+void de_schedule_free(de_schedule_t *schedule);
+int de_schedule_add(de_schedule_t *schedule, int idx, int color);
+void de_schedule_remove(de_schedule_t *schedule, int idx);
+int de_parallel(sunrealtype t, N_Vector w, N_Vector f, void *params);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,413 @@
+#include <sundials/sundials_core.h> // Provides core SUNDIALS types
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "de.h"
+#include "bh.h"
+#include "de_simd.h"
+#include "force_law.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+//
+// Number of Newton iterations y <- y*(1.5 - 0.5*d2*y*y) applied to the
+// hardware estimate of 1/sqrt(d2).  Each iteration roughly squares the
+// relative error:  _mm_rsqrt_ps (used for AVX2, in single precision) is
+// good to about 3.7e-4, so three iterations reach double precision
+// round-off; _mm512_rsqrt14_pd is good to 6.1e-5, so two are enough.
+// Fewer iterations trade accuracy for speed.
+//
+#ifndef NEWTON_ITERS_AVX2
+#define NEWTON_ITERS_AVX2 3
+#endif
+#ifndef NEWTON_ITERS_AVX512
+#define NEWTON_ITERS_AVX512 2
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+edge_soa_t *edge_soa_create(const xparams_t *p)
+{
+    edge_soa_t *edges;
+    int n = p->num_connections;
+    int idx;
+
+    if (p->force_law != FORCE_CUBIC) {
+        fprintf(stderr, "edge_soa_create: only the cubic force law is vectorized\n");
+        return NULL;
+    }
+    edges = calloc(1, sizeof(edge_soa_t));
+    if (edges == NULL) {
+        goto fail;
+    }
+    edges->variant = simd_best_variant();
+    edges->num_connections = n;
+    edges->capacity = n;
+    edges->i = malloc(n * sizeof(int));
+    edges->j = malloc(n * sizeof(int));
+    edges->k = malloc(n * sizeof(double));
+    edges->kL3 = malloc(n * sizeof(double));
+    edges->b = malloc(n * sizeof(double));
+    if (edges->i == NULL || edges->j == NULL || edges->k == NULL ||
+            edges->kL3 == NULL || edges->b == NULL) {
+        goto fail;
+    }
+    for (idx = 0; idx < n; ++idx) {
+        edges->i[idx] = p->connections[2*idx];
+        edges->j[idx] = p->connections[2*idx + 1];
+        edges->k[idx] = p->k;
+        edges->kL3[idx] = p->k * p->L * p->L * p->L;
+        edges->b[idx] = p->b;
+    }
+    return edges;
+
+fail:
+    fprintf(stderr, "edge_soa_create: out of memory\n");
+    edge_soa_free(edges);
+    return NULL;
+}
+
+void edge_soa_free(edge_soa_t *edges)
+{
+    if (edges == NULL) {
+        return;
+    }
+    free(edges->i);
+    free(edges->j);
+    free(edges->k);
+    free(edges->kL3);
+    free(edges->b);
+    free(edges);
+}
+
+//
+// Append the connection (i, j) of the springs of p.  Returns 0, or -1 if
+// out of memory.
+//
+int edge_soa_append(edge_soa_t *edges, const xparams_t *p, int i, int j)
+{
+    int n = edges->num_connections;
+
+    if (n >= edges->capacity) {
+        int capacity = edges->capacity < 8 ? 16 : 2*edges->capacity;
+        void *a;
+
+        // (Each array that has grown is kept, so a failure loses nothing.)
+        if ((a = realloc(edges->i, capacity * sizeof(int))) == NULL) {
+            goto fail;
+        }
+        edges->i = a;
+        if ((a = realloc(edges->j, capacity * sizeof(int))) == NULL) {
+            goto fail;
+        }
+        edges->j = a;
+        if ((a = realloc(edges->k, capacity * sizeof(double))) == NULL) {
+            goto fail;
+        }
+        edges->k = a;
+        if ((a = realloc(edges->kL3, capacity * sizeof(double))) == NULL) {
+            goto fail;
+        }
+        edges->kL3 = a;
+        if ((a = realloc(edges->b, capacity * sizeof(double))) == NULL) {
+            goto fail;
+        }
+        edges->b = a;
+        edges->capacity = capacity;
+    }
+    edges->i[n] = i;
+    edges->j[n] = j;
+    edges->k[n] = p->k;
+    edges->kL3[n] = p->k * p->L * p->L * p->L;
+    edges->b[n] = p->b;
+    edges->num_connections = n + 1;
+    return 0;
+
+fail:
+    fprintf(stderr, "edge_soa_append: out of memory\n");
+    return -1;
+}
+
+//
+// Remove connection idx; the last connection takes its place.
+//
+void edge_soa_remove(edge_soa_t *edges, int idx)
+{
+    int last = --edges->num_connections;
+
+    edges->i[idx] = edges->i[last];
+    edges->j[idx] = edges->j[last];
+    edges->k[idx] = edges->k[last];
+    edges->kL3[idx] = edges->kL3[last];
+    edges->b[idx] = edges->b[last];
+}
+
+//
+// Spring and friction forces of connections start, ..., end-1, added to
+// the accelerations in f.  This is also the tail loop of the vectorized
+// kernels.
+//
+static void springs_scalar(const edge_soa_t *edges, int start, int end,
+                           int num_points, const sunrealtype *w, sunrealtype *f)
+{
+    const sunrealtype *vel = w + 2*num_points;
+    sunrealtype *acc = f + 2*num_points;
+    int idx;
+
+    for (idx = start; idx < end; ++idx) {
+        int i = edges->i[idx];
+        int j = edges->j[idx];
+        double dx, dy, d2, rinv, r, s, force, c;
+
+        dx = w[2*j] - w[2*i];
+        dy = w[2*j+1] - w[2*i+1];
+        d2 = dx*dx + dy*dy;
+        rinv = 1.0/sqrt(d2);
+        r = d2*rinv;
+        // s is the rate of change of the distance between i and j.
+        s = ((vel[2*j] - vel[2*i])*dx + (vel[2*j+1] - vel[2*i+1])*dy)*rinv;
+        // Spring force minus friction force, acting on j.
+        force = edges->kL3[idx]*rinv*rinv - edges->k[idx]*r - edges->b[idx]*s;
+        c = force*rinv;
+        acc[2*i]   -= c*dx;
+        acc[2*i+1] -= c*dy;
+        acc[2*j]   += c*dx;
+        acc[2*j+1] += c*dy;
+    }
+}
+
+#ifdef HAVE_X86_SIMD
+
+//
+// Four connections per iteration.  The positions and velocities are
+// gathered; the results are scattered with scalar stores, because the
+// connections in one vector may share a point.
+//
+__attribute__((target("avx2,fma")))
+static void springs_avx2(const edge_soa_t *edges, int num_points,
+                         const sunrealtype *w, sunrealtype *f)
+{
+    const sunrealtype *vel = w + 2*num_points;
+    sunrealtype *acc = f + 2*num_points;
+    int n = edges->num_connections;
+    int idx, m, it;
+    const __m256d half = _mm256_set1_pd(0.5);
+    const __m256d three_halves = _mm256_set1_pd(1.5);
+    double fx[4], fy[4];
+
+    for (idx = 0; idx + 4 <= n; idx += 4) {
+        __m128i i2 = _mm_loadu_si128((const __m128i *) (edges->i + idx));
+        __m128i j2 = _mm_loadu_si128((const __m128i *) (edges->j + idx));
+        __m256d dx, dy, du, dv, d2, hd2, y, r, s, force, c;
+
+        i2 = _mm_add_epi32(i2, i2);
+        j2 = _mm_add_epi32(j2, j2);
+        dx = _mm256_sub_pd(_mm256_i32gather_pd(w, j2, 8),
+                           _mm256_i32gather_pd(w, i2, 8));
+        dy = _mm256_sub_pd(_mm256_i32gather_pd(w + 1, j2, 8),
+                           _mm256_i32gather_pd(w + 1, i2, 8));
+        du = _mm256_sub_pd(_mm256_i32gather_pd(vel, j2, 8),
+                           _mm256_i32gather_pd(vel, i2, 8));
+        dv = _mm256_sub_pd(_mm256_i32gather_pd(vel + 1, j2, 8),
+                           _mm256_i32gather_pd(vel + 1, i2, 8));
+
+        d2 = _mm256_fmadd_pd(dx, dx, _mm256_mul_pd(dy, dy));
+        // 1/sqrt(d2): single precision estimate, refined in double.
+        y = _mm256_cvtps_pd(_mm_rsqrt_ps(_mm256_cvtpd_ps(d2)));
+        hd2 = _mm256_mul_pd(half, d2);
+        for (it = 0; it < NEWTON_ITERS_AVX2; ++it) {
+            y = _mm256_mul_pd(y, _mm256_fnmadd_pd(hd2, _mm256_mul_pd(y, y),
+                                                  three_halves));
+        }
+        r = _mm256_mul_pd(d2, y);
+        s = _mm256_mul_pd(_mm256_fmadd_pd(du, dx, _mm256_mul_pd(dv, dy)), y);
+
+        force = _mm256_mul_pd(_mm256_loadu_pd(edges->kL3 + idx), _mm256_mul_pd(y, y));
+        force = _mm256_fnmadd_pd(_mm256_loadu_pd(edges->k + idx), r, force);
+        force = _mm256_fnmadd_pd(_mm256_loadu_pd(edges->b + idx), s, force);
+        c = _mm256_mul_pd(force, y);
+        _mm256_storeu_pd(fx, _mm256_mul_pd(c, dx));
+        _mm256_storeu_pd(fy, _mm256_mul_pd(c, dy));
+
+        for (m = 0; m < 4; ++m) {
+            int i = edges->i[idx + m];
+            int j = edges->j[idx + m];
+            acc[2*i]   -= fx[m];
+            acc[2*i+1] -= fy[m];
+            acc[2*j]   += fx[m];
+            acc[2*j+1] += fy[m];
+        }
+    }
+    springs_scalar(edges, idx, n, num_points, w, f);
+}
+
+//
+// Eight connections per iteration; otherwise the same as springs_avx2().
+//
+__attribute__((target("avx512f")))
+static void springs_avx512(const edge_soa_t *edges, int num_points,
+                           const sunrealtype *w, sunrealtype *f)
+{
+    const sunrealtype *vel = w + 2*num_points;
+    sunrealtype *acc = f + 2*num_points;
+    int n = edges->num_connections;
+    int idx, m, it;
+    const __m512d half = _mm512_set1_pd(0.5);
+    const __m512d three_halves = _mm512_set1_pd(1.5);
+    double fx[8], fy[8];
+
+    for (idx = 0; idx + 8 <= n; idx += 8) {
+        __m256i i2 = _mm256_loadu_si256((const __m256i *) (edges->i + idx));
+        __m256i j2 = _mm256_loadu_si256((const __m256i *) (edges->j + idx));
+        __m512d dx, dy, du, dv, d2, hd2, y, r, s, force, c;
+
+        i2 = _mm256_add_epi32(i2, i2);
+        j2 = _mm256_add_epi32(j2, j2);
+        dx = _mm512_sub_pd(_mm512_i32gather_pd(j2, w, 8),
+                           _mm512_i32gather_pd(i2, w, 8));
+        dy = _mm512_sub_pd(_mm512_i32gather_pd(j2, w + 1, 8),
+                           _mm512_i32gather_pd(i2, w + 1, 8));
+        du = _mm512_sub_pd(_mm512_i32gather_pd(j2, vel, 8),
+                           _mm512_i32gather_pd(i2, vel, 8));
+        dv = _mm512_sub_pd(_mm512_i32gather_pd(j2, vel + 1, 8),
+                           _mm512_i32gather_pd(i2, vel + 1, 8));
+
+        d2 = _mm512_fmadd_pd(dx, dx, _mm512_mul_pd(dy, dy));
+        y = _mm512_rsqrt14_pd(d2);
+        hd2 = _mm512_mul_pd(half, d2);
+        for (it = 0; it < NEWTON_ITERS_AVX512; ++it) {
+            y = _mm512_mul_pd(y, _mm512_fnmadd_pd(hd2, _mm512_mul_pd(y, y),
+                                                  three_halves));
+        }
+        r = _mm512_mul_pd(d2, y);
+        s = _mm512_mul_pd(_mm512_fmadd_pd(du, dx, _mm512_mul_pd(dv, dy)), y);
+
+        force = _mm512_mul_pd(_mm512_loadu_pd(edges->kL3 + idx), _mm512_mul_pd(y, y));
+        force = _mm512_fnmadd_pd(_mm512_loadu_pd(edges->k + idx), r, force);
+        force = _mm512_fnmadd_pd(_mm512_loadu_pd(edges->b + idx), s, force);
+        c = _mm512_mul_pd(force, y);
+        _mm512_storeu_pd(fx, _mm512_mul_pd(c, dx));
+        _mm512_storeu_pd(fy, _mm512_mul_pd(c, dy));
+
+        for (m = 0; m < 8; ++m) {
+            int i = edges->i[idx + m];
+            int j = edges->j[idx + m];
+            acc[2*i]   -= fx[m];
+            acc[2*i+1] -= fy[m];
+            acc[2*j]   += fx[m];
+            acc[2*j+1] += fy[m];
+        }
+    }
+    springs_scalar(edges, idx, n, num_points, w, f);
+}
+
+#endif
+
+//
+// The best kernel variant supported by the CPU we are running on.
+//
+int simd_best_variant(void)
+{
+#ifdef HAVE_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return SIMD_AVX512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return SIMD_AVX2;
+    }
+#endif
+    return SIMD_SCALAR;
+}
+
+const char *simd_variant_name(int variant)
+{
+    switch (variant) {
+        case SIMD_AVX512:
+            return "avx512";
+        case SIMD_AVX2:
+            return "avx2";
+        default:
+            return "scalar";
+    }
+}
+
+//
+// Add the spring and friction forces of all the connections to the
+// accelerations in f, using the given kernel variant.  The caller must
+// make sure the CPU supports it (see simd_best_variant()).
+//
+void de_springs(int variant, const edge_soa_t *edges, int num_points,
+                const sunrealtype *w, sunrealtype *f)
+{
+#ifdef HAVE_X86_SIMD
+    if (variant == SIMD_AVX512) {
+        springs_avx512(edges, num_points, w, f);
+        return;
+    }
+    if (variant == SIMD_AVX2) {
+        springs_avx2(edges, num_points, w, f);
+        return;
+    }
+#endif
+    springs_scalar(edges, 0, edges->num_connections, num_points, w, f);
+}
+
+//
+// The same vector field as de(), with the connections processed by the
+// vectorized kernel.  params must be an xparams_t whose edges have been
+// created with edge_soa_create(), which chooses the kernel variant (so
+// the threads of an ensemble share nothing here).
+//
+int de_simd(sunrealtype t, N_Vector w, N_Vector f, void *params)
+{
+    xparams_t *p = params;
+    const sunrealtype *wd = N_VGetArrayPointer(w);
+    sunrealtype *fd = N_VGetArrayPointer(f);
+    int num_points = p->num_points;
+    int idx;
+
+    if (p->edges == NULL) {
+        fprintf(stderr, "de_simd: missing edges\n");
+        return -1;
+    }
+
+    for (idx = 0; idx < num_points; ++idx) {
+        fd[2*idx] = wd[2*num_points + 2*idx];
+        fd[2*idx+1] = wd[2*num_points + 2*idx + 1];
+        fd[2*num_points + 2*idx] = 0.0;
+        fd[2*num_points + 2*idx + 1] = 0.0;
+    }
+
+    de_springs(p->edges->variant, p->edges, num_points, wd, fd);
+
+    if (p->g > 0) {
+        for (idx = 0; idx < num_points; ++idx) {
+            double xi = wd[2*idx];
+            double yi = wd[2*idx+1];
+            double r = hypot(xi, yi);
+            double r3 = r*r*r;
+            fd[2*num_points + 2*idx] += -p->g * xi / r3;
+            fd[2*num_points + 2*idx + 1] += -p->g * yi / r3;
+        }
+    }
+
+    if (p->bh != NULL) {
+        // Mutual gravity between the points.
+        if (bh_gravity(p->bh, num_points, wd, fd + 2*num_points) != 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
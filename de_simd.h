@@ -0,0 +1,60 @@
+#ifndef _DE_SIMD_H_
+#define _DE_SIMD_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sundials/sundials_core.h>
+
+#include "de.h"
+
+//
+// Structure-of-arrays copy of the connections, with the per-connection
+// constants of spring_force() precomputed.  With rho = L/r,
+//
+//     spring_force(r, k, L) = -k*r + k*L**3/r**2,
+//
+// so the spring and friction forces need only 1/r, which the vectorized
+// kernels compute with rsqrt plus Newton iterations (no sqrt or
+// division).
+//
+// edge_soa_append() and edge_soa_remove() follow the changes of the
+// connections at run time (bonds.h), one connection at a time.
+//
+typedef struct _edge_soa {
+    /* kernel variant of de_simd(), chosen by edge_soa_create() */
+    int variant;
+    int num_connections;
+    /* length of the arrays */
+    int capacity;
+    int *i;
+    int *j;
+    double *k;     /* spring constant */
+    double *kL3;   /* k*L**3 */
+    double *b;     /* friction coefficient */
+} edge_soa_t;
+
+//
+// Kernel variants, in increasing order of preference.
+//
+#define SIMD_SCALAR 0
+#define SIMD_AVX2   1
+#define SIMD_AVX512 2
+
+edge_soa_t *edge_soa_create(const xparams_t *p);
+void edge_soa_free(edge_soa_t *edges);
+int edge_soa_append(edge_soa_t *edges, const xparams_t *p, int i, int j);
+void edge_soa_remove(edge_soa_t *edges, int idx);
+
+int simd_best_variant(void);
+const char *simd_variant_name(int variant);
+void de_springs(int variant, const edge_soa_t *edges, int num_points,
+                const sunrealtype *w, sunrealtype *f);
+int de_simd(sunrealtype t, N_Vector w, N_Vector f, void *params);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,25 +1,241 @@
+#include <signal.h>
 #include <stdio.h>
-#include <cvode/cvode.h>
-#include <nvector/nvector_serial.h>
-#include <cvode/cvode_dense.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sundials/sundials_core.h>     // Provides core SUNDIALS types
+#include <cvode/cvode.h>                // CVODE provides linear multistep methods
+#include <nvector/nvector_serial.h>     // access to serial N_Vector
+#include <arkode/arkode.h>              // ARKODE, for --multirate
 
+#include "bonds.h"
+#include "checkpoint.h"
+#include "contact.h"
 #include "de.h"
+#include "force_law.h"
+#include "multirate.h"
+#include "solver.h"
+#include "stats.h"
+#include "symplectic.h"
+#include "traj.h"
+
+//
+// Three point masses connected by springs, orbiting a central mass.  The
+// solution is printed to stdout every dt.
+//
+// usage: demain [--bdf | --imex] [--dense] [--symplectic method [--step h]]
+//               [--multirate [--slow-step hs]] [--force-law law]
+//               [--break strain] [--form d]
+//               [--dt dt] [--stats file] [--out file.npy [--float32]]
+//               [--checkpoint file [--checkpoint-interval s] [--resume]]
+//
+// --imex integrates with ARKODE's IMEX method instead of CVODE's Adams
+// (--bdf: BDF) method, with the springs implicit and the gravity
+// explicit (SOLVER_IMEX in solver.h).  Of the statistics, it only has
+// the summary at the end.
+//
+// --dt sets the output interval (default 0.25).  With --dense the solution
+// at the output times is interpolated from the integrator's own steps
+// (solver_dense()) rather than requested with CVode(..., CV_NORMAL).
+//
+// --symplectic integrates with a fixed step symplectic method (verlet,
+// yoshida4 or yoshida6; see symplectic.h) of step size h (default 0.01)
+// instead of CVODE.  --stats does not apply to it.
+//
+// --multirate integrates with ARKODE's MRIStep instead (see multirate.h):
+// the gravity with fixed slow steps of size hs (default 0.1), the springs
+// with adaptive fast steps.  --stats does not apply to it either.
+//
+// --force-law selects the force law of the springs: cubic (the default),
+// hooke, lj or bilinear (see force_law.h).
+//
+// --break lets each spring break when its strain |r - L|/L reaches strain,
+// and --form lets a spring form between two points that are not connected
+// when they come within d of each other (see bonds.h).  The integration
+// stops at each such event, at which the solution is output as well, and
+// restarts with the new springs.  Neither applies to --symplectic or
+// --multirate.
+//
+// --out writes the solution to a binary trajectory file (see traj.h)
+// instead of stdout, as float64 or, with --float32, float32.
+//
+// --checkpoint takes a checkpoint of the integration (see checkpoint.h)
+// every s seconds of wall time (--checkpoint-interval, default 60) to
+// file.0 and file.1, at an output time, and at the end.  SIGTERM or SIGINT
+// then stops the integration at the next output time, with a last
+// checkpoint.  --resume continues from the newest valid checkpoint, with
+// its parameters and springs (the other options should be those of the
+// run that took it); the trajectory file of --out is continued after the
+// time of the checkpoint (it is flushed before each checkpoint, so it has
+// all the frames up to it).  If there is no checkpoint yet, it starts at
+// t = 0.
+//
+// --stats writes the solver statistics of each output interval to file
+// (JSON if its name ends with ".json", CSV otherwise).  A summary is
+// printed to stderr at the end.
+//
+// (This program used to integrate de3(), which is no longer maintained;
+// it now integrates the same system with de().)
+//
+
+// Set by SIGTERM and SIGINT, with --checkpoint.
+static volatile sig_atomic_t stop_requested = 0;
+
+static void request_stop(int sig)
+{
+    (void) sig;
+    stop_requested = 1;
+}
+
+//
+// Write the solution at time t to traj, or print it if traj is NULL.
+//
+static int output(traj_t *traj, sunrealtype t, N_Vector w)
+{
+    int j;
+
+    if (traj != NULL) {
+        return traj_write(traj, t, N_VGetArrayPointer(w));
+    }
+    printf("%.8e", t);
+    for (j = 0; j < 12; ++j) {
+        printf(" %.8e", NV_Ith_S(w, j));
+    }
+    printf("\n");
+    return 0;
+}
 
 int main(int argc, char *argv[])
 {
     int flag;
+    int retval;
     int j;
+    int method = SOLVER_ADAMS;
+    int dense = 0;
+    int symplectic = -1;
+    double h = 0.01;
+    int multirate = 0;
+    double hs = 0.1;
+    int force_law = FORCE_CUBIC;
+    double break_strain = 0.0;
+    double form = 0.0;
+    bonds_t *bonds = NULL;
+    sunrealtype dt = SUN_RCONST(0.25);
+    const sunrealtype rtol = SUN_RCONST(1e-10), atol = SUN_RCONST(1e-12);
+    const char *stats_file = NULL;
+    const char *out_file = NULL;
+    int dtype = TRAJ_FLOAT64;
+    traj_t *traj = NULL;
+    const char *checkpoint_file = NULL;
+    double checkpoint_interval = 60.0;
+    int resume = 0;
+    checkpoint_t *checkpoint = NULL;
+    checkpoint_data_t *resumed = NULL;
+    time_t last_checkpoint;
+    SUNContext sunctx;
+    solver_t *solver = NULL;
+    symplectic_t *sym = NULL;
+    multirate_t *mr = NULL;
+    void *cvode_mem = NULL;
+    stats_record_t rec;
 
-    params_t p;
+    int connections[6] = {0, 1, 0, 2, 1, 2};
+    xparams_t p;
 
+    for (j = 1; j < argc; ++j) {
+        if (strcmp(argv[j], "--bdf") == 0) {
+            method = SOLVER_BDF;
+        }
+        else if (strcmp(argv[j], "--imex") == 0) {
+            method = SOLVER_IMEX;
+        }
+        else if (strcmp(argv[j], "--dense") == 0) {
+            dense = 1;
+        }
+        else if (strcmp(argv[j], "--symplectic") == 0 && j + 1 < argc &&
+                 symplectic_method(argv[j + 1]) >= 0) {
+            symplectic = symplectic_method(argv[++j]);
+        }
+        else if (strcmp(argv[j], "--step") == 0 && j + 1 < argc) {
+            h = atof(argv[++j]);
+        }
+        else if (strcmp(argv[j], "--multirate") == 0) {
+            multirate = 1;
+        }
+        else if (strcmp(argv[j], "--slow-step") == 0 && j + 1 < argc) {
+            hs = atof(argv[++j]);
+        }
+        else if (strcmp(argv[j], "--force-law") == 0 && j + 1 < argc &&
+                 force_law_lookup(argv[j + 1]) >= 0) {
+            force_law = force_law_lookup(argv[++j]);
+        }
+        else if (strcmp(argv[j], "--break") == 0 && j + 1 < argc) {
+            break_strain = atof(argv[++j]);
+        }
+        else if (strcmp(argv[j], "--form") == 0 && j + 1 < argc) {
+            form = atof(argv[++j]);
+        }
+        else if (strcmp(argv[j], "--dt") == 0 && j + 1 < argc) {
+            dt = atof(argv[++j]);
+        }
+        else if (strcmp(argv[j], "--stats") == 0 && j + 1 < argc) {
+            stats_file = argv[++j];
+        }
+        else if (strcmp(argv[j], "--out") == 0 && j + 1 < argc) {
+            out_file = argv[++j];
+        }
+        else if (strcmp(argv[j], "--float32") == 0) {
+            dtype = TRAJ_FLOAT32;
+        }
+        else if (strcmp(argv[j], "--checkpoint") == 0 && j + 1 < argc) {
+            checkpoint_file = argv[++j];
+        }
+        else if (strcmp(argv[j], "--checkpoint-interval") == 0 && j + 1 < argc) {
+            checkpoint_interval = atof(argv[++j]);
+        }
+        else if (strcmp(argv[j], "--resume") == 0) {
+            resume = 1;
+        }
+        else {
+            fprintf(stderr, "usage: %s [--bdf | --imex] [--dense] "
+                    "[--symplectic verlet|yoshida4|yoshida6 [--step h]] "
+                    "[--multirate [--slow-step hs]] "
+                    "[--force-law cubic|hooke|lj|bilinear] "
+                    "[--break strain] [--form d] "
+                    "[--dt dt] [--stats file] [--out file.npy [--float32]] "
+                    "[--checkpoint file [--checkpoint-interval s] [--resume]]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+    if (resume && checkpoint_file == NULL) {
+        fprintf(stderr, "--resume needs --checkpoint file\n");
+        return 1;
+    }
+
+    flag = SUNContext_Create(SUN_COMM_NULL, &sunctx);
+    if (flag) {
+        fprintf(stderr, "SUNContext_Create() failed.\n");
+        return -1;
+    }
+
+    xparams_init(&p);
     p.k = 0.25;
     p.L = 1.0;
     p.b = 4.0;
     p.g = 5.0;
+    p.force_law = force_law;
+    p.num_points = 3;
+    p.num_connections = 3;
+    p.connections = connections;
+    p.stats = stats_create(stats_file);
+    if (p.stats == NULL) {
+        return -1;
+    }
 
     /* Initial conditions */
     N_Vector w;
-    w = N_VNew_Serial(12);
+    w = N_VNew_Serial(12, sunctx);
     X(w,0) = 6.0;
     Y(w,0)= 8.2;
     X(w,1) = 8.2;
@@ -33,45 +249,217 @@ int main(int argc, char *argv[])
     U(w,2) = 0.5;
     V(w,2) = -0.25;
 
-    /* For non-stiff problems:   */
-    void *cvode_mem = CVodeCreate(CV_ADAMS, CV_FUNCTIONAL);
-    /* For stiff problems:       */
-    //void *cvode_mem = CVodeCreate(CV_BDF, CV_NEWTON);
+    sunrealtype t = SUN_RCONST(0.0);
+    sunrealtype t1 = SUN_RCONST(2500.0);
+    if (resume) {
+        resumed = checkpoint_load(checkpoint_file);
+        if (resumed == NULL) {
+            fprintf(stderr, "No checkpoint in %s.0 or %s.1; starting at t=0.\n",
+                    checkpoint_file, checkpoint_file);
+        }
+        else {
+            if (checkpoint_restore(resumed, &p, w) != 0) {
+                return -1;
+            }
+            t = resumed->t;
+            fprintf(stderr, "Resuming at t=%g from checkpoint %ld.\n",
+                    t, (long) resumed->seq);
+        }
+    }
 
-    realtype t = RCONST(0.0);
-    flag = CVodeInit(cvode_mem, de3, t, w);
-    flag = CVodeSStolerances(cvode_mem, 1e-10, 1e-12);
-    flag = CVodeSetUserData(cvode_mem, &p);
-    flag = CVodeSetMaxNumSteps(cvode_mem, 100000);
-    flag = CVDense(cvode_mem, 12);
+    if (break_strain > 0 || form > 0) {
+        if (symplectic >= 0 || multirate) {
+            fprintf(stderr, "--break and --form do not apply to --symplectic or --multirate\n");
+            return 1;
+        }
+        if (form > 0) {
+            p.contact = contact_create(p.num_points, form);
+            if (p.contact == NULL) {
+                return -1;
+            }
+        }
+        bonds = bonds_create(&p, break_strain, form > 0);
+        if (bonds == NULL) {
+            return -1;
+        }
+        if (resumed != NULL) {
+            bonds->num_broken = resumed->num_broken;
+            bonds->num_formed = resumed->num_formed;
+        }
+    }
+    if (out_file != NULL) {
+        traj = resumed != NULL ? traj_append(out_file, 12, dtype, t) :
+                                 traj_open(out_file, 12, dtype);
+        if (traj == NULL) {
+            return -1;
+        }
+    }
+    if (checkpoint_file != NULL) {
+        checkpoint = checkpoint_open(checkpoint_file, resumed != NULL ? resumed->seq + 1 : 0);
+        if (checkpoint == NULL) {
+            return -1;
+        }
+        signal(SIGTERM, request_stop);
+        signal(SIGINT, request_stop);
+    }
 
-    realtype dt = RCONST(0.25);
-    realtype t1 = RCONST(2500.0);
-    flag = CVodeSetStopTime(cvode_mem, t1);
+    /*
+     * Adams for non-stiff problems, BDF (--bdf) for stiff problems, IMEX
+     * (--imex) for stiff springs.
+     */
+    if (symplectic >= 0) {
+        sym = symplectic_create(symplectic, h, &p, solver_rhs(&p), t, w);
+        if (sym == NULL) {
+            return -1;
+        }
+    }
+    else if (multirate) {
+        mr = multirate_create(&p, hs, t, w, sunctx);
+        if (mr == NULL) {
+            return -1;
+        }
+        flag = multirate_tolerances(mr, rtol, atol);
+        flag = ARKodeSetStopTime(mr->arkode_mem, t1);
+    }
+    else {
+        solver = solver_create(method, LINSOL_DENSE, &p, t, w, sunctx);
+        if (solver == NULL) {
+            return -1;
+        }
+        cvode_mem = solver->cvode_mem;
+        flag = solver_tolerances(solver, rtol, atol);
+        if (resumed != NULL) {
+            // The first step of the restart, from the saved history.
+            double h0 = checkpoint_initial_step(resumed, rtol, atol);
 
-    /* Print the solution at the current time */
-    printf("%.8e", t);
-    for (j = 0; j < 12; ++j) {
-        printf(" %.8e", NV_Ith_S(w, j));
+            if (h0 > 0) {
+                flag = solver_set_init_step(solver, h0);
+            }
+        }
+        flag = solver_set_max_num_steps(solver, 100000);
+        flag = solver_set_stop_time(solver, t1);
+        if (bonds != NULL) {
+            flag = solver_root_init(solver, contact_num_roots(&p), contact_roots);
+        }
     }
-    printf("\n");
+
+    /* Output the solution at the current time (already output if resumed) */
+    if (resumed == NULL) {
+        output(traj, t, w);
+    }
+    last_checkpoint = time(NULL);
 
     while (t < t1) {
         /* Advance the solution */
-        //flag = CVode(cvode_mem, t+dt, w, &t, CV_ONE_STEP);
-        flag = CVode(cvode_mem, t+dt, w, &t, CV_NORMAL);
+        if (sym != NULL) {
+            flag = symplectic_evolve(sym, t+dt, w, &t);
+        }
+        else if (mr != NULL) {
+            flag = ARKodeEvolve(mr->arkode_mem, t+dt, w, &t, ARK_NORMAL);
+        }
+        else if (dense) {
+            flag = solver_dense(solver, t+dt, w, &t);
+        }
+        else {
+            flag = solver_evolve(solver, t+dt, w, &t);
+        }
+        if (flag == CV_ROOT_RETURN && bonds != NULL) {
+            // A spring broke or two points touched: change the springs
+            // and restart from here.
+            // (A root where nothing changes is two points moving apart.)
+            long broken = bonds->num_broken, formed = bonds->num_formed;
+            int changes = bonds_update(bonds, N_VGetArrayPointer(w));
+
+            if (changes < 0) {
+                break;
+            }
+            flag = CV_SUCCESS;
+            if (changes > 0) {
+                fprintf(stderr, "t=%g: %ld springs broke, %ld formed; %d springs\n",
+                        t, bonds->num_broken - broken, bonds->num_formed - formed,
+                        p.num_connections);
+                flag = solver_reinit(solver, t, w);
+            }
+        }
         if (flag != CV_SUCCESS && flag != CV_TSTOP_RETURN) {
             fprintf(stderr, "flag=%d\n", flag);
             break;
         }
-        /* Print the solution at the current time */
-        printf("%.8e", t);
-        for (j = 0; j < 12; ++j) {
-            printf(" %.8e", NV_Ith_S(w, j));
+        /* Output the solution at the current time */
+        if (output(traj, t, w) != 0) {
+            break;
         }
-        printf("\n");
         //t = t + dt;
+        if (cvode_mem != NULL && stats_sample(p.stats, cvode_mem, t, &rec) == 0) {
+            stats_write(p.stats, &rec);
+        }
+        if (checkpoint != NULL && (stop_requested || t >= t1 ||
+                difftime(time(NULL), last_checkpoint) >= checkpoint_interval)) {
+            // (Skipped if the last one is still being written, except at
+            // the end.)
+            if (stop_requested || t >= t1) {
+                checkpoint_sync(checkpoint);
+            }
+            // The trajectory must reach t before the checkpoint does.
+            if (traj != NULL && traj_flush(traj) != 0) {
+                break;
+            }
+            retval = checkpoint_save(checkpoint, &p, t, w, solver);
+            if (retval < 0) {
+                break;
+            }
+            if (retval == 0) {
+                last_checkpoint = time(NULL);
+            }
+        }
+        if (stop_requested) {
+            fprintf(stderr, "t=%g: stopped\n", t);
+            break;
+        }
+    }
+
+    if (sym != NULL) {
+        fprintf(stderr, "t=%g: %ld steps, %ld rhs evals\n",
+                t, sym->nsteps, sym->nfevals);
+    }
+    else if (mr != NULL) {
+        long nsteps, nslow, nfast, nunused;
+
+        ARKodeGetNumSteps(mr->arkode_mem, &nsteps);
+        MRIStepGetNumRhsEvals(mr->arkode_mem, &nslow, &nunused);
+        ARKStepGetNumRhsEvals(mr->inner_mem, &nfast, &nunused);
+        fprintf(stderr, "t=%g: %ld slow steps, %ld slow (gravity) and %ld fast "
+                "(spring) rhs evals\n", t, nsteps, nslow, nfast);
+    }
+    else if (cvode_mem == NULL) {
+        long nsteps, nfevals;
+
+        solver_get_num_steps(solver, &nsteps);
+        solver_get_num_rhs_evals(solver, &nfevals);
+        fprintf(stderr, "t=%g: %ld steps, %ld implicit rhs evals\n",
+                t, nsteps, nfevals);
+    }
+    else if (stats_sample(p.stats, cvode_mem, t, &rec) == 0) {
+        fprintf(stderr, "t=%g: %ld steps, %ld rhs evals, %ld linear solver setups, "
+                "%ld error test failures, last step %.3e\n",
+                rec.t, rec.nsteps, rec.nfevals, rec.nlinsetups, rec.netfails,
+                rec.hlast);
+        fprintf(stderr, "%ld calls of de(), %.3f s (%.3f s wall time)\n",
+                rec.rhs_calls, rec.rhs_time, rec.wall);
+    }
+
+    retval = traj_close(traj);
+    if (checkpoint_close(checkpoint) != 0) {
+        retval = -1;
     }
-    N_VDestroy_Serial(w);
-    CVodeFree(&cvode_mem);
+    N_VDestroy(w);
+    solver_free(&solver);
+    symplectic_free(&sym);
+    multirate_free(&mr);
+    bonds_free(bonds);
+    contact_free(p.contact);
+    stats_free(p.stats);
+    checkpoint_data_free(resumed);
+    SUNContext_Free(&sunctx);
+    return retval;
 }
@@ -0,0 +1,497 @@
+//
+// Headless ensemble runner for the hexagon of animate_dynamics2.
+//
+// usage: ensemble spec-file [-j threads] [-o result-file]
+//
+// The spec file lists the values of each parameter, one parameter per
+// line; the ensemble is the Cartesian product of the lists.  A list is
+// either explicit values or start:stop:count (evenly spaced, like
+// numpy.linspace).  '#' starts a comment.  For example
+//
+//     k     2.0 2.5 3.0
+//     b     0.25:1.0:4
+//     v0    0.40:0.50:11
+//     tau1  2500
+//     method bdf
+//
+// Parameters (defaults from animate_dynamics2) are k, L, b, g, r0, v0
+// (initial speed of the points, except point 6, the last corner, which
+// moves at 0.1*v0, as in animate_dynamics2), tau1 (end time), rtol and
+// atol.  method is adams or bdf, and linsol is dense, klu, spgmr or
+// spfgmr.
+//
+// The members are distributed over a pool of threads with work stealing.
+// Each thread creates one CVODE integrator and reuses it for all its
+// members with CVodeReInit().  The result is one line per member: the
+// parameters, the outcome (ok, crash or the failing CVODE flag), the
+// final time (the time of the crash, if it crashed), the number of steps
+// and the final state.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sundials/sundials_core.h>     // Provides core SUNDIALS types
+#include <cvode/cvode.h>                // CVODE provides linear multistep methods
+#include <nvector/nvector_serial.h>     // access to serial N_Vector
+
+#include "contact.h"
+#include "de.h"
+#include "solver.h"
+
+#define STATUS_OK    0
+#define STATUS_CRASH 1
+#define STATUS_FAIL  2
+
+static const char *param_names[] = {"k", "L", "b", "g", "r0", "v0", "tau1"};
+#define NUM_PARAMS 7
+
+
+struct Member {
+    int id;
+    double values[NUM_PARAMS];
+};
+
+struct Result {
+    int status;
+    int flag;
+    double t;
+    long steps;
+    std::vector<double> state;
+
+    Result() : status(STATUS_FAIL), flag(0), t(0.0), steps(0)
+    {
+    }
+};
+
+
+//
+// Work-stealing queue of member indices.  The owner takes work from the
+// back; other threads steal from the front.
+//
+class WorkQueue {
+    std::mutex mutex;
+    std::deque<int> items;
+
+public:
+    void push(int item)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        items.push_back(item);
+    }
+
+    bool pop(int &item)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (items.empty()) {
+            return false;
+        }
+        item = items.back();
+        items.pop_back();
+        return true;
+    }
+
+    bool steal(int &item)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (items.empty()) {
+            return false;
+        }
+        item = items.front();
+        items.pop_front();
+        return true;
+    }
+};
+
+
+struct Ensemble {
+    std::vector<Member> members;
+    std::vector<Result> results;
+    std::vector<WorkQueue> queues;
+    int method;
+    int linsol;
+    double rtol, atol;
+
+    Ensemble(int num_threads) : queues(num_threads), method(SOLVER_ADAMS),
+        linsol(LINSOL_DENSE), rtol(1e-10), atol(1e-12)
+    {
+    }
+
+    //
+    // Next member for thread w: its own work first, then work stolen
+    // from the other threads.  No work is ever added once the threads
+    // have started, so when this fails, everything has been taken.
+    //
+    bool next(int w, int &item)
+    {
+        int n = queues.size();
+
+        if (queues[w].pop(item)) {
+            return true;
+        }
+        for (int k = 1; k < n; ++k) {
+            if (queues[(w + k) % n].steal(item)) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+
+//
+// Parse "start:stop:count" or a single number.
+//
+static bool parse_values(const std::string &word, std::vector<double> &values)
+{
+    char *end;
+    std::string::size_type c1 = word.find(':');
+
+    if (c1 == std::string::npos) {
+        double v = strtod(word.c_str(), &end);
+        if (*end != '\0') {
+            return false;
+        }
+        values.push_back(v);
+        return true;
+    }
+
+    std::string::size_type c2 = word.find(':', c1 + 1);
+    if (c2 == std::string::npos) {
+        return false;
+    }
+    double start = strtod(word.substr(0, c1).c_str(), &end);
+    double stop = strtod(word.substr(c1 + 1, c2 - c1 - 1).c_str(), &end);
+    int count = atoi(word.substr(c2 + 1).c_str());
+    if (count < 1) {
+        return false;
+    }
+    for (int i = 0; i < count; ++i) {
+        values.push_back(count == 1 ? start : start + (stop - start)*i/(count - 1));
+    }
+    return true;
+}
+
+static bool read_spec(const char *filename, Ensemble &ensemble)
+{
+    std::ifstream in(filename);
+    std::string line;
+    std::map<std::string, std::vector<double> > lists;
+    int lineno = 0;
+
+    // Defaults, from animate_dynamics2.
+    lists["k"] = std::vector<double>(1, 2.5);
+    lists["L"] = std::vector<double>(1, 1.5);
+    lists["b"] = std::vector<double>(1, 0.5);
+    lists["g"] = std::vector<double>(1, 8.0);
+    lists["r0"] = std::vector<double>(1, 0.25);
+    lists["v0"] = std::vector<double>(1, 0.45);
+    lists["tau1"] = std::vector<double>(1, 2500.0);
+
+    if (!in) {
+        std::cerr << "cannot open " << filename << "\n";
+        return false;
+    }
+    while (std::getline(in, line)) {
+        std::string name, word;
+        std::vector<double> values;
+
+        ++lineno;
+        line = line.substr(0, line.find('#'));
+        std::istringstream words(line);
+        if (!(words >> name)) {
+            continue;
+        }
+        if (name == "method" || name == "linsol") {
+            words >> word;
+            if (name == "method" && (word == "adams" || word == "bdf")) {
+                ensemble.method = (word == "bdf") ? SOLVER_BDF : SOLVER_ADAMS;
+            }
+            else if (name == "linsol" && word == "dense") {
+                ensemble.linsol = LINSOL_DENSE;
+            }
+            else if (name == "linsol" && word == "klu") {
+                ensemble.linsol = LINSOL_KLU;
+            }
+            else if (name == "linsol" && word == "spgmr") {
+                ensemble.linsol = LINSOL_SPGMR;
+            }
+            else if (name == "linsol" && word == "spfgmr") {
+                ensemble.linsol = LINSOL_SPFGMR;
+            }
+            else {
+                std::cerr << filename << ":" << lineno << ": bad " << name << "\n";
+                return false;
+            }
+            continue;
+        }
+        while (words >> word) {
+            if (!parse_values(word, values)) {
+                std::cerr << filename << ":" << lineno << ": bad value '" << word << "'\n";
+                return false;
+            }
+        }
+        if (values.empty()) {
+            std::cerr << filename << ":" << lineno << ": no values for " << name << "\n";
+            return false;
+        }
+        if (name == "rtol" || name == "atol") {
+            (name == "rtol" ? ensemble.rtol : ensemble.atol) = values[0];
+            continue;
+        }
+        if (lists.find(name) == lists.end()) {
+            std::cerr << filename << ":" << lineno << ": unknown parameter " << name << "\n";
+            return false;
+        }
+        lists[name] = values;
+    }
+
+    // Cartesian product; the last parameter varies fastest.
+    size_t total = 1;
+    for (int p = 0; p < NUM_PARAMS; ++p) {
+        total *= lists[param_names[p]].size();
+    }
+    for (size_t m = 0; m < total; ++m) {
+        Member member;
+        size_t rest = m;
+        member.id = m;
+        for (int p = NUM_PARAMS - 1; p >= 0; --p) {
+            const std::vector<double> &values = lists[param_names[p]];
+            member.values[p] = values[rest % values.size()];
+            rest /= values.size();
+        }
+        ensemble.members.push_back(member);
+    }
+    return true;
+}
+
+
+//
+// Initial conditions of animate_dynamics2 (with one ring): the hexagon of
+// hex_ics(), each point moving at (v0, -v0) except point 6, the last
+// corner, at 0.1*(v0, -v0).
+//
+static void member_ics(const Member &member, N_Vector state)
+{
+    double L = member.values[1];
+    double v0 = member.values[5];
+    double *p = N_VGetArrayPointer(state);
+
+    hex_ics(9.0, 9.0, L, p);
+    for (int i = 0; i < HEX_NUM_POINTS; ++i) {
+        double v = (i < HEX_NUM_POINTS - 1) ? v0 : 0.1*v0;
+        p[2*HEX_NUM_POINTS + 2*i] = v;
+        p[2*HEX_NUM_POINTS + 2*i + 1] = -v;
+    }
+}
+
+static void worker(Ensemble *ensemble, int w)
+{
+    SUNContext sunctx = NULL;
+    xparams_t params;
+    N_Vector state;
+    solver_t *solver = NULL;
+    int id;
+
+    // A SUNContext must not be shared between threads.
+    if (SUNContext_Create(SUN_COMM_NULL, &sunctx)) {
+        std::cerr << "SUNContext_Create() failed.\n";
+        return;
+    }
+    state = N_VNew_Serial(4*HEX_NUM_POINTS, sunctx);
+
+    xparams_init(&params);
+    params.num_points = HEX_NUM_POINTS;
+    params.num_connections = HEX_NUM_CONNECTIONS;
+    params.connections = hex_connections;
+
+    while (ensemble->next(w, id)) {
+        const Member &member = ensemble->members[id];
+        Result &result = ensemble->results[id];
+        sunrealtype t = SUN_RCONST(0.0);
+        sunrealtype tau1 = member.values[6];
+        int flag;
+
+        params.k = member.values[0];
+        params.L = member.values[1];
+        params.b = member.values[2];
+        params.g = member.values[3];
+        params.r0 = member.values[4];
+        member_ics(member, state);
+
+        if (solver == NULL) {
+            solver = solver_create(ensemble->method, ensemble->linsol, &params,
+                                   t, state, sunctx);
+            if (solver == NULL) {
+                result.status = STATUS_FAIL;
+                result.flag = CV_MEM_FAIL;
+                continue;
+            }
+            flag = CVodeSStolerances(solver->cvode_mem, ensemble->rtol, ensemble->atol);
+            if (flag == CV_SUCCESS) {
+                flag = CVodeSetMaxNumSteps(solver->cvode_mem, 500000);
+            }
+            if (flag == CV_SUCCESS) {
+                flag = CVodeRootInit(solver->cvode_mem, contact_num_roots(&params),
+                                     contact_roots);
+            }
+        }
+        else {
+            // Same problem size and topology: keep the integrator, the
+            // linear solver and the root functions.
+            flag = CVodeReInit(solver->cvode_mem, t, state);
+        }
+        if (flag == CV_SUCCESS) {
+            flag = CVodeSetStopTime(solver->cvode_mem, tau1);
+        }
+        if (flag != CV_SUCCESS) {
+            // Skip the member, and start the next one with a new solver.
+            std::cerr << "member " << member.id
+                      << ": setting up the solver failed, flag=" << flag << "\n";
+            result.status = STATUS_FAIL;
+            result.flag = flag;
+            solver_free(&solver);
+            continue;
+        }
+
+        result.status = STATUS_OK;
+        result.flag = CV_SUCCESS;
+        while (t < tau1) {
+            flag = CVode(solver->cvode_mem, tau1, state, &t, CV_NORMAL);
+            if (flag == CV_ROOT_RETURN) {
+                result.status = STATUS_CRASH;
+                break;
+            }
+            if (flag < 0) {
+                result.status = STATUS_FAIL;
+                result.flag = flag;
+                break;
+            }
+        }
+        result.t = t;
+        CVodeGetNumSteps(solver->cvode_mem, &result.steps);
+        result.state.assign(N_VGetArrayPointer(state),
+                            N_VGetArrayPointer(state) + 4*HEX_NUM_POINTS);
+    }
+
+    solver_free(&solver);
+    N_VDestroy(state);
+    SUNContext_Free(&sunctx);
+}
+
+static void write_results(std::ostream &out, const Ensemble &ensemble)
+{
+    out << "id";
+    for (int p = 0; p < NUM_PARAMS; ++p) {
+        out << "\t" << param_names[p];
+    }
+    out << "\tstatus\tt\tsteps";
+    for (int i = 0; i < HEX_NUM_POINTS; ++i) {
+        out << "\tx" << i << "\ty" << i;
+    }
+    for (int i = 0; i < HEX_NUM_POINTS; ++i) {
+        out << "\tu" << i << "\tv" << i;
+    }
+    out << "\n";
+
+    out.precision(10);
+    for (size_t m = 0; m < ensemble.members.size(); ++m) {
+        const Member &member = ensemble.members[m];
+        const Result &result = ensemble.results[m];
+
+        out << member.id;
+        for (int p = 0; p < NUM_PARAMS; ++p) {
+            out << "\t" << member.values[p];
+        }
+        if (result.status == STATUS_OK) {
+            out << "\tok";
+        }
+        else if (result.status == STATUS_CRASH) {
+            out << "\tcrash";
+        }
+        else {
+            out << "\tflag" << result.flag;
+        }
+        out << "\t" << result.t << "\t" << result.steps;
+        for (size_t i = 0; i < result.state.size(); ++i) {
+            out << "\t" << result.state[i];
+        }
+        out << "\n";
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    const char *spec = NULL;
+    const char *output = NULL;
+    int num_threads = std::thread::hardware_concurrency();
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-j" && i + 1 < argc) {
+            num_threads = atoi(argv[++i]);
+        }
+        else if (arg == "-o" && i + 1 < argc) {
+            output = argv[++i];
+        }
+        else if (spec == NULL && arg[0] != '-') {
+            spec = argv[i];
+        }
+        else {
+            spec = NULL;
+            break;
+        }
+    }
+    if (spec == NULL) {
+        std::cerr << "usage: " << argv[0] << " spec-file [-j threads] [-o result-file]\n";
+        return 1;
+    }
+    if (num_threads < 1) {
+        num_threads = 1;
+    }
+
+    Ensemble ensemble(num_threads);
+    if (!read_spec(spec, ensemble)) {
+        return 1;
+    }
+    ensemble.results.resize(ensemble.members.size());
+    std::cerr << ensemble.members.size() << " members, "
+              << num_threads << " threads\n";
+
+    // Deal the members out round robin; work stealing evens out the
+    // differences in cost (members that crash early are cheap).
+    for (size_t m = 0; m < ensemble.members.size(); ++m) {
+        ensemble.queues[m % num_threads].push(m);
+    }
+
+    std::vector<std::thread> threads;
+    for (int w = 0; w < num_threads; ++w) {
+        threads.push_back(std::thread(worker, &ensemble, w));
+    }
+    for (int w = 0; w < num_threads; ++w) {
+        threads[w].join();
+    }
+
+    if (output != NULL) {
+        std::ofstream out(output);
+        if (!out) {
+            std::cerr << "cannot open " << output << "\n";
+            return 1;
+        }
+        write_results(out, ensemble);
+    }
+    else {
+        write_results(std::cout, ensemble);
+    }
+    return 0;
+}
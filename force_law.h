@@ -0,0 +1,114 @@
+#ifndef _FORCE_LAW_H_
+#define _FORCE_LAW_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// The force laws of the springs.  Each gives the force of a spring of
+// natural length L and stiffness parameter k at separation r, positive
+// when the spring pushes its ends apart, and its derivative with respect
+// to r for the Jacobians:
+//
+//   FORCE_CUBIC:     -k*r*(1 - rho**3) = -k*(r - L**3/r**2), rho = L/r; the
+//                    default, and the law of the original de().  Its
+//                    slope at r = L is -3k, not -k: for the same k it is
+//                    three times as stiff as Hooke's law near L, and
+//                    stiffer in both tension and compression (the force
+//                    goes as k*(L - r) - k*L far out in tension, and
+//                    diverges as r -> 0).
+//   FORCE_HOOKE:     k*(L - r); slope -k.
+//   FORCE_LJ:        k*L/6*(rho**13 - rho**7), the force of a
+//                    Lennard-Jones potential with its minimum at L; slope
+//                    -k at L, and it vanishes as the spring is stretched.
+//   FORCE_BILINEAR:  k*(L - r) in tension, BILINEAR_COMPRESSION*k*(L - r)
+//                    in compression.
+//
+// So comparisons of the laws at the same k are not at the same stiffness;
+// FORCE_CUBIC with k/3 has the stiffness of the others at L.
+//
+// xparams_t.force_law selects one at run time.  The laws are static inline
+// so that the right-hand sides can be specialized for each (de() with a
+// constant function pointer, topology.h with a template parameter); the
+// loops over the connections then have no per-connection dispatch.
+// force_laws[] is the table of the same functions for the code that looks
+// the law up once per call instead.
+//
+
+#define FORCE_CUBIC     0
+#define FORCE_HOOKE     1
+#define FORCE_LJ        2
+#define FORCE_BILINEAR  3
+#define NUM_FORCE_LAWS  4
+
+// Stiffness in compression of FORCE_BILINEAR, relative to k.
+#define BILINEAR_COMPRESSION 4.0
+
+typedef double (*force_fn)(double r, double k, double L);
+
+typedef struct _force_law {
+    const char *name;
+    force_fn force;
+    /* derivative of force with respect to r */
+    force_fn deriv;
+} force_law_t;
+
+extern const force_law_t force_laws[NUM_FORCE_LAWS];
+
+int force_law_lookup(const char *name);
+
+
+static inline double force_cubic(double r, double k, double L)
+{
+    double rho = L/r;
+    return -k*r*(1 - rho)*(1 + rho + rho*rho);
+}
+
+static inline double force_cubic_deriv(double r, double k, double L)
+{
+    double rho = L/r;
+    return -k*(1 + 2*rho*rho*rho);
+}
+
+static inline double force_hooke(double r, double k, double L)
+{
+    return k*(L - r);
+}
+
+static inline double force_hooke_deriv(double r, double k, double L)
+{
+    return -k;
+}
+
+static inline double force_lj(double r, double k, double L)
+{
+    double rho = L/r;
+    double rho2 = rho*rho;
+    double rho6 = rho2*rho2*rho2;
+    return k*L/6*rho*rho6*(rho6 - 1);
+}
+
+static inline double force_lj_deriv(double r, double k, double L)
+{
+    double rho = L/r;
+    double rho2 = rho*rho;
+    double rho6 = rho2*rho2*rho2;
+    return k/6*rho2*rho6*(7 - 13*rho6);
+}
+
+static inline double force_bilinear(double r, double k, double L)
+{
+    return (r < L ? BILINEAR_COMPRESSION*k : k)*(L - r);
+}
+
+static inline double force_bilinear_deriv(double r, double k, double L)
+{
+    return -(r < L ? BILINEAR_COMPRESSION*k : k);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,158 @@
+#ifndef _FRAME_RING_H_
+#define _FRAME_RING_H_
+
+//
+// Decoupling of the integration from the rendering in the animators.
+//
+// A SimThread runs the integrator in the background and publishes each
+// frame (a timestamped copy of the state) in a FrameRing.  The FLTK timer
+// callback pops at most one frame per tick, so a slow step only delays
+// the animation; it no longer freezes the user interface.
+//
+// The FrameRing is a single-producer/single-consumer lock-free ring
+// buffer.  Its capacity is the number of frames the integrator may run
+// ahead of the display: when the ring is full, the producer waits
+// (backpressure) until the consumer has popped a frame.
+//
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <vector>
+
+
+class FrameRing {
+
+public:
+
+    struct Frame {
+        double t;
+        // Return value of the step that computed the frame.
+        int flag;
+        // The state; n values.
+        double *state;
+    };
+
+    FrameRing(int capacity, int n)
+        : frames(capacity), storage((size_t) capacity * n), head(0), tail(0)
+    {
+        for (int i = 0; i < capacity; ++i) {
+            frames[i].state = &storage[(size_t) i * n];
+        }
+    }
+
+    // Producer: the frame to fill in, or NULL if the ring is full.
+    Frame *begin_write()
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) == frames.size()) {
+            return NULL;
+        }
+        return &frames[h % frames.size()];
+    }
+
+    // Producer: publish the frame returned by begin_write().
+    void commit()
+    {
+        head.store(head.load(std::memory_order_relaxed) + 1,
+                   std::memory_order_release);
+    }
+
+    // Consumer: the oldest frame, or NULL if the ring is empty.
+    const Frame *front() const
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire)) {
+            return NULL;
+        }
+        return &frames[t % frames.size()];
+    }
+
+    // Consumer: release the frame returned by front().
+    void pop()
+    {
+        tail.store(tail.load(std::memory_order_relaxed) + 1,
+                   std::memory_order_release);
+    }
+
+    // Number of frames waiting (approximate while the other side runs).
+    int size() const
+    {
+        return (int) (head.load(std::memory_order_acquire) -
+                      tail.load(std::memory_order_acquire));
+    }
+
+private:
+
+    std::vector<Frame> frames;
+    std::vector<double> storage;
+    // head is written only by the producer, tail only by the consumer.
+    std::atomic<size_t> head;
+    std::atomic<size_t> tail;
+};
+
+
+class SimThread {
+
+public:
+
+    //
+    // step(&t, state) advances the integration by one frame, writes the
+    // time and the state of the new frame, and returns a flag.  The thread
+    // stops after a step that returns a nonzero flag (the frame is still
+    // published, so the consumer sees the flag).
+    //
+    typedef std::function<int(double *t, double *state)> StepFn;
+
+    SimThread(FrameRing &ring, StepFn step)
+        : ring(ring), step(step), quit(false)
+    {
+    }
+
+    ~SimThread()
+    {
+        stop();
+    }
+
+    void start()
+    {
+        thread = std::thread(&SimThread::run, this);
+    }
+
+    // Wait for the thread to finish; a step in progress is completed.
+    void stop()
+    {
+        quit.store(true);
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+
+private:
+
+    void run()
+    {
+        while (!quit.load()) {
+            FrameRing::Frame *frame = ring.begin_write();
+            if (frame == NULL) {
+                // Backpressure: the integrator is far enough ahead.
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                continue;
+            }
+            int flag = step(&frame->t, frame->state);
+            frame->flag = flag;
+            ring.commit();
+            if (flag != 0) {
+                break;
+            }
+        }
+    }
+
+    FrameRing &ring;
+    StepFn step;
+    std::atomic<bool> quit;
+    std::thread thread;
+};
+
+#endif
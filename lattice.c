@@ -0,0 +1,261 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lattice.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// The sites of a lattice are addressed by integer coordinates (a, b) on a
+// grid of size na x nb; the map from the grid to the point numbers is the
+// only work space.  For LATTICE_HEX, (a, b) are the axial coordinates
+// (q, r) of the triangular lattice shifted by the number of rings, and the
+// position is L*(q + r/2, r*sqrt(3)/2).  The sites are numbered ring by
+// ring from the center, each ring counterclockwise from the +x axis, so a
+// hexagon of one ring has the points of hex_ics().  For the other types,
+// a is the column and b the row, numbered row by row.
+//
+
+// Neighbors (da, db) in the "forward" directions, so each spring is made once.
+static const int hex_dirs[3][2] = {{1, 0}, {0, 1}, {-1, 1}};
+static const int tri_even_dirs[3][2] = {{1, 0}, {-1, 1}, {0, 1}};
+static const int tri_odd_dirs[3][2] = {{1, 0}, {0, 1}, {1, 1}};
+static const int square_dirs[2][2] = {{1, 0}, {0, 1}};
+
+// Steps (dq, dr) along the six sides of a ring, starting at (R, 0).
+static const int ring_dirs[6][2] = {{-1, 1}, {-1, 0}, {0, -1},
+                                    {1, -1}, {1, 0}, {0, 1}};
+
+void lattice_spec_init(lattice_spec_t *spec)
+{
+    memset(spec, 0, sizeof(lattice_spec_t));
+    spec->type = LATTICE_HEX;
+    spec->rings = 1;
+    spec->L = 1.0;
+    spec->seed = 1;
+}
+
+//
+// xorshift32; the vacancies do not depend on the C library's rand().
+//
+static double uniform(unsigned int *state)
+{
+    unsigned int x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return (x & 0xffffff) / (double) 0x1000000;
+}
+
+static int grid_size(const lattice_spec_t *spec, int *na, int *nb)
+{
+    switch (spec->type) {
+        case LATTICE_HEX:
+            if (spec->rings < 0) {
+                break;
+            }
+            *na = *nb = 2*spec->rings + 1;
+            return 0;
+        case LATTICE_TRIANGULAR:
+        case LATTICE_SQUARE:
+            if (spec->width < 1 || spec->height < 1) {
+                break;
+            }
+            *na = spec->width;
+            *nb = spec->height;
+            return 0;
+    }
+    fprintf(stderr, "lattice: invalid lattice specification\n");
+    return -1;
+}
+
+//
+// Grid coordinates of site number s (0 <= s < na*nb for the rectangular
+// lattices, 0 <= s < 3*R*(R+1) + 1 for the hexagon).
+//
+static void site(const lattice_spec_t *spec, int s, int *a, int *b)
+{
+    int R = spec->rings;
+    int ring, side, q, r, i;
+
+    if (spec->type != LATTICE_HEX) {
+        *a = s % spec->width;
+        *b = s / spec->width;
+        return;
+    }
+    if (s == 0) {
+        *a = *b = R;
+        return;
+    }
+    // Ring k holds sites 3*k*(k-1) + 1, ..., 3*k*(k+1).
+    ring = (int) ((3 + sqrt(9 + 12.0*(s - 1)))/6);
+    while (3*ring*(ring - 1) + 1 > s) {
+        --ring;
+    }
+    while (3*ring*(ring + 1) < s) {
+        ++ring;
+    }
+    s -= 3*ring*(ring - 1) + 1;
+    side = s / ring;
+    q = ring;
+    r = 0;
+    for (i = 0; i < side; ++i) {
+        q += ring*ring_dirs[i][0];
+        r += ring*ring_dirs[i][1];
+    }
+    q += (s % ring)*ring_dirs[side][0];
+    r += (s % ring)*ring_dirs[side][1];
+    *a = q + R;
+    *b = r + R;
+}
+
+static void position(const lattice_spec_t *spec, int a, int b,
+                     double *x, double *y)
+{
+    double h = 0.5*sqrt(3.0);
+    double W = spec->width, H = spec->height;
+
+    switch (spec->type) {
+        case LATTICE_HEX:
+            a -= spec->rings;
+            b -= spec->rings;
+            *x = a + 0.5*b;
+            *y = h*b;
+            break;
+        case LATTICE_TRIANGULAR:
+            // The odd rows are shifted by half a spacing.
+            *x = a + 0.5*(b & 1) - 0.5*(W - 1 + (H > 1 ? 0.5 : 0.0));
+            *y = h*(b - 0.5*(H - 1));
+            break;
+        default:
+            *x = a - 0.5*(W - 1);
+            *y = b - 0.5*(H - 1);
+            break;
+    }
+    *x = spec->cx + spec->L * *x;
+    *y = spec->cy + spec->L * *y;
+}
+
+//
+// Both lattice_size() and lattice_build(): when w is NULL, the points and
+// connections are only counted.
+//
+static int generate(const lattice_spec_t *spec, double *w, int *connections,
+                    int *num_points, int *num_connections)
+{
+    int na, nb, nsites, ndirs;
+    int *map;
+    unsigned int state;
+    int np, nc, s;
+
+    if (grid_size(spec, &na, &nb) != 0) {
+        return -1;
+    }
+    if (spec->type == LATTICE_HEX) {
+        nsites = 3*spec->rings*(spec->rings + 1) + 1;
+    }
+    else {
+        nsites = na*nb;
+    }
+    map = malloc(na*nb * sizeof(int));
+    if (map == NULL) {
+        fprintf(stderr, "lattice: out of memory\n");
+        return -1;
+    }
+    for (s = 0; s < na*nb; ++s) {
+        map[s] = -1;
+    }
+
+    // The points that are not vacant, with their positions.
+    state = spec->seed != 0 ? spec->seed : 1;
+    np = 0;
+    for (s = 0; s < nsites; ++s) {
+        int a, b;
+        site(spec, s, &a, &b);
+        if (spec->vacancy > 0 && uniform(&state) < spec->vacancy) {
+            continue;
+        }
+        map[b*na + a] = np;
+        if (w != NULL) {
+            position(spec, a, b, &w[2*np], &w[2*np + 1]);
+        }
+        ++np;
+    }
+
+    // The springs between neighbors that are both present.
+    ndirs = spec->type == LATTICE_SQUARE ? 2 : 3;
+    nc = 0;
+    for (s = 0; s < nsites; ++s) {
+        int a, b, d;
+        const int (*dirs)[2];
+
+        site(spec, s, &a, &b);
+        if (map[b*na + a] < 0) {
+            continue;
+        }
+        if (spec->type == LATTICE_HEX) {
+            dirs = hex_dirs;
+        }
+        else if (spec->type == LATTICE_TRIANGULAR) {
+            dirs = (b & 1) ? tri_odd_dirs : tri_even_dirs;
+        }
+        else {
+            dirs = square_dirs;
+        }
+        for (d = 0; d < ndirs; ++d) {
+            int a2 = a + dirs[d][0];
+            int b2 = b + dirs[d][1];
+            if (a2 < 0 || a2 >= na || b2 < 0 || b2 >= nb || map[b2*na + a2] < 0) {
+                continue;
+            }
+            if (connections != NULL) {
+                connections[2*nc] = map[b*na + a];
+                connections[2*nc + 1] = map[b2*na + a2];
+            }
+            ++nc;
+        }
+    }
+    free(map);
+
+    if (w != NULL) {
+        for (s = 0; s < np; ++s) {
+            double dx = w[2*s] - spec->cx;
+            double dy = w[2*s + 1] - spec->cy;
+            w[2*np + 2*s] = spec->u - spec->omega*dy;
+            w[2*np + 2*s + 1] = spec->v + spec->omega*dx;
+        }
+    }
+    *num_points = np;
+    *num_connections = nc;
+    return 0;
+}
+
+//
+// Number of points and connections of the lattice.  Returns 0 on
+// success, -1 if the specification is invalid.
+//
+int lattice_size(const lattice_spec_t *spec, int *num_points,
+                 int *num_connections)
+{
+    return generate(spec, NULL, NULL, num_points, num_connections);
+}
+
+//
+// Write the state (length 4*num_points) and the connections (length
+// 2*num_connections) of the lattice, with the sizes given by
+// lattice_size().  Returns 0 on success, -1 on failure.
+//
+int lattice_build(const lattice_spec_t *spec, double *w, int *connections)
+{
+    int num_points, num_connections;
+
+    return generate(spec, w, connections, &num_points, &num_connections);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,57 @@
+#ifndef _LATTICE_H_
+#define _LATTICE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// Generator of point mass systems on regular lattices, with springs
+// between nearest neighbors.
+//
+// A system is built in two calls: lattice_size() gives the number of
+// points and connections, so the caller can allocate the state (e.g. an
+// N_Vector of length 4*num_points) and the connection array (e.g. for an
+// xparams_t), and lattice_build() then writes the positions, velocities
+// and connections directly into that storage.  The state uses the layout
+// of de(): the positions of all the points, followed by their velocities.
+//
+
+// Values of lattice_spec_t.type.
+#define LATTICE_HEX         0   // triangular lattice cut to a hexagon of R rings
+#define LATTICE_TRIANGULAR  1   // W x H triangular lattice (offset rows)
+#define LATTICE_SQUARE      2   // W x H square lattice
+
+typedef struct _lattice_spec {
+    int type;
+    /* Number of rings around the center point, for LATTICE_HEX. */
+    int rings;
+    /* Number of points in each row, and number of rows. */
+    int width, height;
+    /* Distance between neighbors (normally the natural length L). */
+    double L;
+    /* Center of the lattice. */
+    double cx, cy;
+    /*
+     * Initial velocities: the translation (u, v) plus a rotation with
+     * angular velocity omega about (cx, cy).
+     */
+    double u, v, omega;
+    /*
+     * Each point is removed with probability vacancy; the same seed
+     * gives the same vacancies.  Springs to a removed point are removed.
+     */
+    double vacancy;
+    unsigned int seed;
+} lattice_spec_t;
+
+void lattice_spec_init(lattice_spec_t *spec);
+int lattice_size(const lattice_spec_t *spec, int *num_points,
+                 int *num_connections);
+int lattice_build(const lattice_spec_t *spec, double *w, int *connections);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,120 @@
+#include <sundials/sundials_core.h>     // Provides core SUNDIALS types
+#include <arkode/arkode.h>              // ARKODE's shared interface
+#include <arkode/arkode_arkstep.h>      // the fast, inner integrator
+#include <arkode/arkode_mristep.h>      // the slow, multirate integrator
+#include <nvector/nvector_serial.h>     // access to serial N_Vector
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "de.h"
+#include "force_law.h"
+#include "multirate.h"
+#include "solver.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// Create a multirate integrator for de() with slow step size hs.  params
+// is the user data of the slow partition, so it must outlive the
+// integrator.  The fast partition is the right-hand side that
+// solver_rhs() selects for a copy of params without gravity (and without
+// the timing of params->stats, which is left to the slow partition).
+//
+// The caller sets the tolerances (multirate_tolerances()) and any other
+// options on mr->arkode_mem.  Returns NULL on failure, also if
+// params->force_law is not one of force_laws[] (as solver_create()).
+//
+multirate_t *multirate_create(xparams_t *params, sunrealtype hs,
+                              sunrealtype t0, N_Vector y0, SUNContext sunctx)
+{
+    multirate_t *mr;
+    int flag;
+
+    if (params->force_law < 0 || params->force_law >= NUM_FORCE_LAWS) {
+        fprintf(stderr, "multirate_create: no force law %d\n", params->force_law);
+        return NULL;
+    }
+    mr = calloc(1, sizeof(multirate_t));
+    if (mr == NULL) {
+        fprintf(stderr, "multirate_create: out of memory\n");
+        return NULL;
+    }
+    mr->params = params;
+    mr->fast = *params;
+    mr->fast.g = 0.0;
+    mr->fast.bh = NULL;
+    mr->fast.stats = NULL;
+
+    mr->inner_mem = ARKStepCreate(solver_rhs(&mr->fast), NULL, t0, y0, sunctx);
+    if (mr->inner_mem == NULL) {
+        fprintf(stderr, "ARKStepCreate() failed.\n");
+        goto fail;
+    }
+    flag = ARKodeSetUserData(mr->inner_mem, &mr->fast);
+    if (flag != ARK_SUCCESS) {
+        fprintf(stderr, "ARKodeSetUserData() failed, flag=%d\n", flag);
+        goto fail;
+    }
+    flag = ARKStepCreateMRIStepInnerStepper(mr->inner_mem, &mr->inner_stepper);
+    if (flag != ARK_SUCCESS) {
+        fprintf(stderr, "ARKStepCreateMRIStepInnerStepper() failed, flag=%d\n", flag);
+        goto fail;
+    }
+
+    mr->arkode_mem = MRIStepCreate(de_gravity, NULL, t0, y0,
+                                   mr->inner_stepper, sunctx);
+    if (mr->arkode_mem == NULL) {
+        fprintf(stderr, "MRIStepCreate() failed.\n");
+        goto fail;
+    }
+    flag = ARKodeSetUserData(mr->arkode_mem, params);
+    if (flag != ARK_SUCCESS) {
+        fprintf(stderr, "ARKodeSetUserData() failed, flag=%d\n", flag);
+        goto fail;
+    }
+    flag = ARKodeSetFixedStep(mr->arkode_mem, hs);
+    if (flag != ARK_SUCCESS) {
+        fprintf(stderr, "ARKodeSetFixedStep() failed, flag=%d\n", flag);
+        goto fail;
+    }
+    return mr;
+
+fail:
+    multirate_free(&mr);
+    return NULL;
+}
+
+void multirate_free(multirate_t **mr)
+{
+    multirate_t *m = *mr;
+
+    if (m == NULL) {
+        return;
+    }
+    if (m->arkode_mem != NULL) {
+        ARKodeFree(&m->arkode_mem);
+    }
+    if (m->inner_stepper != NULL) {
+        MRIStepInnerStepper_Free(&m->inner_stepper);
+    }
+    if (m->inner_mem != NULL) {
+        ARKodeFree(&m->inner_mem);
+    }
+    free(m);
+    *mr = NULL;
+}
+
+//
+// The tolerances of the adaptive fast integration.  (The slow steps are
+// fixed.)
+//
+int multirate_tolerances(multirate_t *mr, sunrealtype rtol, sunrealtype atol)
+{
+    return ARKodeSStolerances(mr->inner_mem, rtol, atol);
+}
+
+#ifdef __cplusplus
+}
+#endif
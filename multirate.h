@@ -0,0 +1,55 @@
+#ifndef _MULTIRATE_H_
+#define _MULTIRATE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sundials/sundials_core.h>
+#include <arkode/arkode_arkstep.h>
+#include <arkode/arkode_mristep.h>
+#include <nvector/nvector_serial.h>
+
+#include "de.h"
+
+//
+// Multirate integration with ARKODE's MRIStep (SUNDIALS >= 7.1).
+//
+// de() is split into two partitions:
+//
+//   slow (de_gravity()):  the gravity of the central mass and, if
+//                         params->bh has been created, the mutual
+//                         gravity of the points;
+//   fast:                 dx/dt = u and the forces of the springs and
+//                         their damping, computed by the right-hand side
+//                         solver_rhs() selects, with g = 0 and no mutual
+//                         gravity.
+//
+// The sum of the two is de().  The slow partition is integrated with
+// fixed steps of size hs by an explicit MRI method (MRIStep's default,
+// 3rd order); between its stages, the fast partition is integrated by an
+// adaptive explicit ARKStep at the spring time scale.  So the gravity is
+// evaluated a few times per slow step, however fast the springs
+// oscillate.
+//
+
+typedef struct _multirate {
+    xparams_t *params;
+    /* A copy of params without the gravity, for the fast partition. */
+    xparams_t fast;
+    /* The slow (MRIStep) and the inner, fast (ARKStep) integrators. */
+    void *arkode_mem;
+    void *inner_mem;
+    MRIStepInnerStepper inner_stepper;
+} multirate_t;
+
+multirate_t *multirate_create(xparams_t *params, sunrealtype hs,
+                              sunrealtype t0, N_Vector y0, SUNContext sunctx);
+void multirate_free(multirate_t **mr);
+int multirate_tolerances(multirate_t *mr, sunrealtype rtol, sunrealtype atol);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,9 +1,15 @@
+import os
 import numpy as np
 import matplotlib.pyplot as plt
 
 
-
-w = np.loadtxt('out')
+# The output of demain: the binary trajectory of `demain --out out.npy`
+# (mapped, not read), or else the text of `demain > out`.  Each row is
+# t, x0, y0, x1, y1, x2, y2, u0, v0, ...
+if os.path.exists('out.npy'):
+    w = np.load('out.npy', mmap_mode='r')
+else:
+    w = np.loadtxt('out')
 
 plt.figure(1)
 plt.clf()
@@ -0,0 +1,217 @@
+// The buffer and shader functions are beyond OpenGL 1.x; Mesa's libGL
+// exports them, so they are called directly.
+#define GL_GLEXT_PROTOTYPES 1
+
+#include <stdio.h>
+#include <iostream>
+#include <vector>
+
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+#include "renderer.h"
+
+
+// Attribute location of the position in both programs.
+#define POSITION 0
+
+static const char *vertex_source =
+    "#version 150\n"
+    "in vec2 position;\n"
+    "uniform vec2 offset;\n"
+    "uniform float scale;\n"
+    "out vec2 world;\n"
+    "void main()\n"
+    "{\n"
+    "    world = position;\n"
+    "    gl_Position = vec4((position - offset)*scale, 0.0, 1.0);\n"
+    "}\n";
+
+// Red for a compressed spring, blue for a stretched one.  The argument of
+// tanh() is clamped, since some implementations overflow for large ones.
+static const char *geometry_source =
+    "#version 150\n"
+    "layout(lines) in;\n"
+    "layout(line_strip, max_vertices = 2) out;\n"
+    "in vec2 world[];\n"
+    "out vec3 color;\n"
+    "uniform float L;\n"
+    "const float base = 0.6;\n"
+    "void main()\n"
+    "{\n"
+    "    float dist = distance(world[0], world[1]);\n"
+    "    float s = tanh(clamp(25.0*(dist - L)/L, -10.0, 10.0));\n"
+    "    vec3 c = dist <= L ? vec3(base - (1.0 - base)*s, base, base)\n"
+    "                       : vec3(base, base, base + (1.0 - base)*s);\n"
+    "    color = c;\n"
+    "    gl_Position = gl_in[0].gl_Position;\n"
+    "    EmitVertex();\n"
+    "    color = c;\n"
+    "    gl_Position = gl_in[1].gl_Position;\n"
+    "    EmitVertex();\n"
+    "    EndPrimitive();\n"
+    "}\n";
+
+static const char *line_fragment_source =
+    "#version 150\n"
+    "in vec3 color;\n"
+    "out vec4 frag_color;\n"
+    "void main()\n"
+    "{\n"
+    "    frag_color = vec4(color, 1.0);\n"
+    "}\n";
+
+// The point masses are white.
+static const char *point_fragment_source =
+    "#version 150\n"
+    "out vec4 frag_color;\n"
+    "void main()\n"
+    "{\n"
+    "    frag_color = vec4(1.0);\n"
+    "}\n";
+
+
+static GLuint compile(GLenum type, const char *source)
+{
+    GLuint shader;
+    GLint ok;
+    char log[1024];
+
+    shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+    if (!ok) {
+        glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+        std::cerr << "SpringRenderer: shader compilation failed:\n" << log << "\n";
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+//
+// Link a program from the shader sources; geometry may be NULL.
+// Returns 0 on failure.
+//
+static GLuint link(const char *vertex, const char *geometry, const char *fragment)
+{
+    GLuint program = 0;
+    GLuint shaders[3] = {0, 0, 0};
+    GLint ok;
+    char log[1024];
+    int i;
+
+    shaders[0] = compile(GL_VERTEX_SHADER, vertex);
+    shaders[1] = geometry != NULL ? compile(GL_GEOMETRY_SHADER, geometry) : 0;
+    shaders[2] = compile(GL_FRAGMENT_SHADER, fragment);
+    if (shaders[0] == 0 || (geometry != NULL && shaders[1] == 0) || shaders[2] == 0) {
+        goto done;
+    }
+
+    program = glCreateProgram();
+    for (i = 0; i < 3; ++i) {
+        if (shaders[i] != 0) {
+            glAttachShader(program, shaders[i]);
+        }
+    }
+    glBindAttribLocation(program, POSITION, "position");
+    glBindFragDataLocation(program, 0, "frag_color");
+    glLinkProgram(program);
+    glGetProgramiv(program, GL_LINK_STATUS, &ok);
+    if (!ok) {
+        glGetProgramInfoLog(program, sizeof(log), NULL, log);
+        std::cerr << "SpringRenderer: program link failed:\n" << log << "\n";
+        glDeleteProgram(program);
+        program = 0;
+    }
+
+done:
+    // (Attached shaders are deleted with the program.)
+    for (i = 0; i < 3; ++i) {
+        if (shaders[i] != 0) {
+            glDeleteShader(shaders[i]);
+        }
+    }
+    return program;
+}
+
+
+SpringRenderer::SpringRenderer()
+    : num_points(0), num_connections(0), line_program(0), point_program(0),
+      positions(0), indices(0)
+{
+}
+
+bool SpringRenderer::init(int num_points, const int *connections,
+                          int num_connections)
+{
+    const char *version;
+    int major = 0, minor = 0;
+
+    version = (const char *) glGetString(GL_VERSION);
+    if (version == NULL || sscanf(version, "%d.%d", &major, &minor) != 2 ||
+            major*10 + minor < 32) {
+        std::cerr << "SpringRenderer: OpenGL 3.2 is needed, this is "
+                  << (version != NULL ? version : "unknown") << "\n";
+        return false;
+    }
+
+    line_program = link(vertex_source, geometry_source, line_fragment_source);
+    point_program = link(vertex_source, NULL, point_fragment_source);
+    if (line_program == 0 || point_program == 0) {
+        return false;
+    }
+
+    this->num_points = num_points;
+    this->num_connections = num_connections;
+    xyf.resize(2*num_points);
+
+    // The connections do not change; upload them once.
+    std::vector<GLuint> index(connections, connections + 2*num_connections);
+    glGenBuffers(1, &indices);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, index.size()*sizeof(GLuint),
+                 index.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    glGenBuffers(1, &positions);
+    return glGetError() == GL_NO_ERROR;
+}
+
+void SpringRenderer::draw(const double *xy, double L, double ox, double oy,
+                          double scale)
+{
+    GLsizeiptr size = xyf.size()*sizeof(float);
+
+    for (size_t i = 0; i < xyf.size(); ++i) {
+        xyf[i] = (float) xy[i];
+    }
+
+    // Orphan the previous frame's storage, then fill the new one.
+    glBindBuffer(GL_ARRAY_BUFFER, positions);
+    glBufferData(GL_ARRAY_BUFFER, size, NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, size, xyf.data());
+    glEnableVertexAttribArray(POSITION);
+    glVertexAttribPointer(POSITION, 2, GL_FLOAT, GL_FALSE, 0, 0);
+
+    glUseProgram(line_program);
+    glUniform2f(glGetUniformLocation(line_program, "offset"), ox, oy);
+    glUniform1f(glGetUniformLocation(line_program, "scale"), scale);
+    glUniform1f(glGetUniformLocation(line_program, "L"), L);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices);
+    glDrawElements(GL_LINES, 2*num_connections, GL_UNSIGNED_INT, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    glUseProgram(point_program);
+    glUniform2f(glGetUniformLocation(point_program, "offset"), ox, oy);
+    glUniform1f(glGetUniformLocation(point_program, "scale"), scale);
+    glPointSize(3.0);
+    glDrawArrays(GL_POINTS, 0, num_points);
+
+    // Leave the fixed-function state as it was for the immediate-mode
+    // drawing that follows.
+    glUseProgram(0);
+    glDisableVertexAttribArray(POSITION);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
@@ -0,0 +1,57 @@
+#ifndef _RENDERER_H_
+#define _RENDERER_H_
+
+//
+// Retained-mode renderer for the springs and the point masses.
+//
+// The connections are uploaded once, as an element (index) buffer; each
+// frame only the positions are uploaded, into a vertex buffer that is
+// orphaned first so the driver need not wait for the previous frame.  A
+// geometry shader computes the length of each spring and its strain
+// colour (the same colours as the immediate-mode code in Playback::draw()).
+//
+// This needs OpenGL 3.2 (GLSL 1.50) in a compatibility profile, which
+// Mesa's llvmpipe provides.  init() returns false if the context is older
+// or a shader does not compile; the caller then keeps drawing in
+// immediate mode.
+//
+// All methods must be called with the GL context current.  The buffers
+// and programs belong to that context and go away with it, so the
+// destructor does not touch GL.
+//
+
+#include <vector>
+
+#include <GL/gl.h>
+
+
+class SpringRenderer {
+
+public:
+
+    SpringRenderer();
+
+    // Create the programs and buffers for a system with the given points
+    // and connections (2*num_connections indices).
+    bool init(int num_points, const int *connections, int num_connections);
+
+    // Draw the springs and the points.  xy holds x0, y0, x1, y1, ...; a
+    // spring of length L is unstrained.  (x, y) is drawn at
+    // ((x - ox)*scale, (y - oy)*scale).
+    void draw(const double *xy, double L, double ox, double oy, double scale);
+
+private:
+
+    int num_points;
+    int num_connections;
+
+    GLuint line_program;
+    GLuint point_program;
+    GLuint positions;
+    GLuint indices;
+
+    // Positions converted to float for the upload.
+    std::vector<float> xyf;
+};
+
+#endif
@@ -0,0 +1,481 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "reorder.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Resolution of the space-filling curves: 2**CURVE_BITS cells per side.
+#define CURVE_BITS 16
+
+int reorder_method(const char *name)
+{
+    if (strcmp(name, "none") == 0) {
+        return REORDER_NONE;
+    }
+    if (strcmp(name, "rcm") == 0) {
+        return REORDER_RCM;
+    }
+    if (strcmp(name, "morton") == 0) {
+        return REORDER_MORTON;
+    }
+    if (strcmp(name, "hilbert") == 0) {
+        return REORDER_HILBERT;
+    }
+    if (strcmp(name, "random") == 0) {
+        return REORDER_RANDOM;
+    }
+    return -1;
+}
+
+//
+// The neighbors of point i are adj[start[i]:start[i+1]].
+//
+typedef struct _graph {
+    int *start;
+    int *adj;
+} graph_t;
+
+static int graph_build(graph_t *g, const xparams_t *p)
+{
+    int n = p->num_points;
+    int *fill;
+    int idx;
+
+    g->start = calloc(n + 1, sizeof(int));
+    g->adj = malloc(2*p->num_connections * sizeof(int));
+    fill = calloc(n, sizeof(int));
+    if (g->start == NULL || g->adj == NULL || fill == NULL) {
+        free(g->start);
+        free(g->adj);
+        free(fill);
+        return -1;
+    }
+    for (idx = 0; idx < p->num_connections; ++idx) {
+        ++g->start[p->connections[2*idx] + 1];
+        ++g->start[p->connections[2*idx + 1] + 1];
+    }
+    for (idx = 0; idx < n; ++idx) {
+        g->start[idx + 1] += g->start[idx];
+    }
+    for (idx = 0; idx < p->num_connections; ++idx) {
+        int i = p->connections[2*idx];
+        int j = p->connections[2*idx + 1];
+        g->adj[g->start[i] + fill[i]++] = j;
+        g->adj[g->start[j] + fill[j]++] = i;
+    }
+    free(fill);
+    return 0;
+}
+
+#define DEGREE(g, i) ((g)->start[(i) + 1] - (g)->start[i])
+
+//
+// Breadth first search from root over the points not yet numbered
+// (mark[i] < 0), with the neighbors of each point taken in increasing
+// order of degree, as Cuthill-McKee does.  The points found are
+// queue[0:count], in order; mark[i] is set to their level.  Returns
+// count, and the number of levels in *depth.
+//
+static int bfs(const graph_t *g, int root, int *mark, int *queue, int *depth)
+{
+    int head = 0, count = 1;
+
+    queue[0] = root;
+    mark[root] = 0;
+    while (head < count) {
+        int i = queue[head++];
+        int first = count;
+        int k;
+
+        for (k = g->start[i]; k < g->start[i + 1]; ++k) {
+            int j = g->adj[k];
+            if (mark[j] < 0) {
+                int m = count++;
+
+                mark[j] = mark[i] + 1;
+                // Insertion sort by degree; the lists are short.
+                while (m > first && DEGREE(g, queue[m - 1]) > DEGREE(g, j)) {
+                    queue[m] = queue[m - 1];
+                    --m;
+                }
+                queue[m] = j;
+            }
+        }
+    }
+    *depth = mark[queue[count - 1]] + 1;
+    return count;
+}
+
+//
+// Reverse Cuthill-McKee: each connected component is numbered breadth
+// first from a pseudo-peripheral point (George and Liu: the point of
+// least degree in the last level, until the number of levels stops
+// growing), and the whole order is reversed.
+//
+static int order_rcm(const xparams_t *p, int *perm)
+{
+    int n = p->num_points;
+    graph_t g;
+    int *mark, *queue;
+    int numbered = 0, next = 0;
+    int i, k;
+
+    mark = malloc(n * sizeof(int));
+    queue = malloc(n * sizeof(int));
+    if (mark == NULL || queue == NULL || graph_build(&g, p) != 0) {
+        free(mark);
+        free(queue);
+        return -1;
+    }
+    for (i = 0; i < n; ++i) {
+        mark[i] = -1;
+    }
+    while (numbered < n) {
+        int count, depth, new_depth;
+
+        while (mark[next] >= 0) {
+            ++next;
+        }
+        count = bfs(&g, next, mark, queue, &depth);
+        for (;;) {
+            int best = queue[count - 1];
+
+            for (k = count - 1; k >= 0 && mark[queue[k]] == depth - 1; --k) {
+                if (DEGREE(&g, queue[k]) < DEGREE(&g, best)) {
+                    best = queue[k];
+                }
+            }
+            for (k = 0; k < count; ++k) {
+                mark[queue[k]] = -1;
+            }
+            bfs(&g, best, mark, queue, &new_depth);
+            if (new_depth <= depth) {
+                // (queue holds the search from best, which is kept.)
+                break;
+            }
+            depth = new_depth;
+        }
+        for (k = 0; k < count; ++k) {
+            perm[n - 1 - numbered - k] = queue[k];
+        }
+        numbered += count;
+    }
+
+    free(g.start);
+    free(g.adj);
+    free(mark);
+    free(queue);
+    return 0;
+}
+
+typedef struct _keyed {
+    unsigned int key;
+    int point;
+} keyed_t;
+
+static int compare_keyed(const void *a, const void *b)
+{
+    const keyed_t *ka = a, *kb = b;
+
+    if (ka->key != kb->key) {
+        return ka->key < kb->key ? -1 : 1;
+    }
+    return (ka->point > kb->point) - (ka->point < kb->point);
+}
+
+static unsigned int morton_key(unsigned int x, unsigned int y)
+{
+    unsigned int key = 0;
+    int b;
+
+    for (b = 0; b < CURVE_BITS; ++b) {
+        key |= ((x >> b) & 1u) << (2*b);
+        key |= ((y >> b) & 1u) << (2*b + 1);
+    }
+    return key;
+}
+
+//
+// Position of the cell (x, y) along the Hilbert curve through the
+// 2**CURVE_BITS x 2**CURVE_BITS cells.
+//
+static unsigned int hilbert_key(unsigned int x, unsigned int y)
+{
+    const unsigned int n = 1u << CURVE_BITS;
+    unsigned int key = 0;
+    unsigned int s;
+
+    for (s = n/2; s > 0; s /= 2) {
+        unsigned int rx = (x & s) > 0;
+        unsigned int ry = (y & s) > 0;
+
+        key += s*s*((3*rx) ^ ry);
+        // Rotate the quadrant.
+        if (ry == 0) {
+            unsigned int t;
+
+            if (rx == 1) {
+                x = n - 1 - x;
+                y = n - 1 - y;
+            }
+            t = x;
+            x = y;
+            y = t;
+        }
+    }
+    return key;
+}
+
+//
+// The cell, 0 to 2**CURVE_BITS - 1, of the scaled coordinate u.  (Clamped,
+// since converting a double out of the range of unsigned int, as when the
+// extent of the points overflows, is undefined.)
+//
+static unsigned int curve_cell(double u)
+{
+    return u > 0 ? (unsigned int) fmin(u, (1u << CURVE_BITS) - 1) : 0;
+}
+
+//
+// The points sorted along a space-filling curve through the bounding
+// box of their positions y, which must be finite.
+//
+static int order_curve(int method, int n, const double *y, int *perm)
+{
+    keyed_t *keyed;
+    double xmin = HUGE_VAL, xmax = -HUGE_VAL, ymin = HUGE_VAL, ymax = -HUGE_VAL;
+    double scale;
+    int i;
+
+    keyed = malloc(n * sizeof(keyed_t));
+    if (keyed == NULL) {
+        return -1;
+    }
+    for (i = 0; i < n; ++i) {
+        xmin = fmin(xmin, y[2*i]);
+        xmax = fmax(xmax, y[2*i]);
+        ymin = fmin(ymin, y[2*i+1]);
+        ymax = fmax(ymax, y[2*i+1]);
+    }
+    // The same scale for x and y, so the cells are square.
+    scale = fmax(xmax - xmin, ymax - ymin);
+    scale = scale > 0 ? ((1u << CURVE_BITS) - 1)/scale : 0.0;
+    for (i = 0; i < n; ++i) {
+        unsigned int cx = curve_cell((y[2*i] - xmin)*scale);
+        unsigned int cy = curve_cell((y[2*i+1] - ymin)*scale);
+
+        keyed[i].key = method == REORDER_HILBERT ? hilbert_key(cx, cy) : morton_key(cx, cy);
+        keyed[i].point = i;
+    }
+    qsort(keyed, n, sizeof(keyed_t), compare_keyed);
+    for (i = 0; i < n; ++i) {
+        perm[i] = keyed[i].point;
+    }
+    free(keyed);
+    return 0;
+}
+
+//
+// Fisher-Yates shuffle with xorshift32 (as lattice.c), so the order is the
+// same on every platform.
+//
+static void order_random(int n, int *perm)
+{
+    unsigned int x = 1;
+    int i;
+
+    for (i = 0; i < n; ++i) {
+        perm[i] = i;
+    }
+    for (i = n - 1; i > 0; --i) {
+        int j, t;
+
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        j = (int) (x % (unsigned int) (i + 1));
+        t = perm[i];
+        perm[i] = perm[j];
+        perm[j] = t;
+    }
+}
+
+//
+// The order of the points of params given by method, from the
+// connections (REORDER_RCM) or from the initial positions in the state w
+// (REORDER_MORTON, REORDER_HILBERT), which must be finite.  Returns NULL
+// on failure.
+//
+reorder_t *reorder_create(int method, const xparams_t *params, const double *w)
+{
+    reorder_t *reorder;
+    int n = params->num_points;
+    int i, retval = 0;
+
+    reorder = calloc(1, sizeof(reorder_t));
+    if (reorder == NULL) {
+        goto fail;
+    }
+    reorder->num_points = n;
+    reorder->perm = malloc(n * sizeof(int));
+    reorder->inv = malloc(n * sizeof(int));
+    if (reorder->perm == NULL || reorder->inv == NULL) {
+        goto fail;
+    }
+    switch (method) {
+    case REORDER_NONE:
+        for (i = 0; i < n; ++i) {
+            reorder->perm[i] = i;
+        }
+        break;
+    case REORDER_RCM:
+        retval = order_rcm(params, reorder->perm);
+        break;
+    case REORDER_MORTON:
+    case REORDER_HILBERT:
+        for (i = 0; i < n; ++i) {
+            if (!isfinite(w[2*i]) || !isfinite(w[2*i+1])) {
+                fprintf(stderr, "reorder_create: point %d is at (%g, %g)\n",
+                        i, w[2*i], w[2*i+1]);
+                reorder_free(reorder);
+                return NULL;
+            }
+        }
+        retval = order_curve(method, n, w, reorder->perm);
+        break;
+    case REORDER_RANDOM:
+        order_random(n, reorder->perm);
+        break;
+    default:
+        fprintf(stderr, "reorder_create: unknown method %d\n", method);
+        reorder_free(reorder);
+        return NULL;
+    }
+    if (retval != 0) {
+        goto fail;
+    }
+    for (i = 0; i < n; ++i) {
+        reorder->inv[reorder->perm[i]] = i;
+    }
+    return reorder;
+
+fail:
+    fprintf(stderr, "reorder_create: out of memory\n");
+    reorder_free(reorder);
+    return NULL;
+}
+
+void reorder_free(reorder_t *reorder)
+{
+    if (reorder == NULL) {
+        return;
+    }
+    free(reorder->perm);
+    free(reorder->inv);
+    free(reorder);
+}
+
+//
+// Renumber the points of params and of the state w (4*num_points values,
+// the layout of de()), and sort the connections by their lower point,
+// which comes first.  Returns 0, or -1 if out of memory.
+//
+int reorder_apply(const reorder_t *reorder, xparams_t *params, double *w)
+{
+    int n = reorder->num_points;
+    int m = params->num_connections;
+    double *tmp;
+    int *conn, *start;
+    int idx;
+
+    tmp = malloc(4*n * sizeof(double));
+    conn = malloc(2*m * sizeof(int));
+    start = calloc(n + 1, sizeof(int));
+    if (tmp == NULL || conn == NULL || start == NULL) {
+        fprintf(stderr, "reorder_apply: out of memory\n");
+        free(tmp);
+        free(conn);
+        free(start);
+        return -1;
+    }
+
+    memcpy(tmp, w, 4*n * sizeof(double));
+    for (idx = 0; idx < n; ++idx) {
+        int old = reorder->perm[idx];
+
+        w[2*idx] = tmp[2*old];
+        w[2*idx+1] = tmp[2*old+1];
+        w[2*n + 2*idx] = tmp[2*n + 2*old];
+        w[2*n + 2*idx + 1] = tmp[2*n + 2*old + 1];
+    }
+
+    // Counting sort of the renamed connections by their lower point.
+    // (The force of a spring does not depend on the order of its points.)
+    for (idx = 0; idx < m; ++idx) {
+        int i = reorder->inv[params->connections[2*idx]];
+        int j = reorder->inv[params->connections[2*idx + 1]];
+
+        conn[2*idx] = i < j ? i : j;
+        conn[2*idx + 1] = i < j ? j : i;
+        ++start[conn[2*idx] + 1];
+    }
+    for (idx = 0; idx < n; ++idx) {
+        start[idx + 1] += start[idx];
+    }
+    for (idx = 0; idx < m; ++idx) {
+        int k = start[conn[2*idx]]++;
+
+        params->connections[2*k] = conn[2*idx];
+        params->connections[2*k + 1] = conn[2*idx + 1];
+    }
+
+    free(tmp);
+    free(conn);
+    free(start);
+    return 0;
+}
+
+//
+// The state w of the renumbered points, in the original order.
+//
+void reorder_state(const reorder_t *reorder, const double *w, double *orig)
+{
+    int n = reorder->num_points;
+    int idx;
+
+    for (idx = 0; idx < n; ++idx) {
+        int old = reorder->perm[idx];
+
+        orig[2*old] = w[2*idx];
+        orig[2*old+1] = w[2*idx+1];
+        orig[2*n + 2*old] = w[2*n + 2*idx];
+        orig[2*n + 2*old + 1] = w[2*n + 2*idx + 1];
+    }
+}
+
+//
+// The largest difference max |i - j| of the points of the connections;
+// the Jacobian has nonzeros at most 2*bandwidth + 1 columns (of x, y or
+// u, v) from its diagonal blocks.
+//
+int reorder_bandwidth(const xparams_t *params)
+{
+    int bandwidth = 0;
+    int idx;
+
+    for (idx = 0; idx < params->num_connections; ++idx) {
+        int d = abs(params->connections[2*idx] - params->connections[2*idx + 1]);
+        if (d > bandwidth) {
+            bandwidth = d;
+        }
+    }
+    return bandwidth;
+}
+
+#ifdef __cplusplus
+}
+#endif
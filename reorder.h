@@ -0,0 +1,57 @@
+#ifndef _REORDER_H_
+#define _REORDER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "de.h"
+
+//
+// Renumbering of the points of a system, once, before the integration,
+// so that connected points are near each other in the state vector:
+//
+//   REORDER_RCM:      reverse Cuthill-McKee on the graph of the
+//                     connections; the smallest bandwidth max |i - j| of
+//                     the connections, so the Jacobian (de_jac.h) is
+//                     banded.
+//   REORDER_MORTON:   the points sorted along a Morton (Z order) curve
+//                     through their initial positions.
+//   REORDER_HILBERT:  the same along a Hilbert curve, which has no long
+//                     jumps between the quadrants.
+//   REORDER_RANDOM:   a random order, the worst case, for comparison.
+//
+// reorder_apply() permutes the state (positions and velocities, the
+// layout of de()) and renames the points of the connections, which are
+// then sorted by their first point, so that de() goes through the state
+// nearly in order.  Create params->schedule, params->edges and the solver
+// after it.  The rest of the program sees the new order; reorder_state()
+// gives back a state in the original order, for output, and perm[k] is
+// the original number of point k.
+//
+
+#define REORDER_NONE     0
+#define REORDER_RCM      1
+#define REORDER_MORTON   2
+#define REORDER_HILBERT  3
+#define REORDER_RANDOM   4
+
+typedef struct _reorder {
+    int num_points;
+    /* perm[new] is the original number of point new; inv is the inverse */
+    int *perm;
+    int *inv;
+} reorder_t;
+
+int reorder_method(const char *name);
+reorder_t *reorder_create(int method, const xparams_t *params, const double *w);
+void reorder_free(reorder_t *reorder);
+int reorder_apply(const reorder_t *reorder, xparams_t *params, double *w);
+void reorder_state(const reorder_t *reorder, const double *w, double *orig);
+int reorder_bandwidth(const xparams_t *params);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
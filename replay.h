@@ -0,0 +1,150 @@
+#ifndef _REPLAY_H_
+#define _REPLAY_H_
+
+//
+// Playback of a recorded trajectory (see traj.h) in the animators, in
+// place of the live integration.
+//
+// The file is mapped, not read, and the frame to show is found directly
+// from the time (traj_map_find()), so seeking anywhere in a long run is
+// immediate and only the pages of the frames actually shown are read.
+// The playback time advances at speed time units per second of wall
+// time; a negative speed plays backwards.  Playback pauses at either end.
+//
+// Keys (see key()):
+//     space   pause / resume
+//     r       reverse
+//     + -     double / halve the speed
+//     , .     one frame back / forward (pauses)
+//     [ ]     back / forward a tenth of the trajectory
+//     b e     jump to the beginning / end
+//
+
+#include <vector>
+
+#include "traj.h"
+
+
+class Replay {
+
+public:
+
+    Replay(traj_map_t *map, double speed)
+        : map(map), state(map->row_size - 1), current(-1), speed(speed),
+          paused(false)
+    {
+        t = start();
+    }
+
+    double start() const
+    {
+        return traj_map_time(map, 0);
+    }
+
+    double end() const
+    {
+        return traj_map_time(map, map->num_frames - 1);
+    }
+
+    double time() const
+    {
+        return t;
+    }
+
+    // Advance the playback by dt seconds of wall time.
+    void advance(double dt)
+    {
+        if (!paused) {
+            seek(t + speed*dt);
+            if (t == start() || t == end()) {
+                paused = true;
+            }
+        }
+    }
+
+    void seek(double tau)
+    {
+        t = tau < start() ? start() : (tau > end() ? end() : tau);
+    }
+
+    // Seek to a fraction (0 to 1) of the trajectory, e.g. from the mouse.
+    void scrub(double fraction)
+    {
+        seek(start() + fraction*(end() - start()));
+    }
+
+    // Move n frames forward (or back, if n < 0), and pause.
+    void step(long n)
+    {
+        long i = traj_map_find(map, t) + n;
+
+        i = i < 0 ? 0 : (i >= map->num_frames ? map->num_frames - 1 : i);
+        t = traj_map_time(map, i);
+        paused = true;
+    }
+
+    // Handle a key; returns false if it is not one of the playback keys.
+    bool key(char c)
+    {
+        switch (c) {
+        case ' ':
+            paused = !paused;
+            break;
+        case 'r':
+            speed = -speed;
+            paused = false;
+            break;
+        case '+':
+            speed *= 2.0;
+            break;
+        case '-':
+            speed *= 0.5;
+            break;
+        case ',':
+            step(-1);
+            break;
+        case '.':
+            step(1);
+            break;
+        case '[':
+            seek(t - 0.1*(end() - start()));
+            break;
+        case ']':
+            seek(t + 0.1*(end() - start()));
+            break;
+        case 'b':
+            seek(start());
+            break;
+        case 'e':
+            seek(end());
+            break;
+        default:
+            return false;
+        }
+        return true;
+    }
+
+    // The state at the playback time: the last frame at or before it.
+    const double *frame()
+    {
+        long i = traj_map_find(map, t);
+
+        if (i != current) {
+            traj_map_frame(map, i, &state[0]);
+            current = i;
+        }
+        return &state[0];
+    }
+
+private:
+
+    traj_map_t *map;
+    // The frame current, converted to double.
+    std::vector<double> state;
+    long current;
+    double t;
+    double speed;
+    bool paused;
+};
+
+#endif
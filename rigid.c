@@ -0,0 +1,183 @@
+#include <sundials/sundials_core.h> // Provides core SUNDIALS types
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "rigid.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// Create num_bodies rigid bodies; body b has num_points[b] points.
+// points holds the coordinates x, y of all the points, body by body, in
+// the frame of their body (with any origin: they are shifted to the
+// center of mass, which is what the state gives the position of), and
+// masses their masses (all 1 if masses is NULL).  The arrays are copied.
+// Returns NULL on failure.
+//
+rigid_bodies_t *rigid_bodies_create(int num_bodies, const int *num_points,
+                                    const double *points, const double *masses,
+                                    double g, double r0)
+{
+    rigid_bodies_t *rb;
+    int b, i, n;
+
+    n = 0;
+    for (b = 0; b < num_bodies; ++b) {
+        if (num_points[b] < 1) {
+            fprintf(stderr, "rigid_bodies_create: body %d has no points\n", b);
+            return NULL;
+        }
+        n += num_points[b];
+    }
+
+    rb = calloc(1, sizeof(rigid_bodies_t));
+    if (rb == NULL) {
+        goto fail;
+    }
+    rb->num_bodies = num_bodies;
+    rb->num_points = n;
+    rb->g = g;
+    rb->r0 = r0;
+    rb->first = malloc((num_bodies + 1) * sizeof(int));
+    rb->body = malloc(n * sizeof(int));
+    rb->px = malloc(n * sizeof(double));
+    rb->py = malloc(n * sizeof(double));
+    rb->m = malloc(n * sizeof(double));
+    rb->mass = malloc(num_bodies * sizeof(double));
+    rb->inertia = malloc(num_bodies * sizeof(double));
+    rb->cs = malloc(num_bodies * sizeof(double));
+    rb->sn = malloc(num_bodies * sizeof(double));
+    rb->fx = malloc(n * sizeof(double));
+    rb->fy = malloc(n * sizeof(double));
+    rb->tq = malloc(n * sizeof(double));
+    if (rb->first == NULL || rb->body == NULL || rb->px == NULL ||
+            rb->py == NULL || rb->m == NULL || rb->mass == NULL ||
+            rb->inertia == NULL || rb->cs == NULL || rb->sn == NULL ||
+            rb->fx == NULL || rb->fy == NULL || rb->tq == NULL) {
+        goto fail;
+    }
+
+    rb->first[0] = 0;
+    for (b = 0; b < num_bodies; ++b) {
+        double xcm = 0.0, ycm = 0.0, mass = 0.0, inertia = 0.0;
+
+        rb->first[b+1] = rb->first[b] + num_points[b];
+        for (i = rb->first[b]; i < rb->first[b+1]; ++i) {
+            rb->body[i] = b;
+            rb->m[i] = masses != NULL ? masses[i] : 1.0;
+            mass += rb->m[i];
+            xcm += rb->m[i]*points[2*i];
+            ycm += rb->m[i]*points[2*i+1];
+        }
+        if (!(mass > 0)) {
+            fprintf(stderr, "rigid_bodies_create: body %d has no mass\n", b);
+            rigid_bodies_free(rb);
+            return NULL;
+        }
+        xcm /= mass;
+        ycm /= mass;
+        for (i = rb->first[b]; i < rb->first[b+1]; ++i) {
+            rb->px[i] = points[2*i] - xcm;
+            rb->py[i] = points[2*i+1] - ycm;
+            inertia += rb->m[i]*(rb->px[i]*rb->px[i] + rb->py[i]*rb->py[i]);
+        }
+        rb->mass[b] = mass;
+        rb->inertia[b] = inertia;
+    }
+    return rb;
+
+fail:
+    fprintf(stderr, "rigid_bodies_create: out of memory\n");
+    rigid_bodies_free(rb);
+    return NULL;
+}
+
+void rigid_bodies_free(rigid_bodies_t *rb)
+{
+    if (rb == NULL) {
+        return;
+    }
+    free(rb->first);
+    free(rb->body);
+    free(rb->px);
+    free(rb->py);
+    free(rb->m);
+    free(rb->mass);
+    free(rb->inertia);
+    free(rb->cs);
+    free(rb->sn);
+    free(rb->fx);
+    free(rb->fy);
+    free(rb->tq);
+    free(rb);
+}
+
+//
+// The vector field of the rigid bodies params (a rigid_bodies_t) in the
+// gravity of the central mass.
+//
+int de_rigid(sunrealtype t, N_Vector w, N_Vector f, void *params)
+{
+    rigid_bodies_t *rb = params;
+    int K = rb->num_bodies;
+    int n = rb->num_points;
+    const double *y = N_VGetArrayPointer(w);
+    double *fy = N_VGetArrayPointer(f);
+    const int *body = rb->body;
+    const double *px = rb->px, *py = rb->py, *m = rb->m;
+    double *cs = rb->cs, *sn = rb->sn;
+    double *pfx = rb->fx, *pfy = rb->fy, *ptq = rb->tq;
+    double g = rb->g;
+    int b, i;
+
+    for (b = 0; b < K; ++b) {
+        fy[3*b] = y[3*K + 3*b];
+        fy[3*b+1] = y[3*K + 3*b + 1];
+        fy[3*b+2] = y[3*K + 3*b + 2];
+        cs[b] = cos(y[3*b+2]);
+        sn[b] = sin(y[3*b+2]);
+    }
+
+    if (g > 0) {
+        // The gravity on each point, and its torque about the center of
+        // mass of its body.
+        #pragma omp simd
+        for (i = 0; i < n; ++i) {
+            int bi = body[i];
+            double dx = cs[bi]*px[i] - sn[bi]*py[i];
+            double dy = sn[bi]*px[i] + cs[bi]*py[i];
+            double xi = y[3*bi] + dx;
+            double yi = y[3*bi+1] + dy;
+            double rinv = 1.0/sqrt(xi*xi + yi*yi);
+            double gm = g*m[i]*rinv*rinv*rinv;
+
+            pfx[i] = -gm*xi;
+            pfy[i] = -gm*yi;
+            ptq[i] = dx*pfy[i] - dy*pfx[i];
+        }
+    }
+
+    for (b = 0; b < K; ++b) {
+        double Fx = 0.0, Fy = 0.0, T = 0.0;
+
+        if (g > 0) {
+            for (i = rb->first[b]; i < rb->first[b+1]; ++i) {
+                Fx += pfx[i];
+                Fy += pfy[i];
+                T += ptq[i];
+            }
+        }
+        fy[3*K + 3*b] = Fx/rb->mass[b];
+        fy[3*K + 3*b + 1] = Fy/rb->mass[b];
+        // (A body of a single point does not turn.)
+        fy[3*K + 3*b + 2] = rb->inertia[b] > 0 ? T/rb->inertia[b] : 0.0;
+    }
+    return 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
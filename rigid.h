@@ -0,0 +1,72 @@
+#ifndef _RIGID_H_
+#define _RIGID_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sundials/sundials_core.h>
+#include <nvector/nvector_serial.h>
+
+//
+// Any number of rigid bodies of point masses, of any shape, orbiting the
+// central mass (de_rigid_hex() is a single hexagon).  The bodies do not
+// interact.
+//
+// The layout of each body is given once, in its own frame; it is stored
+// relative to the center of mass, with the mass and the moment of inertia
+// of each body precomputed.  The state has the variables of
+// de_rigid_hex() for each body, positions first as in de():
+//
+//   w = [x_0, y_0, theta_0, x_1, y_1, theta_1, ...,
+//        u_0, v_0, omega_0, u_1, v_1, omega_1, ...]
+//
+// where (x_b, y_b) is the center of mass of body b, theta_b its angle and
+// (u_b, v_b, omega_b) their rates of change; 6*num_bodies in all.  For
+// one body with the points of hex_ics() (center at the origin) and unit
+// masses, de_rigid() is de_rigid_hex() to rounding (bench checks it).
+//
+// de_rigid() evaluates one cos and sin per body.  The gravity and torque
+// of each point are computed in one unit stride loop over the points of
+// all the bodies, which the compiler vectorizes, and then summed per body;
+// so the cost is proportional to the total number of points, with no trig
+// per point.
+//
+
+typedef struct _rigid_bodies {
+    int num_bodies;
+    /* total number of points */
+    int num_points;
+    /* the points of body b are first[b], ..., first[b+1]-1 */
+    int *first;
+    /* body of each point */
+    int *body;
+    /*
+     * Positions of the points in the frame of their body, relative to its
+     * center of mass, and their masses.
+     */
+    double *px, *py, *m;
+    /* Mass and moment of inertia about the center of mass of each body. */
+    double *mass, *inertia;
+    /* Gravity of the central mass, and its radius. */
+    double g, r0;
+    /*
+     * Work space of de_rigid(): cos and sin of each angle, and the force
+     * and torque of each point.  (So de_rigid() is not reentrant for the
+     * same bodies.)
+     */
+    double *cs, *sn;
+    double *fx, *fy, *tq;
+} rigid_bodies_t;
+
+rigid_bodies_t *rigid_bodies_create(int num_bodies, const int *num_points,
+                                    const double *points, const double *masses,
+                                    double g, double r0);
+void rigid_bodies_free(rigid_bodies_t *rb);
+int de_rigid(sunrealtype t, N_Vector w, N_Vector f, void *params);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,606 @@
+#include <sundials/sundials_core.h>     // Provides core SUNDIALS types
+#include <cvode/cvode.h>                // CVODE provides linear multistep methods
+#include <arkode/arkode_arkstep.h>      // ARKStep, for the IMEX method
+#include <nvector/nvector_serial.h>     // access to serial N_Vector
+#include <sunlinsol/sunlinsol_dense.h>  // access to dense SUNLinearSolver
+#include <sunmatrix/sunmatrix_dense.h>  // access to dense SUNMatrix
+#include <sunlinsol/sunlinsol_klu.h>    // access to KLU sparse direct solver
+#include <sunmatrix/sunmatrix_sparse.h> // access to sparse SUNMatrix
+#include <sunlinsol/sunlinsol_spgmr.h>  // access to SPGMR SUNLinearSolver
+#include <sunlinsol/sunlinsol_spfgmr.h> // access to SPFGMR SUNLinearSolver
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "de.h"
+#include "de_fixed.h"
+#include "de_jac.h"
+#include "de_parallel.h"
+#include "de_simd.h"
+#include "force_law.h"
+#include "solver.h"
+#include "stats.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// The right-hand side for params: de_parallel() if params->schedule has
+// been created (de_schedule_create()); otherwise de_simd() if
+// params->edges has been created (edge_soa_create()); otherwise the
+// unrolled de_tri() etc. if the topology is one of de_fixed.h; otherwise
+// de().  If params->stats has been created (stats_create()), it is timed by
+// stats_rhs().
+//
+CVRhsFn solver_rhs(xparams_t *params)
+{
+    CVRhsFn rhs;
+
+    if (params->schedule != NULL) {
+        rhs = de_parallel;
+    }
+    else if (params->edges != NULL) {
+        rhs = de_simd;
+    }
+    else if ((rhs = de_fixed_rhs(params)) == NULL) {
+        rhs = de;
+    }
+    if (params->stats != NULL) {
+        params->stats->rhs = rhs;
+        rhs = stats_rhs;
+    }
+    return rhs;
+}
+
+//
+// For the implicit part of SOLVER_IMEX: solver->springs, a copy of
+// params without the gravity (g = 0 and no bh), and the right-hand side
+// solver_rhs() selects for it, timed as solver_rhs() does.  Made by
+// solver_create(), and again by solver_reinit(), since the connections
+// and the Jacobian pattern may have changed.
+//
+static void springs_only(solver_t *solver)
+{
+    xparams_t *q = &solver->springs;
+
+    *q = *solver->params;
+    q->g = 0.0;
+    q->bh = NULL;
+    q->stats = NULL;
+    solver->springs_rhs = solver_rhs(q);
+    if (solver->params->stats != NULL) {
+        q->stats = solver->params->stats;
+        q->stats->rhs = solver->springs_rhs;
+        solver->springs_rhs = stats_rhs;
+    }
+}
+
+//
+// The callbacks of SOLVER_IMEX, whose user data is the solver: the
+// explicit part, the gravity; the implicit part, the springs and their
+// damping, and the Jacobian functions of the same terms, for
+// solver->springs; and the root function, for params.
+//
+static int imex_explicit(sunrealtype t, N_Vector w, N_Vector f, void *data)
+{
+    solver_t *solver = data;
+
+    return de_gravity(t, w, f, solver->params);
+}
+
+static int imex_implicit(sunrealtype t, N_Vector w, N_Vector f, void *data)
+{
+    solver_t *solver = data;
+
+    return solver->springs_rhs(t, w, f, &solver->springs);
+}
+
+static int imex_jac(sunrealtype t, N_Vector w, N_Vector fw, SUNMatrix J,
+                    void *data, N_Vector tmp1, N_Vector tmp2, N_Vector tmp3)
+{
+    solver_t *solver = data;
+
+    return de_jac(t, w, fw, J, &solver->springs, tmp1, tmp2, tmp3);
+}
+
+static int imex_jtimes(N_Vector v, N_Vector Jv, sunrealtype t, N_Vector w,
+                       N_Vector fw, void *data, N_Vector tmp)
+{
+    solver_t *solver = data;
+
+    return de_jtimes(v, Jv, t, w, fw, &solver->springs, tmp);
+}
+
+static int imex_psetup(sunrealtype t, N_Vector w, N_Vector fw, sunbooleantype jok,
+                       sunbooleantype *jcurPtr, sunrealtype gamma, void *data)
+{
+    solver_t *solver = data;
+
+    return de_psetup(t, w, fw, jok, jcurPtr, gamma, &solver->springs);
+}
+
+static int imex_psolve(sunrealtype t, N_Vector w, N_Vector fw, N_Vector r,
+                       N_Vector z, sunrealtype gamma, sunrealtype delta, int lr,
+                       void *data)
+{
+    solver_t *solver = data;
+
+    return de_psolve(t, w, fw, r, z, gamma, delta, lr, &solver->springs);
+}
+
+static int imex_roots(sunrealtype t, N_Vector w, sunrealtype *gout, void *data)
+{
+    solver_t *solver = data;
+
+    return solver->root_fn(t, w, gout, solver->params);
+}
+
+//
+// Create an integrator for de() with the given method (SOLVER_ADAMS,
+// SOLVER_BDF or SOLVER_IMEX) and linear solver (one of the LINSOL_*
+// constants).  params is the user data passed to de(), so it must
+// outlive the solver.  The right-hand side is the one solver_rhs()
+// selects (for SOLVER_IMEX, its implicit part, which works on a copy of
+// params; so a change of params takes effect at solver_reinit()).
+//
+// The caller sets the tolerances and any other options, with the
+// solver_*() functions or on solver->cvode_mem.  Returns NULL on failure,
+// also if params->force_law is not one of force_laws[] (which the
+// right-hand sides index without checking).
+//
+solver_t *solver_create(int method, int linsol, xparams_t *params,
+                        sunrealtype t0, N_Vector y0, SUNContext sunctx)
+{
+    solver_t *solver;
+    sunindextype n = 4*params->num_points;
+    CVRhsFn rhs;
+    int flag;
+    int imex = method == SOLVER_IMEX;
+
+    if (params->force_law < 0 || params->force_law >= NUM_FORCE_LAWS) {
+        fprintf(stderr, "solver_create: no force law %d\n", params->force_law);
+        return NULL;
+    }
+    solver = calloc(1, sizeof(solver_t));
+    if (solver == NULL) {
+        fprintf(stderr, "solver_create: out of memory\n");
+        return NULL;
+    }
+    solver->method = method;
+    solver->linsol = linsol;
+    solver->params = params;
+    solver->tn = t0;
+    solver->flag = CV_SUCCESS;
+    solver->yn = N_VClone(y0);
+    if (solver->yn == NULL) {
+        fprintf(stderr, "solver_create: out of memory\n");
+        goto fail;
+    }
+    N_VScale(SUN_RCONST(1.0), y0, solver->yn);
+
+    if (imex) {
+        solver->arkode_mem = ARKStepCreate(imex_explicit, imex_implicit, t0, y0,
+                                           sunctx);
+        if (solver->arkode_mem == NULL) {
+            fprintf(stderr, "ARKStepCreate() failed.\n");
+            goto fail;
+        }
+        flag = ARKodeSetUserData(solver->arkode_mem, solver);
+        if (flag != ARK_SUCCESS) {
+            fprintf(stderr, "ARKodeSetUserData() failed, flag=%d\n", flag);
+            goto fail;
+        }
+    }
+    else {
+        solver->cvode_mem = CVodeCreate(method == SOLVER_BDF ? CV_BDF : CV_ADAMS, sunctx);
+        if (solver->cvode_mem == NULL) {
+            fprintf(stderr, "CVodeCreate() failed.\n");
+            goto fail;
+        }
+        rhs = solver_rhs(params);
+        flag = CVodeInit(solver->cvode_mem, rhs, t0, y0);
+        if (flag != CV_SUCCESS) {
+            fprintf(stderr, "CVodeInit() failed, flag=%d\n", flag);
+            goto fail;
+        }
+        CVodeSetUserData(solver->cvode_mem, params);
+    }
+
+    if (linsol == LINSOL_KLU) {
+        // The sparsity pattern is built once, here.
+        params->jac_pattern = de_jac_pattern_create(params);
+        if (params->jac_pattern == NULL) {
+            goto fail;
+        }
+        solver->A = de_jac_matrix(params->jac_pattern, sunctx);
+        if (solver->A == NULL) {
+            fprintf(stderr, "SUNSparseMatrix() failed.\n");
+            goto fail;
+        }
+        solver->LS = SUNLinSol_KLU(y0, solver->A, sunctx);
+        if (solver->LS == NULL) {
+            fprintf(stderr, "SUNLinSol_KLU() failed.\n");
+            goto fail;
+        }
+    }
+    else if (linsol == LINSOL_SPGMR || linsol == LINSOL_SPFGMR) {
+        // Matrix-free: no SUNMatrix, only the per-point blocks of the
+        // preconditioner.
+        params->prec = de_prec_create(params->num_points);
+        if (params->prec == NULL) {
+            goto fail;
+        }
+        if (linsol == LINSOL_SPGMR) {
+            solver->LS = SUNLinSol_SPGMR(y0, SUN_PREC_LEFT, KRYLOV_MAXL, sunctx);
+        }
+        else {
+            solver->LS = SUNLinSol_SPFGMR(y0, SUN_PREC_RIGHT, KRYLOV_MAXL, sunctx);
+        }
+        if (solver->LS == NULL) {
+            fprintf(stderr, "SUNLinSol_SP(F)GMR() failed.\n");
+            goto fail;
+        }
+    }
+    else {
+        solver->A = SUNDenseMatrix(n, n, sunctx);
+        if (solver->A == NULL) {
+            fprintf(stderr, "SUNDenseMatrix() failed.\n");
+            goto fail;
+        }
+        solver->LS = SUNLinSol_Dense(y0, solver->A, sunctx);
+        if (solver->LS == NULL) {
+            fprintf(stderr, "SUNLinSol_Dense() failed.\n");
+            goto fail;
+        }
+    }
+
+    if (imex) {
+        flag = ARKodeSetLinearSolver(solver->arkode_mem, solver->LS, solver->A);
+        if (flag != ARK_SUCCESS) {
+            fprintf(stderr, "ARKodeSetLinearSolver() failed, flag=%d\n", flag);
+            goto fail;
+        }
+        if (linsol == LINSOL_KLU) {
+            flag = ARKodeSetJacFn(solver->arkode_mem, imex_jac);
+        }
+        else if (linsol == LINSOL_SPGMR || linsol == LINSOL_SPFGMR) {
+            flag = ARKodeSetJacTimes(solver->arkode_mem, NULL, imex_jtimes);
+            if (flag == ARK_SUCCESS) {
+                flag = ARKodeSetPreconditioner(solver->arkode_mem, imex_psetup,
+                                               imex_psolve);
+            }
+        }
+        if (flag != ARK_SUCCESS) {
+            fprintf(stderr, "solver_create: setting the Jacobian failed, flag=%d\n",
+                    flag);
+            goto fail;
+        }
+        // After the Jacobian pattern or preconditioner has been created.
+        springs_only(solver);
+        return solver;
+    }
+
+    flag = CVodeSetLinearSolver(solver->cvode_mem, solver->LS, solver->A);
+    if (flag != CV_SUCCESS) {
+        fprintf(stderr, "CVodeSetLinearSolver() failed, flag=%d\n", flag);
+        goto fail;
+    }
+    if (linsol == LINSOL_KLU) {
+        flag = CVodeSetJacFn(solver->cvode_mem, de_jac);
+        if (flag != CV_SUCCESS) {
+            fprintf(stderr, "CVodeSetJacFn() failed, flag=%d\n", flag);
+            goto fail;
+        }
+    }
+    else if (linsol == LINSOL_DENSE && de_fixed_jac(params) != NULL) {
+        // The analytic Jacobian of the small fixed systems, in place of
+        // difference quotients.
+        flag = CVodeSetJacFn(solver->cvode_mem, de_fixed_jac(params));
+        if (flag != CV_SUCCESS) {
+            fprintf(stderr, "CVodeSetJacFn() failed, flag=%d\n", flag);
+            goto fail;
+        }
+    }
+    else if (linsol == LINSOL_SPGMR || linsol == LINSOL_SPFGMR) {
+        flag = CVodeSetJacTimes(solver->cvode_mem, NULL, de_jtimes);
+        if (flag != CV_SUCCESS) {
+            fprintf(stderr, "CVodeSetJacTimes() failed, flag=%d\n", flag);
+            goto fail;
+        }
+        flag = CVodeSetPreconditioner(solver->cvode_mem, de_psetup, de_psolve);
+        if (flag != CV_SUCCESS) {
+            fprintf(stderr, "CVodeSetPreconditioner() failed, flag=%d\n", flag);
+            goto fail;
+        }
+    }
+
+    return solver;
+
+fail:
+    solver_free(&solver);
+    return NULL;
+}
+
+void solver_free(solver_t **solver)
+{
+    solver_t *s = *solver;
+
+    if (s == NULL) {
+        return;
+    }
+    if (s->cvode_mem != NULL) {
+        CVodeFree(&s->cvode_mem);
+    }
+    if (s->arkode_mem != NULL) {
+        ARKodeFree(&s->arkode_mem);
+    }
+    if (s->LS != NULL) {
+        SUNLinSolFree(s->LS);
+    }
+    if (s->A != NULL) {
+        SUNMatDestroy(s->A);
+    }
+    if (s->yn != NULL) {
+        N_VDestroy(s->yn);
+    }
+    if (s->params->jac_pattern != NULL) {
+        de_jac_pattern_free(s->params->jac_pattern);
+        s->params->jac_pattern = NULL;
+    }
+    if (s->params->prec != NULL) {
+        de_prec_free(s->params->prec);
+        s->params->prec = NULL;
+    }
+    free(s);
+    *solver = NULL;
+}
+
+//
+// The options and the integration, for either integrator.  The return
+// values are CVODE's; ARKODE's are the same (ARK_SUCCESS, ARK_ROOT_RETURN
+// and so on).
+//
+int solver_tolerances(solver_t *solver, sunrealtype rtol, sunrealtype atol)
+{
+    if (solver->arkode_mem != NULL) {
+        return ARKodeSStolerances(solver->arkode_mem, rtol, atol);
+    }
+    return CVodeSStolerances(solver->cvode_mem, rtol, atol);
+}
+
+int solver_set_max_num_steps(solver_t *solver, long mxsteps)
+{
+    if (solver->arkode_mem != NULL) {
+        return ARKodeSetMaxNumSteps(solver->arkode_mem, mxsteps);
+    }
+    return CVodeSetMaxNumSteps(solver->cvode_mem, mxsteps);
+}
+
+int solver_set_stop_time(solver_t *solver, sunrealtype tstop)
+{
+    if (solver->arkode_mem != NULL) {
+        return ARKodeSetStopTime(solver->arkode_mem, tstop);
+    }
+    return CVodeSetStopTime(solver->cvode_mem, tstop);
+}
+
+//
+// The step size to try first, after solver_create() or solver_reinit().
+//
+int solver_set_init_step(solver_t *solver, sunrealtype h)
+{
+    if (solver->arkode_mem != NULL) {
+        return ARKodeSetInitStep(solver->arkode_mem, h);
+    }
+    return CVodeSetInitStep(solver->cvode_mem, h);
+}
+
+int solver_get_current_step(solver_t *solver, sunrealtype *h)
+{
+    if (solver->arkode_mem != NULL) {
+        return ARKodeGetCurrentStep(solver->arkode_mem, h);
+    }
+    return CVodeGetCurrentStep(solver->cvode_mem, h);
+}
+
+//
+// The k-th derivative at t, within the last step, of the interpolating
+// polynomial of the integrator.  CVODE has the derivatives up to the
+// order of the last step (its Nordsieck array holds h^k/k! times them);
+// a larger k fails.
+//
+int solver_get_dky(solver_t *solver, sunrealtype t, int k, N_Vector dky)
+{
+    if (solver->arkode_mem != NULL) {
+        return ARKodeGetDky(solver->arkode_mem, t, k, dky);
+    }
+    return CVodeGetDky(solver->cvode_mem, t, k, dky);
+}
+
+int solver_root_init(solver_t *solver, int nrtfn, CVRootFn g)
+{
+    if (solver->arkode_mem != NULL) {
+        solver->root_fn = g;
+        return ARKodeRootInit(solver->arkode_mem, nrtfn, g != NULL ? imex_roots : NULL);
+    }
+    return CVodeRootInit(solver->cvode_mem, nrtfn, g);
+}
+
+//
+// After a root return, which of the nrtfn roots of solver_root_init()
+// were found: rootsfound[i] is 1 or -1 if root i crossed zero increasing
+// or decreasing, 0 if not (as CVodeGetRootInfo()).
+//
+int solver_get_root_info(solver_t *solver, int *rootsfound)
+{
+    if (solver->arkode_mem != NULL) {
+        return ARKodeGetRootInfo(solver->arkode_mem, rootsfound);
+    }
+    return CVodeGetRootInfo(solver->cvode_mem, rootsfound);
+}
+
+//
+// Restart the integration at (t, y), after the connections have changed
+// (bonds.h).  The integrator keeps its options, root functions and linear
+// solver, and starts with the step size it had reached, so the cost is
+// that of a few steps at first order rather than of a new integrator.
+// With LINSOL_KLU, a stale Jacobian pattern is created again, the matrix
+// grows to fit it, and KLU analyzes its new structure.  Returns CV_SUCCESS
+// or a negative flag.
+//
+int solver_reinit(solver_t *solver, sunrealtype t, N_Vector y)
+{
+    xparams_t *params = solver->params;
+    sunrealtype hcur;
+    int flag;
+
+    if (params->jac_pattern != NULL && params->jac_pattern->stale) {
+        de_jac_pattern_t *pattern = de_jac_pattern_create(params);
+
+        if (pattern == NULL) {
+            return CV_MEM_FAIL;
+        }
+        de_jac_pattern_free(params->jac_pattern);
+        params->jac_pattern = pattern;
+        if (SM_NNZ_S(solver->A) < pattern->nnz) {
+            flag = SUNSparseMatrix_Reallocate(solver->A, pattern->nnz);
+            if (flag != SUN_SUCCESS) {
+                fprintf(stderr, "SUNSparseMatrix_Reallocate() failed, flag=%d\n", flag);
+                return CV_MEM_FAIL;
+            }
+        }
+        flag = SUNLinSol_KLUReInit(solver->LS, solver->A, SM_NNZ_S(solver->A),
+                                   SUNKLU_REINIT_PARTIAL);
+        if (flag != SUN_SUCCESS) {
+            fprintf(stderr, "SUNLinSol_KLUReInit() failed, flag=%d\n", flag);
+            return CV_LSETUP_FAIL;
+        }
+    }
+
+    if (solver->arkode_mem != NULL) {
+        springs_only(solver);
+        if (ARKodeGetCurrentStep(solver->arkode_mem, &hcur) == ARK_SUCCESS) {
+            ARKodeSetInitStep(solver->arkode_mem, hcur);
+        }
+        flag = ARKodeReset(solver->arkode_mem, t, y);
+    }
+    else {
+        if (CVodeGetCurrentStep(solver->cvode_mem, &hcur) == CV_SUCCESS) {
+            CVodeSetInitStep(solver->cvode_mem, hcur);
+        }
+        flag = CVodeReInit(solver->cvode_mem, t, y);
+    }
+    if (flag != CV_SUCCESS) {
+        fprintf(stderr, "solver_reinit: the restart failed, flag=%d\n", flag);
+        return flag;
+    }
+    solver->tn = t;
+    solver->flag = CV_SUCCESS;
+    N_VScale(SUN_RCONST(1.0), y, solver->yn);
+    return CV_SUCCESS;
+}
+
+//
+// As CVode(..., tout, y, t, CV_NORMAL).
+//
+int solver_evolve(solver_t *solver, sunrealtype tout, N_Vector y, sunrealtype *t)
+{
+    if (solver->arkode_mem != NULL) {
+        return ARKodeEvolve(solver->arkode_mem, tout, y, t, ARK_NORMAL);
+    }
+    return CVode(solver->cvode_mem, tout, y, t, CV_NORMAL);
+}
+
+int solver_get_num_steps(solver_t *solver, long *nsteps)
+{
+    if (solver->arkode_mem != NULL) {
+        return ARKodeGetNumSteps(solver->arkode_mem, nsteps);
+    }
+    return CVodeGetNumSteps(solver->cvode_mem, nsteps);
+}
+
+int solver_get_num_g_evals(solver_t *solver, long *ngevals)
+{
+    if (solver->arkode_mem != NULL) {
+        return ARKodeGetNumGEvals(solver->arkode_mem, ngevals);
+    }
+    return CVodeGetNumGEvals(solver->cvode_mem, ngevals);
+}
+
+//
+// The number of evaluations of the right-hand side; for SOLVER_IMEX, of
+// its implicit part (the springs, partition 1 of ARKStep), which are the
+// expensive ones.
+//
+int solver_get_num_rhs_evals(solver_t *solver, long *nfevals)
+{
+    if (solver->arkode_mem != NULL) {
+        return ARKodeGetNumRhsEvals(solver->arkode_mem, 1, nfevals);
+    }
+    return CVodeGetNumRhsEvals(solver->cvode_mem, nfevals);
+}
+
+//
+// Dense output: the solution y at time tout, interpolated (CVodeGetDky())
+// from the internal steps of the integrator.  The steps are taken one at
+// a time (CV_ONE_STEP), at the step size the error control chooses, and
+// only when tout lies beyond the last one; so any number of output times
+// within a step cost no step and no evaluation of the right-hand side.
+// The output times must increase, and the integrator must not be
+// advanced by calling CVode() (or solver_evolve()) directly as well.
+//
+// Returns what CVode(..., tout, y, t, CV_NORMAL) would: CV_SUCCESS with
+// *t = tout; CV_ROOT_RETURN with the solution at the root; CV_TSTOP_RETURN
+// with the solution at the stop time if tout lies beyond it; or a
+// negative flag on failure.
+//
+int solver_dense(solver_t *solver, sunrealtype tout, N_Vector y, sunrealtype *t)
+{
+    int flag;
+
+    for (;;) {
+        if (solver->flag == CV_ROOT_RETURN && solver->tn <= tout) {
+            // A root, possibly found by the step for an earlier tout.
+            solver->flag = CV_SUCCESS;
+            N_VScale(SUN_RCONST(1.0), solver->yn, y);
+            *t = solver->tn;
+            return CV_ROOT_RETURN;
+        }
+        if (solver->tn >= tout) {
+            break;
+        }
+        if (solver->flag == CV_TSTOP_RETURN) {
+            // No steps beyond the stop time.
+            N_VScale(SUN_RCONST(1.0), solver->yn, y);
+            *t = solver->tn;
+            return CV_TSTOP_RETURN;
+        }
+        if (solver->arkode_mem != NULL) {
+            flag = ARKodeEvolve(solver->arkode_mem, tout, solver->yn, &solver->tn,
+                                ARK_ONE_STEP);
+        }
+        else {
+            flag = CVode(solver->cvode_mem, tout, solver->yn, &solver->tn, CV_ONE_STEP);
+        }
+        solver->flag = flag;
+        if (flag < 0) {
+            return flag;
+        }
+    }
+    if (solver->arkode_mem != NULL) {
+        flag = ARKodeGetDky(solver->arkode_mem, tout, 0, y);
+    }
+    else {
+        flag = CVodeGetDky(solver->cvode_mem, tout, 0, y);
+    }
+    if (flag != CV_SUCCESS) {
+        return flag;
+    }
+    *t = tout;
+    return solver->flag == CV_TSTOP_RETURN && solver->tn == tout ?
+           CV_TSTOP_RETURN : CV_SUCCESS;
+}
+
+#ifdef __cplusplus
+}
+#endif
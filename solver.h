@@ -0,0 +1,105 @@
+#ifndef _SOLVER_H_
+#define _SOLVER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sundials/sundials_core.h>
+#include <cvode/cvode.h>
+#include <arkode/arkode.h>
+#include <nvector/nvector_serial.h>
+
+#include "de.h"
+
+//
+// Choice of method: CVODE's linear multistep methods, or an additive
+// Runge-Kutta method of ARKODE's ARKStep (SUNDIALS >= 7.1) with de()
+// split into an implicit part, the springs and their damping, and an
+// explicit part, the gravity (de_gravity()).  With SOLVER_IMEX, the
+// Newton iteration and the Jacobian (of any of the linear solvers) only
+// involve the springs.
+//
+#define SOLVER_ADAMS 0
+#define SOLVER_BDF   1
+#define SOLVER_IMEX  2
+
+//
+// Choice of linear solver for the Newton iteration.
+//
+//   LINSOL_DENSE:  dense 4N x 4N matrix, finite difference Jacobian
+//                  (analytic for the systems of de_fixed.h, with CVODE).
+//   LINSOL_KLU:    CSR matrix with the analytic Jacobian de_jac(),
+//                  factored with KLU.
+//   LINSOL_SPGMR:  matrix-free GMRES with the Jacobian-vector product
+//                  de_jtimes() and the block diagonal preconditioner
+//                  de_psetup()/de_psolve() (left preconditioning).
+//   LINSOL_SPFGMR: as LINSOL_SPGMR, but flexible GMRES (right
+//                  preconditioning).
+//
+#define LINSOL_DENSE  0
+#define LINSOL_KLU    1
+#define LINSOL_SPGMR  2
+#define LINSOL_SPFGMR 3
+
+//
+// Maximum Krylov subspace dimension for LINSOL_SPGMR and LINSOL_SPFGMR.
+//
+#define KRYLOV_MAXL 20
+
+//
+// A CVODE (or ARKStep) integrator for the vector field de(), together
+// with the matrix and linear solver attached to it.  The solver_*()
+// functions below apply to either; CVODE's own functions apply to
+// cvode_mem, which is NULL for SOLVER_IMEX.
+//
+typedef struct _solver {
+    int method;
+    int linsol;
+    xparams_t *params;
+    void *cvode_mem;
+    /* For SOLVER_IMEX, the ARKStep integrator; NULL otherwise. */
+    void *arkode_mem;
+    SUNMatrix A;
+    SUNLinearSolver LS;
+    /*
+     * For solver_dense(): the time and solution returned by the last
+     * internal step, and its flag.
+     */
+    sunrealtype tn;
+    N_Vector yn;
+    int flag;
+    /*
+     * For SOLVER_IMEX, whose callbacks get the solver as user data: a
+     * copy of params without the gravity, for the implicit part, and its
+     * right-hand side; and the root function of solver_root_init().
+     */
+    xparams_t springs;
+    CVRhsFn springs_rhs;
+    CVRootFn root_fn;
+} solver_t;
+
+CVRhsFn solver_rhs(xparams_t *params);
+solver_t *solver_create(int method, int linsol, xparams_t *params,
+                        sunrealtype t0, N_Vector y0, SUNContext sunctx);
+void solver_free(solver_t **solver);
+int solver_tolerances(solver_t *solver, sunrealtype rtol, sunrealtype atol);
+int solver_set_max_num_steps(solver_t *solver, long mxsteps);
+int solver_set_stop_time(solver_t *solver, sunrealtype tstop);
+int solver_set_init_step(solver_t *solver, sunrealtype h);
+int solver_get_current_step(solver_t *solver, sunrealtype *h);
+int solver_get_dky(solver_t *solver, sunrealtype t, int k, N_Vector dky);
+int solver_root_init(solver_t *solver, int nrtfn, CVRootFn g);
+int solver_get_root_info(solver_t *solver, int *rootsfound);
+int solver_reinit(solver_t *solver, sunrealtype t, N_Vector y);
+int solver_evolve(solver_t *solver, sunrealtype tout, N_Vector y, sunrealtype *t);
+int solver_dense(solver_t *solver, sunrealtype tout, N_Vector y, sunrealtype *t);
+int solver_get_num_steps(solver_t *solver, long *nsteps);
+int solver_get_num_g_evals(solver_t *solver, long *ngevals);
+int solver_get_num_rhs_evals(solver_t *solver, long *nfevals);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
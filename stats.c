@@ -0,0 +1,161 @@
+#include <sundials/sundials_core.h>     // Provides core SUNDIALS types
+#include <cvode/cvode.h>                // CVODE provides linear multistep methods
+#include <nvector/nvector_serial.h>     // access to serial N_Vector
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "contact.h"
+#include "de.h"
+#include "stats.h"
+#include "timer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static const char *csv_header =
+    "t,wall,nsteps,nfevals,nlinsetups,netfails,ngevals,hlast,hcur,"
+    "rhs_calls,rhs_time,root_calls,root_time\n";
+
+//
+// Create the statistics.  If filename is not NULL, the records passed to
+// stats_write() are written to it, as JSON if the name ends with ".json"
+// and as CSV otherwise.  Returns NULL on failure.
+//
+de_stats_t *stats_create(const char *filename)
+{
+    de_stats_t *stats;
+
+    stats = calloc(1, sizeof(de_stats_t));
+    if (stats == NULL) {
+        fprintf(stderr, "stats_create: out of memory\n");
+        return NULL;
+    }
+    stats->rhs = de;
+    stats->start = timer_now();
+    if (filename != NULL) {
+        size_t len = strlen(filename);
+        stats->fp = fopen(filename, "w");
+        if (stats->fp == NULL) {
+            fprintf(stderr, "stats_create: cannot open %s\n", filename);
+            free(stats);
+            return NULL;
+        }
+        if (len >= 5 && strcmp(filename + len - 5, ".json") == 0) {
+            stats->format = STATS_JSON;
+            fprintf(stats->fp, "[\n");
+        }
+        else {
+            stats->format = STATS_CSV;
+            fputs(csv_header, stats->fp);
+        }
+    }
+    return stats;
+}
+
+void stats_free(de_stats_t *stats)
+{
+    if (stats == NULL) {
+        return;
+    }
+    if (stats->fp != NULL) {
+        if (stats->format == STATS_JSON) {
+            fprintf(stats->fp, "\n]\n");
+        }
+        fclose(stats->fp);
+    }
+    free(stats);
+}
+
+//
+// The right-hand side stats->rhs, timed.  params is the xparams_t.
+//
+int stats_rhs(sunrealtype t, N_Vector w, N_Vector f, void *params)
+{
+    de_stats_t *stats = ((xparams_t *) params)->stats;
+    double start = timer_now();
+    int retval;
+
+    retval = stats->rhs(t, w, f, params);
+    stats->rhs_time += timer_now() - start;
+    ++stats->rhs_calls;
+    return retval;
+}
+
+//
+// contact_roots(), timed.
+//
+int stats_contact_roots(sunrealtype t, N_Vector w, sunrealtype *gout, void *params)
+{
+    de_stats_t *stats = ((xparams_t *) params)->stats;
+    double start = timer_now();
+    int retval;
+
+    retval = contact_roots(t, w, gout, params);
+    stats->root_time += timer_now() - start;
+    ++stats->root_calls;
+    return retval;
+}
+
+//
+// Collect the statistics of the integrator cvode_mem, whose solution is
+// at time t.  Returns 0, or the first failing CVODE flag.
+//
+int stats_sample(de_stats_t *stats, void *cvode_mem, sunrealtype t,
+                 stats_record_t *rec)
+{
+    int flag;
+
+    memset(rec, 0, sizeof(stats_record_t));
+    rec->t = t;
+    rec->wall = timer_now() - stats->start;
+    if ((flag = CVodeGetNumSteps(cvode_mem, &rec->nsteps)) != CV_SUCCESS ||
+            (flag = CVodeGetNumRhsEvals(cvode_mem, &rec->nfevals)) != CV_SUCCESS ||
+            (flag = CVodeGetNumLinSolvSetups(cvode_mem, &rec->nlinsetups)) != CV_SUCCESS ||
+            (flag = CVodeGetNumErrTestFails(cvode_mem, &rec->netfails)) != CV_SUCCESS ||
+            (flag = CVodeGetNumGEvals(cvode_mem, &rec->ngevals)) != CV_SUCCESS ||
+            (flag = CVodeGetLastStep(cvode_mem, &rec->hlast)) != CV_SUCCESS ||
+            (flag = CVodeGetCurrentStep(cvode_mem, &rec->hcur)) != CV_SUCCESS) {
+        return flag;
+    }
+    rec->rhs_calls = stats->rhs_calls;
+    rec->rhs_time = stats->rhs_time;
+    rec->root_calls = stats->root_calls;
+    rec->root_time = stats->root_time;
+    return 0;
+}
+
+//
+// Append a record to the time series file (if there is one).
+//
+void stats_write(de_stats_t *stats, const stats_record_t *rec)
+{
+    if (stats->fp == NULL) {
+        return;
+    }
+    if (stats->format == STATS_JSON) {
+        fprintf(stats->fp,
+                "%s  {\"t\": %.10g, \"wall\": %.6f, \"nsteps\": %ld, "
+                "\"nfevals\": %ld, \"nlinsetups\": %ld, \"netfails\": %ld, "
+                "\"ngevals\": %ld, \"hlast\": %.6e, \"hcur\": %.6e, "
+                "\"rhs_calls\": %ld, \"rhs_time\": %.6e, "
+                "\"root_calls\": %ld, \"root_time\": %.6e}",
+                stats->num_records > 0 ? ",\n" : "",
+                rec->t, rec->wall, rec->nsteps, rec->nfevals, rec->nlinsetups,
+                rec->netfails, rec->ngevals, rec->hlast, rec->hcur,
+                rec->rhs_calls, rec->rhs_time, rec->root_calls, rec->root_time);
+    }
+    else {
+        fprintf(stats->fp,
+                "%.10g,%.6f,%ld,%ld,%ld,%ld,%ld,%.6e,%.6e,%ld,%.6e,%ld,%.6e\n",
+                rec->t, rec->wall, rec->nsteps, rec->nfevals, rec->nlinsetups,
+                rec->netfails, rec->ngevals, rec->hlast, rec->hcur,
+                rec->rhs_calls, rec->rhs_time, rec->root_calls, rec->root_time);
+    }
+    ++stats->num_records;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,75 @@
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include <sundials/sundials_core.h>
+#include <nvector/nvector_serial.h>
+
+//
+// Run statistics: the counters of the CVODE integrator, and the calls of
+// and the wall time spent in the right-hand side and the root function.
+//
+// The timing is enabled by setting the stats field of the xparams_t to a
+// de_stats_t created with stats_create().  solver_create() then installs
+// stats_rhs() as the right-hand side, which times the one it would have
+// used; stats_contact_roots() is the timed version of contact_roots()
+// (contact.h).  At each frame or output interval, stats_sample() collects
+// a stats_record_t, and stats_write() appends it to the time series file.
+//
+
+// Formats of the time series file.
+#define STATS_CSV  0
+#define STATS_JSON 1
+
+typedef struct _de_stats {
+    /* The right-hand side that stats_rhs() times. */
+    int (*rhs)(sunrealtype t, N_Vector w, N_Vector f, void *params);
+    long rhs_calls;
+    double rhs_time;
+    long root_calls;
+    double root_time;
+    /* Wall clock time at stats_create(). */
+    double start;
+    /* Time series file (NULL for none), its format and number of records. */
+    FILE *fp;
+    int format;
+    long num_records;
+} de_stats_t;
+
+typedef struct _stats_record {
+    /* Time of the solution, and wall time since stats_create(). */
+    double t;
+    double wall;
+    /* CVODE counters. */
+    long nsteps;
+    long nfevals;
+    long nlinsetups;
+    long netfails;
+    long ngevals;
+    /* Step size of the last step, and to be tried on the next step. */
+    double hlast;
+    double hcur;
+    /* Calls of, and wall time in, the right-hand side and root function. */
+    long rhs_calls;
+    double rhs_time;
+    long root_calls;
+    double root_time;
+} stats_record_t;
+
+de_stats_t *stats_create(const char *filename);
+void stats_free(de_stats_t *stats);
+int stats_rhs(sunrealtype t, N_Vector w, N_Vector f, void *params);
+int stats_contact_roots(sunrealtype t, N_Vector w, sunrealtype *gout, void *params);
+int stats_sample(de_stats_t *stats, void *cvode_mem, sunrealtype t,
+                 stats_record_t *rec);
+void stats_write(de_stats_t *stats, const stats_record_t *rec);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,395 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "de.h"
+#include "symplectic.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// Weights of the Verlet stages.  Yoshida's 4th order method is the
+// "triple jump" x1, x0, x1 with x1 = 1/(2 - 2**(1/3)) and
+// x0 = 1 - 2*x1; the 6th order weights are his solution A.
+//
+static const double verlet_weights[1] = {1.0};
+
+static const double yoshida4_weights[3] = {
+    1.3512071919596578, -1.7024143839193153, 1.3512071919596578
+};
+
+static const double yoshida6_weights[7] = {
+    0.784513610477560, 0.235573213359357, -1.17767998417887,
+    1.315186320683906,
+    -1.17767998417887, 0.235573213359357, 0.784513610477560
+};
+
+int symplectic_method(const char *name)
+{
+    if (strcmp(name, "verlet") == 0) {
+        return SYMPLECTIC_VERLET;
+    }
+    if (strcmp(name, "yoshida4") == 0) {
+        return SYMPLECTIC_YOSHIDA4;
+    }
+    if (strcmp(name, "yoshida6") == 0) {
+        return SYMPLECTIC_YOSHIDA6;
+    }
+    return -1;
+}
+
+//
+// The part of symplectic_create() and symplectic_create_rigid_hex() that
+// does not depend on the system.
+//
+static symplectic_t *create(int method, double h, int num_roots,
+                            sunrealtype t0, N_Vector y0)
+{
+    symplectic_t *s;
+
+    s = calloc(1, sizeof(symplectic_t));
+    if (s == NULL) {
+        goto fail;
+    }
+    s->method = method;
+    if (method == SYMPLECTIC_YOSHIDA6) {
+        s->num_stages = 7;
+        s->weights = yoshida6_weights;
+    }
+    else if (method == SYMPLECTIC_YOSHIDA4) {
+        s->num_stages = 3;
+        s->weights = yoshida4_weights;
+    }
+    else {
+        s->num_stages = 1;
+        s->weights = verlet_weights;
+    }
+    s->h = h;
+    s->num_roots = num_roots;
+    s->t = t0;
+    s->y = N_VClone(y0);
+    s->y0 = N_VClone(y0);
+    s->f = N_VClone(y0);
+    s->g0 = malloc(num_roots * sizeof(double));
+    s->g1 = malloc(num_roots * sizeof(double));
+    if (s->y == NULL || s->y0 == NULL || s->f == NULL ||
+            s->g0 == NULL || s->g1 == NULL) {
+        goto fail;
+    }
+    N_VScale(1.0, y0, s->y);
+    s->root_index = -1;
+    return s;
+
+fail:
+    fprintf(stderr, "symplectic_create: out of memory\n");
+    symplectic_free(&s);
+    return NULL;
+}
+
+//
+// Create an integrator with step size h for the points connected by
+// springs described by params (which must outlive it), starting from y0
+// at t0.  rhs is the right-hand side for params, solver_rhs(params) for
+// the same accelerations as CVODE.
+//
+symplectic_t *symplectic_create(int method, double h, xparams_t *params,
+                                CVRhsFn rhs, sunrealtype t0, N_Vector y0)
+{
+    symplectic_t *s;
+
+    s = create(method, h, params->num_points, t0, y0);
+    if (s == NULL) {
+        return NULL;
+    }
+    s->params = params;
+    s->conservative = *params;
+    s->conservative.b = 0.0;
+    s->rhs = rhs;
+    return s;
+}
+
+//
+// As symplectic_create(), for the rigid hexagon of de_rigid_hex().
+//
+symplectic_t *symplectic_create_rigid_hex(int method, double h,
+                                          rigid_hex_params_t *params,
+                                          sunrealtype t0, N_Vector y0)
+{
+    symplectic_t *s;
+
+    s = create(method, h, HEX_NUM_POINTS, t0, y0);
+    if (s == NULL) {
+        return NULL;
+    }
+    s->hex_params = params;
+    s->rhs = de_rigid_hex;
+    return s;
+}
+
+void symplectic_free(symplectic_t **s)
+{
+    symplectic_t *p = *s;
+
+    if (p == NULL) {
+        return;
+    }
+    if (p->y != NULL) {
+        N_VDestroy(p->y);
+    }
+    if (p->y0 != NULL) {
+        N_VDestroy(p->y0);
+    }
+    if (p->f != NULL) {
+        N_VDestroy(p->f);
+    }
+    free(p->g0);
+    free(p->g1);
+    free(p);
+    *s = NULL;
+}
+
+//
+// Make s->f hold the accelerations at the positions of y.
+//
+static int accelerations(symplectic_t *s, N_Vector y)
+{
+    int retval;
+
+    if (s->f_at == y) {
+        return 0;
+    }
+    if (s->params != NULL) {
+        retval = s->rhs(s->t, y, s->f, &s->conservative);
+    }
+    else {
+        retval = s->rhs(s->t, y, s->f, s->hex_params);
+    }
+    ++s->nfevals;
+    s->f_at = retval == 0 ? y : NULL;
+    return retval;
+}
+
+//
+// The damping of the springs over a time tau, spring by spring, in the
+// order of the connections (forward) or in the reverse order.
+//
+static void damp(symplectic_t *s, N_Vector y, double tau, int forward)
+{
+    int n = s->params->num_points;
+    double *w = N_VGetArrayPointer(y);
+    double *v = w + 2*n;
+    double decay = exp(-2*s->params->b*tau);
+    int k, idx;
+
+    for (k = 0; k < s->params->num_connections; ++k) {
+        int i, j;
+        double ux, uy, dist, ds;
+
+        idx = forward ? k : s->params->num_connections - 1 - k;
+        i = s->params->connections[2*idx];
+        j = s->params->connections[2*idx + 1];
+        ux = w[2*j] - w[2*i];
+        uy = w[2*j+1] - w[2*i+1];
+        dist = hypot(ux, uy);
+        ux /= dist;
+        uy /= dist;
+        // The rate of change of the length decays; half of the change
+        // goes to each point.
+        ds = 0.5*(decay - 1)*((v[2*j] - v[2*i])*ux + (v[2*j+1] - v[2*i+1])*uy);
+        v[2*i]   -= ds*ux;
+        v[2*i+1] -= ds*uy;
+        v[2*j]   += ds*ux;
+        v[2*j+1] += ds*uy;
+    }
+}
+
+//
+// One step of size tau from y, in place.  The state is [q, p] with m
+// values each, and the accelerations are the second half of the
+// right-hand side.  Each stage is symmetric, so the composition has the
+// order of its weights with damping too.  (A stage with a negative
+// weight runs the damping backwards, which is harmless for small steps.)
+//
+static int step(symplectic_t *s, N_Vector y, double tau)
+{
+    int m = NV_LENGTH_S(y)/2;
+    double *q = N_VGetArrayPointer(y);
+    double *p = q + m;
+    double *a = N_VGetArrayPointer(s->f) + m;
+    int damping = s->params != NULL && s->params->b != 0.0;
+    int k, i;
+
+    for (k = 0; k < s->num_stages; ++k) {
+        double c = s->weights[k]*tau;
+
+        // Damp, kick, drift, kick, damp: a symmetric stage.
+        if (damping) {
+            damp(s, y, 0.5*c, 1);
+        }
+        if (accelerations(s, y) != 0) {
+            return -1;
+        }
+        for (i = 0; i < m; ++i) {
+            p[i] += 0.5*c*a[i];
+        }
+        for (i = 0; i < m; ++i) {
+            q[i] += c*p[i];
+        }
+        s->f_at = NULL;
+        if (accelerations(s, y) != 0) {
+            return -1;
+        }
+        for (i = 0; i < m; ++i) {
+            p[i] += 0.5*c*a[i];
+        }
+        if (damping) {
+            damp(s, y, 0.5*c, 0);
+        }
+    }
+    return 0;
+}
+
+//
+// r - r0 of each point (the values of collision()).  The points of the
+// rigid hexagon are the corners at angles theta + i*pi/3 and the center,
+// as drawn by animate_dynamics_rigid_hex.
+//
+static void gaps(symplectic_t *s, N_Vector y, double *g)
+{
+    const double *w = N_VGetArrayPointer(y);
+    int i;
+
+    if (s->params != NULL) {
+        collision(s->t, y, g, s->params);
+        return;
+    }
+    for (i = 0; i < HEX_NUM_POINTS; ++i) {
+        double x = w[0], yy = w[1];
+        if (i < 6) {
+            x += s->hex_params->L*cos(w[2] + i*M_PI/3);
+            yy += s->hex_params->L*sin(w[2] + i*M_PI/3);
+        }
+        g[i] = hypot(x, yy) - s->hex_params->r0;
+    }
+}
+
+//
+// The first point whose r - r0 changed sign from g0 to g1, or -1.
+//
+static int crossing(const double *g0, const double *g1, int n)
+{
+    int i;
+
+    for (i = 0; i < n; ++i) {
+        if (g0[i] != 0.0 && (g0[i] > 0.0) != (g1[i] > 0.0)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+//
+// Advance s->y by tau.  If a point collides during the step, the step is
+// shortened by bisection to end at the collision, and
+// SYMPLECTIC_ROOT_RETURN is returned.
+//
+static int advance(symplectic_t *s, double tau)
+{
+    double lo, hi, mid;
+
+    gaps(s, s->y, s->g0);
+    N_VScale(1.0, s->y, s->y0);
+    if (step(s, s->y, tau) != 0) {
+        return -1;
+    }
+    gaps(s, s->y, s->g1);
+    if (crossing(s->g0, s->g1, s->num_roots) < 0) {
+        s->t += tau;
+        ++s->nsteps;
+        return SYMPLECTIC_SUCCESS;
+    }
+
+    // The crossing lies in (lo*tau, hi*tau].
+    lo = 0.0;
+    hi = 1.0;
+    while ((hi - lo)*tau > SYMPLECTIC_ROOT_TOL*s->h) {
+        mid = 0.5*(lo + hi);
+        N_VScale(1.0, s->y0, s->y);
+        s->f_at = NULL;
+        if (step(s, s->y, mid*tau) != 0) {
+            return -1;
+        }
+        gaps(s, s->y, s->g1);
+        if (crossing(s->g0, s->g1, s->num_roots) >= 0) {
+            hi = mid;
+        }
+        else {
+            lo = mid;
+        }
+    }
+    N_VScale(1.0, s->y0, s->y);
+    s->f_at = NULL;
+    if (step(s, s->y, hi*tau) != 0) {
+        return -1;
+    }
+    gaps(s, s->y, s->g1);
+    s->root_index = crossing(s->g0, s->g1, s->num_roots);
+    s->t += hi*tau;
+    ++s->nsteps;
+    return SYMPLECTIC_ROOT_RETURN;
+}
+
+//
+// Integrate to tout and return the solution there in y, as
+// CVode(..., CV_NORMAL) does.  The integration itself always takes whole
+// steps of size h; if tout is not on that grid, the solution at tout is
+// computed by a shorter step from the last grid point that is used only
+// for the output.  Returns SYMPLECTIC_SUCCESS with *t = tout,
+// SYMPLECTIC_ROOT_RETURN with the solution and the time of a collision
+// (s->root_index is the point), or -1 if the right-hand side failed.
+//
+int symplectic_evolve(symplectic_t *s, sunrealtype tout, N_Vector y,
+                      sunrealtype *t)
+{
+    double eps = 1e-9*s->h;
+    double tau;
+    int flag;
+
+    while (s->t + s->h <= tout + eps) {
+        flag = advance(s, s->h);
+        if (flag != SYMPLECTIC_SUCCESS) {
+            N_VScale(1.0, s->y, y);
+            *t = s->t;
+            return flag;
+        }
+    }
+
+    N_VScale(1.0, s->y, y);
+    *t = s->t;
+    tau = tout - s->t;
+    if (tau > eps) {
+        if (s->f_at == y) {
+            s->f_at = NULL;
+        }
+        gaps(s, s->y, s->g0);
+        if (step(s, y, tau) != 0) {
+            return -1;
+        }
+        gaps(s, y, s->g1);
+        if (crossing(s->g0, s->g1, s->num_roots) >= 0) {
+            // Stop at the collision, off the grid.
+            flag = advance(s, tau);
+            N_VScale(1.0, s->y, y);
+            *t = s->t;
+            return flag;
+        }
+        *t = tout;
+    }
+    return SYMPLECTIC_SUCCESS;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,103 @@
+#ifndef _SYMPLECTIC_H_
+#define _SYMPLECTIC_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sundials/sundials_core.h>
+#include <cvode/cvode.h>
+#include <nvector/nvector_serial.h>
+
+#include "de.h"
+
+//
+// Fixed step symplectic integrators, an alternative to CVODE for long
+// runs: many cheap steps of a structure preserving method in place of
+// few expensive adaptive ones.  Without damping the energy error of a
+// symplectic method oscillates but does not drift.
+//
+// The methods are compositions of velocity Verlet (kick h/2, drift h,
+// kick h/2) with the weights of Yoshida (1990) for 4th and 6th order.
+// The accelerations come from the right-hand side the caller passes,
+// normally the one CVODE uses (solver_rhs()), evaluated with b = 0; so
+// this module does not depend on solver.o.  The damping is a separate
+// dissipative flow, split symmetrically around each Verlet stage (Strang
+// splitting).  For a fixed position, the damping of each spring only
+// decays the rate of change of its length, s, as exp(-2*b*t); it is
+// applied exactly, spring by spring, forward over the springs for the
+// first half stage and backward for the second.
+//
+// The rigid hexagon (de_rigid_hex()) has the same methods; its drift
+// moves the center and rotates the body by the exponential map of its
+// angular velocity (exact for the rotation group of the plane, where it
+// adds omega*h to the angle).
+//
+// Collisions are detected like the root function collision(): if
+// r - r0 of any point changes sign over a step, the step size is
+// bisected from the start of the step until the crossing is bracketed to
+// within SYMPLECTIC_ROOT_TOL, and the integration stops there.
+//
+
+// Methods.
+#define SYMPLECTIC_VERLET   0
+#define SYMPLECTIC_YOSHIDA4 1
+#define SYMPLECTIC_YOSHIDA6 2
+
+// Return values of symplectic_evolve(); the same as CV_SUCCESS and
+// CV_ROOT_RETURN, so the callers treat both integrators alike.
+#define SYMPLECTIC_SUCCESS     CV_SUCCESS
+#define SYMPLECTIC_ROOT_RETURN CV_ROOT_RETURN
+
+// Width, relative to the step size, of the bracket of a collision time.
+#define SYMPLECTIC_ROOT_TOL 1e-12
+
+typedef struct _symplectic {
+    int method;
+    /* Number of Verlet stages per step, and their weights. */
+    int num_stages;
+    const double *weights;
+    /* The step size. */
+    double h;
+    /*
+     * For the points connected by springs: params, the right-hand side,
+     * and a copy of params with b = 0 for the accelerations.  NULL
+     * (rhs, params) for the rigid hexagon.
+     */
+    xparams_t *params;
+    xparams_t conservative;
+    CVRhsFn rhs;
+    /* For the rigid hexagon. */
+    rigid_hex_params_t *hex_params;
+    /* Number of values of r - r0. */
+    int num_roots;
+    /* Time and state of the integration, and the start of the last step. */
+    sunrealtype t;
+    N_Vector y;
+    N_Vector y0;
+    /* Work space: the right-hand side, and r - r0 before and after a step. */
+    N_Vector f;
+    double *g0, *g1;
+    /* The state at whose positions f holds the accelerations, or NULL. */
+    N_Vector f_at;
+    /* The point that collided (the first, if several did). */
+    int root_index;
+    long nsteps;
+    long nfevals;
+} symplectic_t;
+
+symplectic_t *symplectic_create(int method, double h, xparams_t *params,
+                                CVRhsFn rhs, sunrealtype t0, N_Vector y0);
+symplectic_t *symplectic_create_rigid_hex(int method, double h,
+                                          rigid_hex_params_t *params,
+                                          sunrealtype t0, N_Vector y0);
+void symplectic_free(symplectic_t **s);
+int symplectic_evolve(symplectic_t *s, sunrealtype tout, N_Vector y,
+                      sunrealtype *t);
+int symplectic_method(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef _TIMER_H_
+#define _TIMER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <time.h>
+
+//
+// Wall clock time in seconds, from CLOCK_MONOTONIC, for timing the
+// right-hand sides (stats.h) and the benchmarks.  Inline, so the
+// benchmarks that link no other object of the solver need not link one
+// for it.
+//
+static inline double timer_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
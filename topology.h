@@ -0,0 +1,267 @@
+#ifndef _TOPOLOGY_H_
+#define _TOPOLOGY_H_
+
+//
+// Right-hand sides and Jacobians of de() specialized at compile time for
+// small systems of fixed topology (C++ only; see de_fixed.h for the C
+// interface).
+//
+// A topology is a struct with the number of points and a constexpr list
+// of the connections:
+//
+//     struct Triangle {
+//         static constexpr int num_points = 3;
+//         static constexpr int num_connections = 3;
+//         static constexpr int connections[3][2] = {{0, 1}, {0, 2}, {1, 2}};
+//     };
+//
+// and a force law is a struct with inline force(r, k, L) and
+// deriv(r, k, L), such as CubicSpring below for FORCE_CUBIC (the laws of
+// force_law.h).  FixedSystem<Topology, Force> expands the loop over the
+// connections at compile time: every index is a constant, so there is no
+// indexing through the connection array and no loop or branch per
+// connection, and the compiler keeps the state of the small system in
+// registers.
+//
+// The results equal those of de() and de_jac() up to rounding: the
+// distance is computed with sqrt() rather than hypot(), and the spring
+// and friction forces of a connection are added together.  The mutual
+// gravity (params->bh) is not included.
+//
+
+#include <math.h>
+#include <string.h>
+#include <utility>
+
+#include "de.h"
+#include "force_law.h"
+
+
+//
+// The force laws of force_law.h, as policies.
+//
+struct CubicSpring {
+    static inline double force(double r, double k, double L)
+    {
+        return force_cubic(r, k, L);
+    }
+
+    static inline double deriv(double r, double k, double L)
+    {
+        return force_cubic_deriv(r, k, L);
+    }
+};
+
+struct HookeSpring {
+    static inline double force(double r, double k, double L)
+    {
+        return force_hooke(r, k, L);
+    }
+
+    static inline double deriv(double r, double k, double L)
+    {
+        return force_hooke_deriv(r, k, L);
+    }
+};
+
+struct LennardJonesSpring {
+    static inline double force(double r, double k, double L)
+    {
+        return force_lj(r, k, L);
+    }
+
+    static inline double deriv(double r, double k, double L)
+    {
+        return force_lj_deriv(r, k, L);
+    }
+};
+
+struct BilinearSpring {
+    static inline double force(double r, double k, double L)
+    {
+        return force_bilinear(r, k, L);
+    }
+
+    static inline double deriv(double r, double k, double L)
+    {
+        return force_bilinear_deriv(r, k, L);
+    }
+};
+
+
+template <class Topology, class Force>
+class FixedSystem {
+
+public:
+
+    static constexpr int n = Topology::num_points;
+    static constexpr int num_connections = Topology::num_connections;
+    // Length of the state: positions, then velocities.
+    static constexpr int size = 4*n;
+
+    //
+    // f = de(w) for the parameters k, L, b and g of p.
+    //
+    static void rhs(const double *w, double *f, const xparams_t *p)
+    {
+        for (int i = 0; i < 2*n; ++i) {
+            f[i] = w[2*n + i];
+            f[2*n + i] = 0.0;
+        }
+        springs(w, f, p, std::make_integer_sequence<int, num_connections>());
+        if (p->g > 0) {
+            for (int i = 0; i < n; ++i) {
+                double x = w[2*i], y = w[2*i+1];
+                double r2 = x*x + y*y;
+                double gr3 = p->g/(r2*sqrt(r2));
+                f[2*n + 2*i] -= gr3*x;
+                f[2*n + 2*i + 1] -= gr3*y;
+            }
+        }
+    }
+
+    //
+    // The Jacobian of rhs() at w, as a dense column-major matrix with
+    // leading dimension ld (at least size).
+    //
+    static void jac(const double *w, double *J, long ld, const xparams_t *p)
+    {
+        for (int c = 0; c < size; ++c) {
+            memset(J + c*ld, 0, size * sizeof(double));
+        }
+        for (int i = 0; i < 2*n; ++i) {
+            J[(2*n + i)*ld + i] = 1.0;
+        }
+        jac_springs(w, J, ld, p, std::make_integer_sequence<int, num_connections>());
+        if (p->g > 0) {
+            for (int i = 0; i < n; ++i) {
+                double x = w[2*i], y = w[2*i+1];
+                double r2 = x*x + y*y;
+                double r = sqrt(r2);
+                double gr3 = p->g/(r2*r);
+                double xh = x/r, yh = y/r;
+                int ri = 2*n + 2*i;
+                J[(2*i)*ld + ri]         += -gr3*(1 - 3*xh*xh);
+                J[(2*i + 1)*ld + ri]     += 3*gr3*xh*yh;
+                J[(2*i)*ld + ri + 1]     += 3*gr3*xh*yh;
+                J[(2*i + 1)*ld + ri + 1] += -gr3*(1 - 3*yh*yh);
+            }
+        }
+    }
+
+private:
+
+    // The spring and friction forces of connection c.
+    template <int c>
+    static inline void connection(const double *w, double *f, const xparams_t *p)
+    {
+        constexpr int i = Topology::connections[c][0];
+        constexpr int j = Topology::connections[c][1];
+        const double *v = w + 2*n;
+        double *a = f + 2*n;
+        double ux = w[2*j] - w[2*i];
+        double uy = w[2*j+1] - w[2*i+1];
+        double dist = sqrt(ux*ux + uy*uy);
+
+        ux /= dist;
+        uy /= dist;
+        // Friction minus spring force, along uvec, on point i.
+        double s = (v[2*j] - v[2*i])*ux + (v[2*j+1] - v[2*i+1])*uy;
+        double force = p->b*s - Force::force(dist, p->k, p->L);
+        a[2*i]   += force*ux;
+        a[2*i+1] += force*uy;
+        a[2*j]   -= force*ux;
+        a[2*j+1] -= force*uy;
+    }
+
+    template <int... c>
+    static inline void springs(const double *w, double *f, const xparams_t *p,
+                               std::integer_sequence<int, c...>)
+    {
+        int expand[] = {0, (connection<c>(w, f, p), 0)...};
+        (void) expand;
+    }
+
+    //
+    // The derivatives of connection c (as edge_blocks() in de_jac.c):
+    // M with respect to the position of i, -C with respect to its
+    // velocity, and the same with the opposite signs for j.
+    //
+    template <int c>
+    static inline void jac_connection(const double *w, double *J, long ld,
+                                      const xparams_t *p)
+    {
+        constexpr int i = Topology::connections[c][0];
+        constexpr int j = Topology::connections[c][1];
+        const double *v = w + 2*n;
+        double u[2], rel[2], pw[2], M[2][2], C[2][2];
+        double dist, s, force, dforce;
+
+        u[0] = w[2*j] - w[2*i];
+        u[1] = w[2*j+1] - w[2*i+1];
+        dist = sqrt(u[0]*u[0] + u[1]*u[1]);
+        u[0] /= dist;
+        u[1] /= dist;
+        force = Force::force(dist, p->k, p->L);
+        dforce = Force::deriv(dist, p->k, p->L);
+        rel[0] = v[2*j] - v[2*i];
+        rel[1] = v[2*j+1] - v[2*i+1];
+        s = rel[0]*u[0] + rel[1]*u[1];
+        pw[0] = rel[0] - s*u[0];
+        pw[1] = rel[1] - s*u[1];
+        for (int a = 0; a < 2; ++a) {
+            for (int b = 0; b < 2; ++b) {
+                double uu = u[a]*u[b];
+                double perp = (a == b) - uu;
+                double K = dforce*uu + force/dist*perp;
+                double D = (u[a]*pw[b] + s*perp)/dist;
+                M[a][b] = K - p->b*D;
+                C[a][b] = p->b*uu;
+            }
+        }
+        for (int a = 0; a < 2; ++a) {
+            int ri = 2*n + 2*i + a, rj = 2*n + 2*j + a;
+            for (int b = 0; b < 2; ++b) {
+                J[(2*i + b)*ld + ri] += M[a][b];
+                J[(2*j + b)*ld + ri] -= M[a][b];
+                J[(2*n + 2*i + b)*ld + ri] -= C[a][b];
+                J[(2*n + 2*j + b)*ld + ri] += C[a][b];
+                J[(2*j + b)*ld + rj] += M[a][b];
+                J[(2*i + b)*ld + rj] -= M[a][b];
+                J[(2*n + 2*j + b)*ld + rj] -= C[a][b];
+                J[(2*n + 2*i + b)*ld + rj] += C[a][b];
+            }
+        }
+    }
+
+    template <int... c>
+    static inline void jac_springs(const double *w, double *J, long ld,
+                                   const xparams_t *p,
+                                   std::integer_sequence<int, c...>)
+    {
+        int expand[] = {0, (jac_connection<c>(w, J, ld, p), 0)...};
+        (void) expand;
+    }
+};
+
+//
+// Whether the connections of p are those of Topology, in the same order.
+// (The same springs in another order are another topology here.)
+//
+template <class Topology>
+bool topology_matches(const xparams_t *p)
+{
+    if (p->num_points != Topology::num_points ||
+            p->num_connections != Topology::num_connections) {
+        return false;
+    }
+    for (int c = 0; c < Topology::num_connections; ++c) {
+        if (p->connections[2*c] != Topology::connections[c][0] ||
+                p->connections[2*c + 1] != Topology::connections[c][1]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,523 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "traj.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// Write the .npy header for num_frames rows at the start of the file.
+// The header is always TRAJ_HEADER_SIZE bytes: the dictionary is padded
+// with spaces and ends with a newline.
+//
+static int write_header(traj_t *traj, long num_frames)
+{
+    char header[TRAJ_HEADER_SIZE];
+    const unsigned int one = 1;
+    char order = *(const char *) &one ? '<' : '>';
+    int len;
+
+    memset(header, ' ', sizeof(header));
+    memcpy(header, "\x93NUMPY\x01\x00", 8);
+    header[8] = (TRAJ_HEADER_SIZE - 10) & 0xff;
+    header[9] = (TRAJ_HEADER_SIZE - 10) >> 8;
+    len = snprintf(header + 10, TRAJ_HEADER_SIZE - 10,
+                   "{'descr': '%c%s', 'fortran_order': False, 'shape': (%ld, %d), }",
+                   order, traj->dtype == TRAJ_FLOAT32 ? "f4" : "f8",
+                   num_frames, traj->row_size);
+    header[10 + len] = ' ';
+    header[TRAJ_HEADER_SIZE - 1] = '\n';
+    if (pwrite(traj->fd, header, sizeof(header), 0) != sizeof(header)) {
+        return -1;
+    }
+    return 0;
+}
+
+static int write_all(int fd, const char *data, size_t size)
+{
+    ssize_t n;
+
+    while (size > 0) {
+        n = write(fd, data, size);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        data += n;
+        size -= n;
+    }
+    return 0;
+}
+
+//
+// The writer thread: writes each buffer that traj_write() hands over,
+// then updates the number of frames in the header.
+//
+static void *writer(void *arg)
+{
+    traj_t *traj = arg;
+    const char *data;
+    long rows;
+    int failed;
+
+    pthread_mutex_lock(&traj->mutex);
+    for (;;) {
+        while (traj->pending == 0 && !traj->quit) {
+            pthread_cond_wait(&traj->cond, &traj->mutex);
+        }
+        if (traj->pending == 0) {
+            break;
+        }
+        data = traj->buffer[1 - traj->fill];
+        rows = traj->pending;
+        pthread_mutex_unlock(&traj->mutex);
+
+        failed = write_all(traj->fd, data, rows * traj->row_bytes) != 0 ||
+                 write_header(traj, traj->num_frames + rows) != 0;
+
+        pthread_mutex_lock(&traj->mutex);
+        if (failed) {
+            traj->error = 1;
+        }
+        else {
+            traj->num_frames += rows;
+        }
+        traj->pending = 0;
+        pthread_cond_broadcast(&traj->cond);
+    }
+    pthread_mutex_unlock(&traj->mutex);
+    return NULL;
+}
+
+//
+// Hand the filled buffer to the writer thread (waiting for it to finish
+// the other one first), and continue in the other buffer.
+//
+static int flush(traj_t *traj)
+{
+    int error;
+
+    pthread_mutex_lock(&traj->mutex);
+    while (traj->pending != 0) {
+        pthread_cond_wait(&traj->cond, &traj->mutex);
+    }
+    error = traj->error;
+    if (!error && traj->count > 0) {
+        traj->pending = traj->count;
+        traj->fill = 1 - traj->fill;
+        traj->count = 0;
+        pthread_cond_broadcast(&traj->cond);
+    }
+    pthread_mutex_unlock(&traj->mutex);
+    return error ? -1 : 0;
+}
+
+//
+// Set up traj for frames of frame_size values stored as dtype, in the file
+// open as fd, whose header is written for num_frames frames (already in
+// the file), and start its writer thread.  Closes fd and returns NULL on
+// failure.
+//
+static traj_t *traj_start(int fd, const char *filename, int frame_size, int dtype,
+                          long num_frames)
+{
+    traj_t *traj;
+    off_t end;
+
+    traj = calloc(1, sizeof(traj_t));
+    if (traj == NULL) {
+        fprintf(stderr, "traj_open: out of memory\n");
+        close(fd);
+        return NULL;
+    }
+    traj->fd = fd;
+    traj->dtype = dtype;
+    traj->row_size = 1 + frame_size;
+    traj->row_bytes = traj->row_size *
+                      (dtype == TRAJ_FLOAT32 ? sizeof(float) : sizeof(double));
+    traj->capacity = TRAJ_BUFFER_BYTES / traj->row_bytes;
+    if (traj->capacity < 1) {
+        traj->capacity = 1;
+    }
+    traj->num_frames = num_frames;
+    traj->buffer[0] = malloc(traj->capacity * traj->row_bytes);
+    traj->buffer[1] = malloc(traj->capacity * traj->row_bytes);
+    if (traj->buffer[0] == NULL || traj->buffer[1] == NULL) {
+        fprintf(stderr, "traj_open: out of memory\n");
+        goto fail;
+    }
+    end = TRAJ_HEADER_SIZE + num_frames * traj->row_bytes;
+    if (ftruncate(fd, end) != 0 || write_header(traj, num_frames) != 0 ||
+            lseek(traj->fd, end, SEEK_SET) != end) {
+        fprintf(stderr, "traj_open: cannot write %s\n", filename);
+        goto fail;
+    }
+    pthread_mutex_init(&traj->mutex, NULL);
+    pthread_cond_init(&traj->cond, NULL);
+    if (pthread_create(&traj->thread, NULL, writer, traj) != 0) {
+        fprintf(stderr, "traj_open: cannot create the writer thread\n");
+        pthread_cond_destroy(&traj->cond);
+        pthread_mutex_destroy(&traj->mutex);
+        goto fail;
+    }
+    return traj;
+
+fail:
+    close(traj->fd);
+    free(traj->buffer[0]);
+    free(traj->buffer[1]);
+    free(traj);
+    return NULL;
+}
+
+//
+// Create the trajectory file filename for frames of frame_size values
+// (plus the time), stored as dtype (TRAJ_FLOAT64 or TRAJ_FLOAT32), and
+// start its writer thread.  Returns NULL on failure.
+//
+traj_t *traj_open(const char *filename, int frame_size, int dtype)
+{
+    int fd;
+
+    fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "traj_open: cannot open %s\n", filename);
+        return NULL;
+    }
+    return traj_start(fd, filename, frame_size, dtype, 0);
+}
+
+//
+// Continue the trajectory file filename, written by traj_open() with the
+// same frame_size and dtype, after its frames up to time t: the later
+// ones are dropped, for a run resumed from a checkpoint at t
+// (checkpoint.h).  Returns NULL on failure.
+//
+traj_t *traj_append(const char *filename, int frame_size, int dtype, double t)
+{
+    traj_map_t *map;
+    long keep;
+    int fd;
+
+    map = traj_map_open(filename);
+    if (map == NULL) {
+        return NULL;
+    }
+    if (map->row_size != 1 + frame_size || map->dtype != dtype ||
+            map->data != (const char *) map->base + TRAJ_HEADER_SIZE) {
+        fprintf(stderr, "traj_append: %s does not hold frames of %d %s values\n",
+                filename, frame_size, dtype == TRAJ_FLOAT32 ? "float32" : "float64");
+        traj_map_close(map);
+        return NULL;
+    }
+    // (With float32 the times are rounded, so t is too.)
+    if (dtype == TRAJ_FLOAT32) {
+        t = (float) t;
+    }
+    keep = 0;
+    if (map->num_frames > 0 && traj_map_time(map, 0) <= t) {
+        keep = traj_map_find(map, t) + 1;
+    }
+    // (The file is flushed before each checkpoint, so it should reach t.)
+    if (keep > 0 && traj_map_time(map, keep - 1) < t) {
+        fprintf(stderr, "traj_append: %s has no frames after t=%g\n",
+                filename, traj_map_time(map, keep - 1));
+    }
+    else if (keep == 0 && t > 0) {
+        fprintf(stderr, "traj_append: %s has no frames up to t=%g\n",
+                filename, t);
+    }
+    traj_map_close(map);
+
+    fd = open(filename, O_WRONLY);
+    if (fd < 0) {
+        fprintf(stderr, "traj_append: cannot open %s\n", filename);
+        return NULL;
+    }
+    return traj_start(fd, filename, frame_size, dtype, keep);
+}
+
+//
+// Append the frame (t, state).  Returns 0, or -1 if writing to the file
+// has failed.
+//
+int traj_write(traj_t *traj, double t, const double *state)
+{
+    char *row = traj->buffer[traj->fill] + traj->count * traj->row_bytes;
+    int i;
+
+    if (traj->dtype == TRAJ_FLOAT32) {
+        float *r = (float *) row;
+        r[0] = (float) t;
+        for (i = 1; i < traj->row_size; ++i) {
+            r[i] = (float) state[i - 1];
+        }
+    }
+    else {
+        double *r = (double *) row;
+        r[0] = t;
+        memcpy(r + 1, state, (traj->row_size - 1) * sizeof(double));
+    }
+    if (++traj->count == traj->capacity) {
+        return flush(traj);
+    }
+    return 0;
+}
+
+//
+// Write the frames so far to the file, waiting for the writer thread, and
+// sync it, so that a checkpoint taken next (checkpoint.h) is not ahead of
+// the file.  Returns 0, or -1 if any write failed.
+//
+int traj_flush(traj_t *traj)
+{
+    int error;
+
+    flush(traj);
+    pthread_mutex_lock(&traj->mutex);
+    while (traj->pending != 0) {
+        pthread_cond_wait(&traj->cond, &traj->mutex);
+    }
+    error = traj->error;
+    pthread_mutex_unlock(&traj->mutex);
+    if (!error && fdatasync(traj->fd) != 0) {
+        error = 1;
+    }
+    return error ? -1 : 0;
+}
+
+//
+// Write the remaining frames, stop the writer thread and close the file.
+// Returns 0, or -1 if any write failed.
+//
+int traj_close(traj_t *traj)
+{
+    int error;
+
+    if (traj == NULL) {
+        return 0;
+    }
+    flush(traj);
+    pthread_mutex_lock(&traj->mutex);
+    while (traj->pending != 0) {
+        pthread_cond_wait(&traj->cond, &traj->mutex);
+    }
+    traj->quit = 1;
+    pthread_cond_broadcast(&traj->cond);
+    pthread_mutex_unlock(&traj->mutex);
+    pthread_join(traj->thread, NULL);
+
+    error = traj->error;
+    if (close(traj->fd) != 0) {
+        error = 1;
+    }
+    if (error) {
+        fprintf(stderr, "traj_close: writing the trajectory failed\n");
+    }
+    pthread_cond_destroy(&traj->cond);
+    pthread_mutex_destroy(&traj->mutex);
+    free(traj->buffer[0]);
+    free(traj->buffer[1]);
+    free(traj);
+    return error ? -1 : 0;
+}
+
+//
+// Map the trajectory file filename.  Returns NULL if it cannot be opened
+// or is not a suitable .npy file.
+//
+traj_map_t *traj_map_open(const char *filename)
+{
+    traj_map_t *map;
+    const unsigned char *b;
+    const unsigned int one = 1;
+    char native = *(const char *) &one ? '<' : '>';
+    char *header = NULL;
+    const char *p;
+    char descr[8];
+    size_t header_len, offset;
+    long rows;
+    int cols;
+    struct stat st;
+    int fd;
+
+    map = calloc(1, sizeof(traj_map_t));
+    if (map == NULL) {
+        fprintf(stderr, "traj_map_open: out of memory\n");
+        return NULL;
+    }
+    fd = open(filename, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        fprintf(stderr, "traj_map_open: cannot open %s\n", filename);
+        if (fd >= 0) {
+            close(fd);
+        }
+        free(map);
+        return NULL;
+    }
+    map->size = st.st_size;
+    map->base = map->size >= 12 ?
+                mmap(NULL, map->size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (map->base == MAP_FAILED) {
+        map->base = NULL;
+        goto fail;
+    }
+
+    // The magic string, the version, and the length of the header.
+    b = map->base;
+    if (memcmp(b, "\x93NUMPY", 6) != 0) {
+        goto fail;
+    }
+    if (b[6] == 1) {
+        header_len = b[8] | b[9] << 8;
+        offset = 10;
+    }
+    else {
+        header_len = b[8] | b[9] << 8 | b[10] << 16 | (size_t) b[11] << 24;
+        offset = 12;
+    }
+    if (offset + header_len > map->size) {
+        goto fail;
+    }
+    header = malloc(header_len + 1);
+    if (header == NULL) {
+        goto fail;
+    }
+    memcpy(header, b + offset, header_len);
+    header[header_len] = '\0';
+
+    // The dictionary, e.g.
+    // {'descr': '<f8', 'fortran_order': False, 'shape': (10001, 13), }
+    if ((p = strstr(header, "'descr':")) == NULL ||
+            sscanf(p + 8, " '%7[^']'", descr) != 1 ||
+            (descr[0] != native && descr[0] != '=' && descr[0] != '|') ||
+            (strcmp(descr + 1, "f8") != 0 && strcmp(descr + 1, "f4") != 0) ||
+            (p = strstr(header, "'fortran_order':")) == NULL ||
+            strncmp(p + 16 + strspn(p + 16, " "), "False", 5) != 0 ||
+            (p = strstr(header, "'shape':")) == NULL ||
+            sscanf(p + 8, " (%ld , %d )", &rows, &cols) != 2 ||
+            rows < 0 || cols < 1) {
+        goto fail;
+    }
+    map->dtype = strcmp(descr + 1, "f4") == 0 ? TRAJ_FLOAT32 : TRAJ_FLOAT64;
+    map->row_size = cols;
+    map->row_bytes = cols * (map->dtype == TRAJ_FLOAT32 ? sizeof(float) : sizeof(double));
+    map->data = (const char *) b + offset + header_len;
+    // A file that is still being written may hold more rows than its
+    // header says, but never fewer.
+    map->num_frames = rows;
+    if ((map->size - offset - header_len)/map->row_bytes < (size_t) rows) {
+        map->num_frames = (map->size - offset - header_len)/map->row_bytes;
+    }
+    free(header);
+    return map;
+
+fail:
+    fprintf(stderr, "traj_map_open: %s is not a trajectory file\n", filename);
+    free(header);
+    traj_map_close(map);
+    return NULL;
+}
+
+void traj_map_close(traj_map_t *map)
+{
+    if (map == NULL) {
+        return;
+    }
+    if (map->base != NULL) {
+        munmap(map->base, map->size);
+    }
+    free(map);
+}
+
+double traj_map_time(const traj_map_t *map, long i)
+{
+    const char *row = map->data + i * map->row_bytes;
+
+    if (map->dtype == TRAJ_FLOAT32) {
+        return *(const float *) row;
+    }
+    return *(const double *) row;
+}
+
+//
+// The last frame at or before time t (the first frame if t precedes it).
+// The frames are normally equally spaced in time, so the frame is found
+// directly from t; otherwise it is found by bisection.
+//
+long traj_map_find(const traj_map_t *map, double t)
+{
+    long n = map->num_frames;
+    long i, lo, hi, mid;
+    double t0, t1;
+    int k;
+
+    if (n <= 1 || t <= (t0 = traj_map_time(map, 0))) {
+        return 0;
+    }
+    if (t >= (t1 = traj_map_time(map, n - 1))) {
+        return n - 1;
+    }
+
+    // Here t0 < t < t1, so the walk below stays within 0..n-2.
+    i = (long) ((t - t0)/(t1 - t0)*(n - 1));
+    i = i < 0 ? 0 : (i > n - 2 ? n - 2 : i);
+    for (k = 0; k < 4; ++k) {
+        if (traj_map_time(map, i) > t) {
+            --i;
+        }
+        else if (traj_map_time(map, i + 1) <= t) {
+            ++i;
+        }
+        else {
+            return i;
+        }
+    }
+
+    // time(lo) <= t < time(hi)
+    lo = 0;
+    hi = n - 1;
+    while (hi - lo > 1) {
+        mid = lo + (hi - lo)/2;
+        if (traj_map_time(map, mid) <= t) {
+            lo = mid;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+//
+// Copy the state of frame i (without the time) to state, as doubles.
+//
+void traj_map_frame(const traj_map_t *map, long i, double *state)
+{
+    const char *row = map->data + i * map->row_bytes;
+    int j;
+
+    if (map->dtype == TRAJ_FLOAT32) {
+        const float *r = (const float *) row;
+        for (j = 1; j < map->row_size; ++j) {
+            state[j - 1] = r[j];
+        }
+    }
+    else {
+        memcpy(state, (const double *) row + 1, (map->row_size - 1) * sizeof(double));
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,107 @@
+#ifndef _TRAJ_H_
+#define _TRAJ_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <pthread.h>
+
+//
+// Binary trajectory files.
+//
+// A trajectory is written as a NumPy .npy file (format version 1.0) with
+// one row per frame: the time followed by the frame_size values of the
+// state, so the array has the shape (num_frames, 1 + frame_size).  The
+// values are stored as float64, or float32 to halve the size, in the byte
+// order of the machine ('<f8' or '<f4' on x86 and ARM).  The header is
+// padded to TRAJ_HEADER_SIZE bytes, so the data is aligned for mmap(), and
+// leaves room for the number of frames to grow: it is rewritten in place
+// each time a buffer of frames has been written, so a reader sees the
+// frames written so far, e.g. with
+//
+//     w = np.load('out.npy', mmap_mode='r')
+//
+// or in C by mapping the file and skipping TRAJ_HEADER_SIZE bytes.
+//
+// traj_write() only copies the frame into one of two buffers.  When the
+// buffer is full it is handed to a writer thread, and the frames go into
+// the other buffer meanwhile, so the integration only waits if the disk
+// cannot keep up on average.
+//
+// traj_flush() writes the frames buffered so far and waits for them to
+// reach the file, so a checkpoint (checkpoint.h) taken after it is not
+// ahead of the file.  traj_append() continues a file after a given time,
+// for an integration resumed from such a checkpoint; it warns if frames
+// before that time are missing.
+//
+
+// Values of the dtype argument of traj_open().
+#define TRAJ_FLOAT64 0
+#define TRAJ_FLOAT32 1
+
+#define TRAJ_HEADER_SIZE 128
+
+// Size of each of the two buffers.
+#define TRAJ_BUFFER_BYTES (1 << 20)
+
+typedef struct _traj {
+    int fd;
+    int dtype;
+    /* Number of values per row (1 + frame_size), and bytes per row. */
+    int row_size;
+    size_t row_bytes;
+    /* Capacity of each buffer in rows. */
+    long capacity;
+    /* The buffer being filled, and the number of rows in it. */
+    char *buffer[2];
+    int fill;
+    long count;
+    /* Rows handed to the writer thread (0 when it is idle). */
+    long pending;
+    /* Rows in the file. */
+    long num_frames;
+    /* Set when a write fails; traj_write() then fails too. */
+    int error;
+    int quit;
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} traj_t;
+
+traj_t *traj_open(const char *filename, int frame_size, int dtype);
+traj_t *traj_append(const char *filename, int frame_size, int dtype, double t);
+int traj_write(traj_t *traj, double t, const double *state);
+int traj_flush(traj_t *traj);
+int traj_close(traj_t *traj);
+
+//
+// Reading: a trajectory file mapped into memory.  Any .npy file with a
+// two-dimensional float64 or float32 array in C order and the byte order
+// of the machine will do; the first column is the time, which must be
+// nondecreasing.  Nothing is read until a frame is accessed, so opening
+// even a very long trajectory is immediate.
+//
+typedef struct _traj_map {
+    /* The mapped file, and the start of the rows in it. */
+    void *base;
+    size_t size;
+    const char *data;
+    int dtype;
+    /* Number of values per row (1 + frame_size), and bytes per row. */
+    int row_size;
+    size_t row_bytes;
+    long num_frames;
+} traj_map_t;
+
+traj_map_t *traj_map_open(const char *filename);
+void traj_map_close(traj_map_t *map);
+double traj_map_time(const traj_map_t *map, long i);
+long traj_map_find(const traj_map_t *map, double t);
+void traj_map_frame(const traj_map_t *map, long i, double *state);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif